@@ -0,0 +1,102 @@
+#ifndef MAIN_ASYNC_BENCH_H
+#define MAIN_ASYNC_BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <async_writer.h>
+#include <buffered_writer.h>
+#include "bench_graph.h"
+
+// Baseline sink: raw values through a BufferedWriter, so every full block is written on the compute thread.
+template<class T>
+class SyncFileOutputStream : public Operator<T> {
+private:
+    BufferedWriter *out;
+
+public:
+    SyncFileOutputStream(int id, BufferedWriter &out) : Operator<T>(id, OP_PASS_A, OP_OUT, "output"), out(&out) {}
+
+    void compute() override {
+        if (Operator<T>::getSrcA()) {
+            auto v = Operator<T>::getSrcA()->getVal();
+            Operator<T>::setVal(v);
+            out->write((const char *) &v, sizeof(v));
+        }
+    }
+};
+
+// Swaps every OutputStream of df for sinks made by makeSink(id).
+template<class T, class F>
+void replaceOutputs(DataFlow<T> *df, F makeSink) {
+    std::vector<int> outs;
+    for (auto item:df->getOpArray()) {
+        if (item.second->getType() == OP_OUT) {
+            outs.push_back(item.first);
+        }
+    }
+    for (auto id:outs) {
+        delete df->replaceSink(id, makeSink(id));
+    }
+}
+
+inline std::string fileContents(const char *path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+void run_async_bench() {
+    const int copies = 16;
+    const int taps = 2;
+    const int samples = 200000;
+    const char *path = "async_bench.bin";
+    const char *syncPath = "async_bench_sync.bin";
+    std::vector<std::vector<unsigned short>> data_in(copies), data_out(copies);
+    for (int j = 0; j < copies; ++j) {
+        for (int i = 0; i < samples; ++i) {
+            data_in[j].push_back((unsigned short) (i + j));
+        }
+    }
+    double mb = (double) copies * samples * sizeof(unsigned short) / (1 << 20);
+    cout << "async output " << mb << " MB" << endl;
+
+    {
+        auto df = benchGraph<unsigned short>(copies, taps, data_in.data(), data_out.data());
+        BufferedWriter out(syncPath);
+        replaceOutputs(df, [&out](int id) { return new SyncFileOutputStream<unsigned short>(id, out); });
+        auto t0 = std::chrono::steady_clock::now();
+        df->compute();
+        bool ok = out.close();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        cout << "  synchronous: " << s * 1e3 << " ms" << (ok ? "" : ", WRITE FAILED") << endl;
+        delete df;
+    }
+    std::string expected = fileContents(syncPath);
+    for (unsigned buffers = 2; buffers <= 3; ++buffers) {
+        for (int direct = 0; direct <= 1; ++direct) {
+            auto df = benchGraph<unsigned short>(copies, taps, data_in.data(), data_out.data());
+            AsyncFileWriter out(path, 1 << 20, buffers, direct != 0);
+            replaceOutputs(df, [&out](int id) { return new AsyncOutputStream<unsigned short>(id, out); });
+            auto t0 = std::chrono::steady_clock::now();
+            df->compute();
+            double c = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            bool ok = out.close();
+            double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            bool same = out.getBytesWritten() == (unsigned long long) (mb * (1 << 20)) &&
+                        fileContents(path) == expected;
+            cout << "  async " << buffers << " buffers" << (out.isDirect() ? ", O_DIRECT" : "")
+                 << (direct && !out.isDirect() ? ", O_DIRECT unavailable" : "") << ": " << s * 1e3 << " ms ("
+                 << c * 1e3 << " ms compute), stall " << out.getStallNs() / 1e6 << " ms"
+                 << (ok ? "" : ", WRITE FAILED") << (same ? "" : ", MISMATCH") << endl;
+            delete df;
+        }
+    }
+    remove(path);
+    remove(syncPath);
+}
+
+#endif //MAIN_ASYNC_BENCH_H
@@ -0,0 +1,33 @@
+#ifndef MAIN_BENCH_GRAPH_H
+#define MAIN_BENCH_GRAPH_H
+
+#include <data_flow.h>
+
+// FIR-shaped graph wired with link() and leveled once (unless level is false), so large sizes build quickly.
+template<class T>
+DataFlow<T> *benchGraph(int copies, int taps, std::vector<T> *data_in, std::vector<T> *data_out, bool level = true) {
+    auto df = new DataFlow<T>(0, "bench");
+    int idx = 0;
+    for (int j = 0; j < copies; ++j) {
+        auto in = new InputStream<T>(idx++, data_in[j]);
+        auto out = new OutputStream<T>(idx++, data_out[j]);
+        Operator<T> *prev = nullptr;
+        for (int i = 0; i < taps; ++i) {
+            auto m = new Multi<T>(idx++, (T) (i + 1));
+            Operator<T> *op = i == 0 ? (Operator<T> *) new PassA<T>(idx++) : (Operator<T> *) new Add<T>(idx++);
+            df->link(in, m, PORT_A);
+            df->link(m, op, PORT_A);
+            if (prev) {
+                df->link(prev, op, PORT_B);
+            }
+            prev = op;
+        }
+        df->link(prev, out, PORT_A);
+    }
+    if (level) {
+        df->updateOpLevel();
+    }
+    return df;
+}
+
+#endif //MAIN_BENCH_GRAPH_H
@@ -0,0 +1,65 @@
+#ifndef MAIN_BUILDER_BENCH_H
+#define MAIN_BUILDER_BENCH_H
+
+#include <chrono>
+#include <thread>
+#include <graph_builder.h>
+#include "bench_graph.h"
+
+// The graph of benchGraph(), built by `threads` threads on GraphBuilders (one per copy) and merged.
+template<class T>
+DataFlow<T> *builderGraph(int copies, int taps, std::vector<T> *data_in, std::vector<T> *data_out, int threads) {
+    std::vector<GraphBuilder<T>> builders(copies);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            for (int j = t; j < copies; j += threads) {
+                auto &b = builders[j];
+                int in = b.add(new InputStream<T>(0, data_in[j]));
+                int out = b.add(new OutputStream<T>(0, data_out[j]));
+                int prev = -1;
+                for (int i = 0; i < taps; ++i) {
+                    int m = b.add(new Multi<T>(0, (T) (i + 1)));
+                    int op = b.add(i == 0 ? (Operator<T> *) new PassA<T>(0) : (Operator<T> *) new Add<T>(0));
+                    b.link(in, m, PORT_A);
+                    b.link(m, op, PORT_A);
+                    if (prev >= 0) {
+                        b.link(prev, op, PORT_B);
+                    }
+                    prev = op;
+                }
+                b.link(prev, out, PORT_A);
+            }
+        });
+    }
+    for (auto &w:workers) {
+        w.join();
+    }
+    std::vector<GraphBuilder<T> *> list;
+    for (auto &b:builders) {
+        list.push_back(&b);
+    }
+    auto df = new DataFlow<T>(0, "bench");
+    df->merge(list, threads);
+    return df;
+}
+
+void run_builder_bench() {
+    const int taps = 16;
+    int threads = (int) std::max(1u, std::thread::hardware_concurrency());
+    for (int copies = 1000; copies <= 10000; copies *= 10) {
+        std::vector<std::vector<unsigned short>> data_in(copies), data_out(copies);
+        auto t0 = std::chrono::steady_clock::now();
+        auto df = benchGraph<unsigned short>(copies, taps, data_in.data(), data_out.data());
+        double serial = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        t0 = std::chrono::steady_clock::now();
+        auto merged = builderGraph<unsigned short>(copies, taps, data_in.data(), data_out.data(), threads);
+        double parallel = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        cout << "builder " << df->getNumOp() << " ops: link + updateOpLevel " << serial * 1e3 << " ms, " << threads
+             << " builder threads + merge " << parallel * 1e3 << " ms" << endl;
+        delete df;
+        delete merged;
+    }
+}
+
+#endif //MAIN_BUILDER_BENCH_H
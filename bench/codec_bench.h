@@ -0,0 +1,61 @@
+#ifndef MAIN_CODEC_BENCH_H
+#define MAIN_CODEC_BENCH_H
+
+#include <chrono>
+#include <cstdlib>
+#include <data_flow.h>
+#include <stream_codec.h>
+
+// Slowly varying sensor-like samples: a random walk with small steps.
+std::vector<unsigned short> sensorSamples(size_t n, unsigned seed) {
+    std::vector<unsigned short> v(n);
+    unsigned short x = 2048;
+    srand(seed);
+    for (size_t i = 0; i < n; ++i) {
+        x = (unsigned short) (x + rand() % 17 - 8);
+        v[i] = x;
+    }
+    return v;
+}
+
+void run_codec_bench() {
+    const size_t samples = 1000000;
+    auto x = sensorSamples(samples, 1);
+    cout << "codec " << samples << " samples, raw " << sizeof(unsigned short) << " bytes/sample" << endl;
+
+    const codec_t codecs[2] = {CODEC_DELTA_BITPACK, CODEC_DELTA_VARINT};
+    const char *names[2] = {"delta+bitpack", "zigzag varint"};
+    for (int c = 0; c < 2; ++c) {
+        auto enc = BlockCodec<unsigned short>::encode(x, codecs[c]);
+        auto t0 = std::chrono::steady_clock::now();
+        auto dec = BlockCodec<unsigned short>::decode(enc);
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        cout << "  " << names[c] << ": " << (double) enc.size() / samples << " bytes/sample ("
+             << (double) samples * sizeof(unsigned short) / enc.size() << "x smaller), decode "
+             << samples / s / 1e6 << " Msamples/s" << (dec == x ? "" : ", MISMATCH") << endl;
+    }
+
+    // End to end: input -> addi -> output, raw vectors against compressed streams.
+    std::vector<unsigned short> out;
+    DataFlow<unsigned short> raw(0, "raw");
+    raw.connect(new InputStream<unsigned short>(0, x), new Addi<unsigned short>(1, 1), PORT_A);
+    raw.connect(raw.getOp(1), new OutputStream<unsigned short>(2, out), PORT_A);
+    auto t0 = std::chrono::steady_clock::now();
+    raw.compute();
+    double sRaw = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    auto enc = BlockCodec<unsigned short>::encode(x);
+    std::vector<uint8_t> encOut;
+    DataFlow<unsigned short> packed(0, "packed");
+    packed.connect(new CompressedInputStream<unsigned short>(0, enc), new Addi<unsigned short>(1, 1), PORT_A);
+    packed.connect(packed.getOp(1), new CompressedOutputStream<unsigned short>(2, encOut), PORT_A);
+    t0 = std::chrono::steady_clock::now();
+    packed.compute();
+    double sPacked = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    cout << "  graph raw: " << samples / sRaw / 1e6 << " Msamples/s, "
+         << (x.size() + out.size()) * sizeof(unsigned short) << " bytes moved" << endl;
+    cout << "  graph compressed: " << samples / sPacked / 1e6 << " Msamples/s, " << enc.size() + encOut.size()
+         << " bytes moved" << (BlockCodec<unsigned short>::decode(encOut) == out ? "" : ", MISMATCH") << endl;
+}
+
+#endif //MAIN_CODEC_BENCH_H
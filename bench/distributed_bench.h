@@ -0,0 +1,64 @@
+#ifndef MAIN_DISTRIBUTED_BENCH_H
+#define MAIN_DISTRIBUTED_BENCH_H
+
+#include <chrono>
+#include <distributed.h>
+#include "bench_graph.h"
+
+void run_distributed_bench() {
+    const int copies = 32;
+    const int taps = 16;
+    const int samples = 20000;
+    std::vector<std::vector<unsigned short>> data_in(copies), data_out(copies);
+    for (int j = 0; j < copies; ++j) {
+        for (int i = 0; i < samples; ++i) {
+            data_in[j].push_back((unsigned short) (i + j));
+        }
+    }
+    unsigned long tokens = (unsigned long) copies * samples;
+
+    auto df = benchGraph<unsigned short>(copies, taps, data_in.data(), data_out.data());
+    auto t0 = std::chrono::steady_clock::now();
+    df->compute();
+    double base = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    cout << "distributed " << df->getNumOp() << " nodes, " << tokens << " tokens" << endl;
+    cout << "  single process: " << tokens / base / 1e6 << " Mtokens/s" << endl;
+    delete df;
+
+    const transport_t transports[2] = {TRANSPORT_SHM, TRANSPORT_TCP};
+    for (auto transport:transports) {
+        for (int workers = 1; workers <= 8; workers *= 2) {
+            std::vector<std::vector<unsigned short>> out(copies);
+            df = benchGraph<unsigned short>(copies, taps, data_in.data(), out.data());
+            DistributedRunner<unsigned short> runner(*df, workers, transport);
+            t0 = std::chrono::steady_clock::now();
+            bool ok = runner.run();
+            double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            cout << "  " << (transport == TRANSPORT_SHM ? "shm" : "tcp") << " " << workers << " workers: "
+                 << tokens / s / 1e6 << " Mtokens/s, speedup " << base / s << ", cut " << runner.getCutEdges()
+                 << (ok && out == data_out ? "" : ", MISMATCH") << endl;
+            delete df;
+        }
+    }
+
+    // One long FIR split across processes, so every value crosses the channels.
+    std::vector<std::vector<unsigned short>> chain_out(1);
+    df = benchGraph<unsigned short>(1, 256, data_in.data(), chain_out.data());
+    t0 = std::chrono::steady_clock::now();
+    df->compute();
+    base = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    delete df;
+    for (auto transport:transports) {
+        std::vector<std::vector<unsigned short>> out(1);
+        df = benchGraph<unsigned short>(1, 256, data_in.data(), out.data());
+        DistributedRunner<unsigned short> runner(*df, 4, transport);
+        t0 = std::chrono::steady_clock::now();
+        bool ok = runner.run();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        cout << "  " << (transport == TRANSPORT_SHM ? "shm" : "tcp") << " 256-tap FIR on 4 workers: speedup "
+             << base / s << ", cut " << runner.getCutEdges() << (ok && out == chain_out ? "" : ", MISMATCH") << endl;
+        delete df;
+    }
+}
+
+#endif //MAIN_DISTRIBUTED_BENCH_H
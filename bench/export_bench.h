@@ -0,0 +1,101 @@
+#ifndef MAIN_EXPORT_BENCH_H
+#define MAIN_EXPORT_BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <data_flow.h>
+#include <perf_counters.h>
+#include "bench_graph.h"
+
+// The exporters as they were before BufferedWriter: sprintf into a stack buffer and std::endl per line.
+template<class T>
+void legacyToJSON(DataFlow<T> *df, const std::string &fileNamePath) {
+    std::ofstream myfile;
+    myfile.open(fileNamePath);
+    myfile << "[" << endl;
+    char str_node[] = R"({"data":{"id":"%d","type":"%s"},"group":"nodes"})";
+    char str_edge[] = R"({"data":{"id":"%d","source":"%d","target":"%d"},"group":"edges"})";
+    char buf[256];
+    int numEdge = 0;
+    for (const auto &v:df->getGraph()) {
+        numEdge += v.second.size();
+    }
+    int cnt = 0;
+    int max_id = 0;
+    for (auto item:df->getOpArray()) {
+        sprintf(buf, str_node, item.second->getId(), item.second->getLabel().c_str());
+        max_id = std::max(max_id, item.second->getId());
+        myfile << buf << "," << endl;
+    }
+    int id_edges = max_id + 1;
+    for (auto item:df->getOpArray()) {
+        for (auto neighbor:item.second->getDst()) {
+            cnt++;
+            sprintf(buf, str_edge, id_edges++, item.second->getId(), neighbor->getId());
+            if (cnt < numEdge)
+                myfile << buf << "," << endl;
+            else
+                myfile << buf << endl;
+        }
+    }
+    myfile << "]";
+    myfile.close();
+}
+
+template<class T>
+void legacyToDOT(DataFlow<T> *df, const std::string &fileNamePath) {
+    std::ofstream myfile;
+    myfile.open(fileNamePath);
+    myfile << "digraph " << df->getName() << "{" << std::endl;
+    for (auto op:df->getOpArray()) {
+        myfile << " " << op.first << " [ label = " << op.second->getLabel() << "]" << std::endl;
+    }
+    for (auto op:df->getOpArray()) {
+        for (auto op_dst:op.second->getDst()) {
+            myfile << " " << op.first << " -> " << op_dst->getId() << std::endl;
+        }
+    }
+    myfile << "}" << std::endl;
+    myfile.close();
+}
+
+template<class F>
+void exportCase(const char *name, PerfCounterGroup &perf, unsigned long nodes, F f) {
+    perf_sample_t counters = perfSampleZero();
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        PerfScope scope(perf, counters);
+        f();
+    }
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    cout << "  " << name << ": " << s * 1000 << " ms, " << nodes / s / 1e6 << " Mnodes/s";
+    if (perf.isAvailable()) {
+        cout << ", " << (double) counters.value[PERF_INSTRUCTIONS] / nodes << " instructions/node";
+    }
+    cout << endl;
+}
+
+void run_export_bench() {
+    const int copies = 20000;
+    const int taps = 16;
+    std::vector<std::vector<unsigned short>> data_in(copies), data_out(copies);
+    auto df = benchGraph<unsigned short>(copies, taps, data_in.data(), data_out.data());
+    unsigned long nodes = (unsigned long) df->getNumOp();
+    PerfCounterGroup perf;
+    perf.start();
+
+    cout << "export " << nodes << " nodes, " << df->getNumEdges() << " edges" << endl;
+    exportCase("toJSON legacy", perf, nodes, [&]() { legacyToJSON(df, "bench_export.json"); });
+    exportCase("toJSON", perf, nodes, [&]() { df->toJSON("bench_export.json"); });
+    exportCase("toJSON .gz", perf, nodes, [&]() { df->toJSON("bench_export.json.gz"); });
+    exportCase("toDOT legacy", perf, nodes, [&]() { legacyToDOT(df, "bench_export.dot"); });
+    exportCase("toDOT", perf, nodes, [&]() { df->toDOT("bench_export.dot"); });
+    exportCase("toDOT levels 0-3", perf, nodes, [&]() { df->toDOT("bench_export.dot", 0, 3); });
+    perf.stop();
+    remove("bench_export.json");
+    remove("bench_export.json.gz");
+    remove("bench_export.dot");
+    delete df;
+}
+
+#endif //MAIN_EXPORT_BENCH_H
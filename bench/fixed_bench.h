@@ -0,0 +1,106 @@
+#ifndef MAIN_FIXED_BENCH_H
+#define MAIN_FIXED_BENCH_H
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fixed_point.h>
+
+/*
+ * Direct-form FIR y[i] = sum coef[k] * x[i - k]. Tap k reads a delay line of PassA registers;
+ * after updateOpLevel() the registers are moved below the input in reverse order, so each one
+ * copies its predecessor before that one is overwritten and holds the sample of k cycles ago.
+ */
+template<class T>
+DataFlow<T> *fixedFIR(const std::vector<T> &coef, std::vector<T> &data_in, std::vector<T> &data_out) {
+    auto df = new DataFlow<T>(0, "fir");
+    int idx = 0;
+    auto in = new InputStream<T>(idx++, data_in);
+    auto out = new OutputStream<T>(idx++, data_out);
+    std::vector<Operator<T> *> delay(1, in);
+    Operator<T> *prev = nullptr;
+    for (size_t i = 0; i < coef.size(); ++i) {
+        if (i > 0) {
+            auto reg = new PassA<T>(idx++);
+            df->link(delay.back(), reg, PORT_A);
+            delay.push_back(reg);
+        }
+        auto m = new Multi<T>(idx++, coef[i]);
+        Operator<T> *op = i == 0 ? (Operator<T> *) new PassA<T>(idx++) : (Operator<T> *) new Add<T>(idx++);
+        df->link(delay.back(), m, PORT_A);
+        df->link(m, op, PORT_A);
+        if (prev) {
+            df->link(prev, op, PORT_B);
+        }
+        prev = op;
+    }
+    df->link(prev, out, PORT_A);
+    df->updateOpLevel();
+    int regs = (int) delay.size() - 1;
+    for (auto item:df->getOpArray()) {
+        item.second->setLevel(item.second->getLevel() + regs);
+    }
+    for (int k = 1; k <= regs; ++k) {
+        delay[k]->setLevel(regs - k);
+    }
+    df->setMaxLevel(df->getMaxLevel() + regs);
+    return df;
+}
+
+void run_fixed_bench() {
+    // Accuracy of a 16-tap low-pass FIR on a loud signal: Q15 against the double result.
+    const int taps = 16;
+    const int samples = 20000;
+    std::vector<double> coef(taps), x(samples);
+    std::vector<q15_t> qcoef, qx;
+    for (int i = 0; i < taps; ++i) {
+        coef[i] = 0.9 / taps;
+        qcoef.push_back(q15_t(coef[i]));
+    }
+    srand(3);
+    for (int i = 0; i < samples; ++i) {
+        x[i] = 0.95 * sin(i * 0.01) + 0.04 * (rand() % 200 - 100) / 100.0;
+        qx.push_back(q15_t(x[i]));
+    }
+    std::vector<q15_t> qy;
+    auto df = fixedFIR<q15_t>(qcoef, qx, qy);
+    auto t0 = std::chrono::steady_clock::now();
+    df->compute();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    double err = 0;
+    for (int i = 0; i < samples && i < (int) qy.size(); ++i) {
+        double y = 0;
+        for (int k = 0; k < taps && k <= i; ++k) {
+            y += coef[k] * x[i - k];
+        }
+        err = std::max(err, std::fabs(y - (double) qy[i]));
+    }
+    cout << "fixed Q15 " << taps << "-tap FIR: " << samples / s / 1e6 << " Msamples/s, max error " << err << " ("
+         << err * 32768 << " LSB)" << endl;
+    delete df;
+
+    // Block kernels: the scalar template loop against the SIMD overloads.
+    const size_t n = 1 << 16;
+    const int reps = 200;
+    std::vector<q15_t> a(n), b(n), o(n);
+    for (size_t i = 0; i < n; ++i) {
+        a[i] = q15_t::fromRaw((int16_t) rand());
+        b[i] = q15_t::fromRaw((int16_t) rand());
+    }
+    auto time = [&](const std::function<void()> &fn) {
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < reps; ++r) {
+            fn();
+        }
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return (double) n * reps / s / 1e9;
+    };
+    double addScalar = time([&]() { addSat<15, int16_t>(a.data(), b.data(), o.data(), n); });
+    double addVector = time([&]() { addSat(a.data(), b.data(), o.data(), n); });
+    double mulScalar = time([&]() { mulFixed<15, int16_t>(a.data(), b.data(), o.data(), n); });
+    double mulVector = time([&]() { mulFixed(a.data(), b.data(), o.data(), n); });
+    cout << "  kernels (Gvalues/s): saturating add scalar " << addScalar << ", block " << addVector
+         << "; Q15 multiply scalar " << mulScalar << ", block " << mulVector << endl;
+}
+
+#endif //MAIN_FIXED_BENCH_H
@@ -0,0 +1,40 @@
+#include "async_bench.h"
+#include "builder_bench.h"
+#include "codec_bench.h"
+#include "distributed_bench.h"
+#include "export_bench.h"
+#include "fixed_bench.h"
+#include "multirate_bench.h"
+#include "native_bench.h"
+#include "numa_bench.h"
+#include "plan_bench.h"
+#include "probe_bench.h"
+#include "replicate_bench.h"
+#include "schedule_bench.h"
+#include "seal_bench.h"
+#include "tune_bench.h"
+#include "width_bench.h"
+
+using namespace std;
+
+int main() {
+
+    run_export_bench();
+    run_distributed_bench();
+    run_codec_bench();
+    run_numa_bench();
+    run_replicate_bench();
+    run_async_bench();
+    run_multirate_bench();
+    run_plan_bench();
+    run_probe_bench();
+    run_builder_bench();
+    run_fixed_bench();
+    run_seal_bench();
+    run_width_bench();
+    run_native_bench();
+    run_schedule_bench();
+    run_tune_bench();
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#ifndef MAIN_MULTIRATE_BENCH_H
+#define MAIN_MULTIRATE_BENCH_H
+
+#include <chrono>
+#include <numa_placement.h>
+
+// FIR followed by a decimator (or a plain register when k == 1) and a chain of post-processing operators.
+template<class T>
+DataFlow<T> *decimatorGraph(int copies, int taps, int post, int k, std::vector<T> *data_in, std::vector<T> *data_out) {
+    auto df = new DataFlow<T>(0, "decimator");
+    int idx = 0;
+    for (int j = 0; j < copies; ++j) {
+        auto in = new InputStream<T>(idx++, data_in[j]);
+        auto out = new OutputStream<T>(idx++, data_out[j]);
+        Operator<T> *prev = nullptr;
+        for (int i = 0; i < taps; ++i) {
+            auto m = new Multi<T>(idx++, (T) (i + 1));
+            Operator<T> *op = i == 0 ? (Operator<T> *) new PassA<T>(idx++) : (Operator<T> *) new Add<T>(idx++);
+            df->link(in, m, PORT_A);
+            df->link(m, op, PORT_A);
+            if (prev) {
+                df->link(prev, op, PORT_B);
+            }
+            prev = op;
+        }
+        Operator<T> *down = k > 1 ? (Operator<T> *) new Downsample<T>(idx++, k) : (Operator<T> *) new PassA<T>(idx++);
+        df->link(prev, down, PORT_A);
+        prev = down;
+        for (int i = 0; i < post; ++i) {
+            auto op = new Addi<T>(idx++, (T) 1);
+            df->link(prev, op, PORT_A);
+            prev = op;
+        }
+        df->link(prev, out, PORT_A);
+    }
+    df->updateOpLevel();
+    return df;
+}
+
+void run_multirate_bench() {
+    const int copies = 8;
+    const int taps = 16;
+    const int post = 64;
+    const int samples = 4000;
+    std::vector<std::vector<unsigned short>> data_in(copies);
+    for (int j = 0; j < copies; ++j) {
+        for (int i = 0; i < samples; ++i) {
+            data_in[j].push_back((unsigned short) (i + j));
+        }
+    }
+    cout << "multirate " << copies << " x (" << taps << "-tap FIR, decimator, " << post << " ops)" << endl;
+    for (int k = 1; k <= 8; k *= 8) {
+        std::vector<std::vector<unsigned short>> out(copies);
+        auto df = decimatorGraph<unsigned short>(copies, taps, post, k, data_in.data(), out.data());
+        auto t0 = std::chrono::steady_clock::now();
+        df->compute();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        size_t outputs = out[0].size();
+        for (auto &o:out) {
+            o.clear();
+        }
+        df->reset();
+        NumaExecutor<unsigned short> executor(*df, 1, false);
+        executor.run();
+        cout << "  k = " << k << ": compute() " << s * 1e3 << " ms, level-list executor " << executor.getSeconds() * 1e3
+             << " ms, " << outputs << " outputs per copy" << endl;
+        delete df;
+    }
+}
+
+#endif //MAIN_MULTIRATE_BENCH_H
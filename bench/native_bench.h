@@ -0,0 +1,41 @@
+#ifndef MAIN_NATIVE_BENCH_H
+#define MAIN_NATIVE_BENCH_H
+
+#include <chrono>
+#include <native_kernel.h>
+#include "bench_graph.h"
+
+// Sealed compute() against the graph compiled by NativeKernel, cached in the working directory.
+void run_native_bench() {
+    const int copies = 50;
+    const int taps = 16;
+    const int samples = 2000;
+    std::vector<std::vector<unsigned short>> data_in(copies), sealed(copies), native(copies);
+    for (int j = 0; j < copies; ++j) {
+        for (int i = 0; i < samples; ++i) {
+            data_in[j].push_back((unsigned short) (i * 3 + j));
+        }
+    }
+    auto df = benchGraph<unsigned short>(copies, taps, data_in.data(), sealed.data());
+    df->seal();
+    df->reset();
+    auto t0 = std::chrono::steady_clock::now();
+    df->compute();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    df->reset();
+    df->rebind(data_in.data(), native.data());
+    NativeKernel<unsigned short> kernel(".");
+    t0 = std::chrono::steady_clock::now();
+    bool ok = kernel.load(*df);
+    double load = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    t0 = std::chrono::steady_clock::now();
+    kernel.compute();
+    double fast = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    cout << "native " << df->getNumOp() << " ops x " << samples << " samples: sealed " << s * 1e3 << " ms, "
+         << (kernel.isCached() ? "cached" : "compiled") << " in " << load * 1e3 << " ms, native " << fast * 1e3
+         << " ms" << (ok && sealed == native ? "" : ", MISMATCH " + kernel.getError()) << endl;
+    delete df;
+}
+
+#endif //MAIN_NATIVE_BENCH_H
@@ -0,0 +1,47 @@
+#ifndef MAIN_NUMA_BENCH_H
+#define MAIN_NUMA_BENCH_H
+
+#include <chrono>
+#include <numa_placement.h>
+#include "bench_graph.h"
+
+void run_numa_bench() {
+    const int copies = 32;
+    const int taps = 16;
+    const int samples = 20000;
+    std::vector<std::vector<unsigned short>> data_in(copies), data_out(copies);
+    for (int j = 0; j < copies; ++j) {
+        for (int i = 0; i < samples; ++i) {
+            data_in[j].push_back((unsigned short) (i + j));
+        }
+    }
+    unsigned long tokens = (unsigned long) copies * samples;
+
+    auto df = benchGraph<unsigned short>(copies, taps, data_in.data(), data_out.data());
+    auto t0 = std::chrono::steady_clock::now();
+    df->compute();
+    double base = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    NumaTopology topology;
+    cout << "numa " << topology.getNumNodes() << " nodes, " << df->getNumOp() << " ops, " << tokens << " tokens"
+         << endl;
+    cout << "  single thread: " << tokens / base / 1e6 << " Mtokens/s" << endl;
+    delete df;
+
+    for (int aware = 0; aware <= 1; ++aware) {
+        for (int workers = 1; workers <= 8; workers *= 2) {
+            std::vector<std::vector<unsigned short>> out(copies);
+            df = benchGraph<unsigned short>(copies, taps, data_in.data(), out.data());
+            NumaExecutor<unsigned short> executor(*df, workers, aware != 0);
+            executor.run();
+            auto l = executor.getLocality();
+            double s = executor.getSeconds();
+            cout << "  " << (aware ? "numa-aware" : "default") << " " << workers << " workers: "
+                 << tokens / s / 1e6 << " Mtokens/s, speedup " << base / s << ", pages local " << l.local
+                 << " remote " << l.remote << " shared " << l.shared << " unknown " << l.unknown << (out == data_out ? "" : ", MISMATCH")
+                 << endl;
+            delete df;
+        }
+    }
+}
+
+#endif //MAIN_NUMA_BENCH_H
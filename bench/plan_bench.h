@@ -0,0 +1,42 @@
+#ifndef MAIN_PLAN_BENCH_H
+#define MAIN_PLAN_BENCH_H
+
+#include <chrono>
+#include <plan_cache.h>
+#include "bench_graph.h"
+
+// Cold start (link + updateOpLevel, plan stored) against warm start (link + cached plan).
+void run_plan_bench() {
+    const int taps = 16;
+    PlanCache<unsigned short> cache(".");
+    for (int copies = 100; copies <= 1000; copies *= 10) {
+        std::vector<std::vector<unsigned short>> data_in(copies), data_out(copies);
+        auto t0 = std::chrono::steady_clock::now();
+        auto df = benchGraph<unsigned short>(copies, taps, data_in.data(), data_out.data(), false);
+        double built = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        remove(cache.pathFor(structuralHash(*df)).c_str());
+        t0 = std::chrono::steady_clock::now();
+        bool hit = cache.prepare(*df);
+        double cold = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::vector<int> levels;
+        for (auto item:df->getOpArray()) {
+            levels.push_back(item.second->getLevel());
+        }
+        delete df;
+
+        df = benchGraph<unsigned short>(copies, taps, data_in.data(), data_out.data(), false);
+        t0 = std::chrono::steady_clock::now();
+        hit = cache.prepare(*df) && !hit;
+        double warm = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::vector<int> cached;
+        for (auto item:df->getOpArray()) {
+            cached.push_back(item.second->getLevel());
+        }
+        cout << "plan " << df->getNumOp() << " ops: link " << built * 1e3 << " ms, leveling " << cold * 1e3
+             << " ms, cached plan " << warm * 1e3 << " ms" << (hit && cached == levels ? "" : ", MISMATCH") << endl;
+        remove(cache.pathFor(structuralHash(*df)).c_str());
+        delete df;
+    }
+}
+
+#endif //MAIN_PLAN_BENCH_H
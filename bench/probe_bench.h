@@ -0,0 +1,64 @@
+#ifndef MAIN_PROBE_BENCH_H
+#define MAIN_PROBE_BENCH_H
+
+#include <chrono>
+#include <probe.h>
+#include "bench_graph.h"
+
+// compute() with no probe, with probes on internal edges, and with OutputStream taps on the same edges instead.
+void run_probe_bench() {
+    const int copies = 20;
+    const int taps = 16;
+    const int samples = 4000;
+    std::vector<std::vector<unsigned short>> data_in(copies), data_out(copies);
+    for (int j = 0; j < copies; ++j) {
+        for (int i = 0; i < samples; ++i) {
+            data_in[j].push_back((unsigned short) (i + j));
+        }
+    }
+    auto df = benchGraph<unsigned short>(copies, taps, data_in.data(), data_out.data());
+    // The accumulator after the 8th tap of each copy (ids as laid out by benchGraph).
+    std::vector<int> tapped;
+    for (int j = 0; j < copies; ++j) {
+        tapped.push_back(j * (2 + 2 * taps) + 2 + 2 * 8 + 1);
+    }
+    auto time = [&]() {
+        df->reset();
+        for (auto &o:data_out) {
+            o.clear();
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        df->compute();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    };
+    double bare = time();
+
+    std::vector<Probe<unsigned short> *> probes;
+    for (auto id:tapped) {
+        probes.push_back(new Probe<unsigned short>(samples));
+        df->attachProbe(id, probes.back());
+    }
+    double probed = time();
+    size_t recorded = 0;
+    for (auto p:probes) {
+        std::vector<Probe<unsigned short>::Sample> s;
+        recorded += p->read(s);
+        df->detachProbe(p);
+        delete p;
+    }
+
+    std::vector<std::vector<unsigned short>> tap_out(copies);
+    int idx = df->getOpArray().rbegin()->first + 1;
+    for (int j = 0; j < copies; ++j) {
+        df->link(df->getOp(tapped[j]), new OutputStream<unsigned short>(idx++, tap_out[j]), PORT_A);
+    }
+    df->updateOpLevel();
+    double tapped_out = time();
+
+    cout << "probe " << copies << " x " << taps << "-tap FIR: bare " << bare * 1e3 << " ms, " << copies << " probes "
+         << probed * 1e3 << " ms (" << recorded << " samples), " << copies << " OutputStream taps " << tapped_out * 1e3
+         << " ms" << endl;
+    delete df;
+}
+
+#endif //MAIN_PROBE_BENCH_H
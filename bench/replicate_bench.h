@@ -0,0 +1,33 @@
+#ifndef MAIN_REPLICATE_BENCH_H
+#define MAIN_REPLICATE_BENCH_H
+
+#include <chrono>
+#include "bench_graph.h"
+
+// Builds `copies` FIR copies by linking every copy and leveling once, and by replicating the first copy.
+void run_replicate_bench() {
+    const int taps = 16;
+    for (int copies = 1000; copies <= 10000; copies *= 10) {
+        std::vector<std::vector<unsigned short>> data_in(copies), data_out(copies);
+        auto t0 = std::chrono::steady_clock::now();
+        auto df = benchGraph<unsigned short>(copies, taps, data_in.data(), data_out.data());
+        double linked = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        int ops = df->getNumOp();
+        delete df;
+
+        t0 = std::chrono::steady_clock::now();
+        df = benchGraph<unsigned short>(1, taps, data_in.data(), data_out.data());
+        std::vector<int> first;
+        for (auto item:df->getOpArray()) {
+            first.push_back(item.first);
+        }
+        df->replicate(first, copies - 1, data_in.data() + 1, data_out.data() + 1);
+        double replicated = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        cout << "replicate " << copies << " copies, " << ops << " ops: link + level " << linked * 1e3
+             << " ms, replicate " << replicated * 1e3 << " ms" << (ops == df->getNumOp() ? "" : ", MISMATCH")
+             << endl;
+        delete df;
+    }
+}
+
+#endif //MAIN_REPLICATE_BENCH_H
@@ -0,0 +1,42 @@
+#ifndef MAIN_SCHEDULE_BENCH_H
+#define MAIN_SCHEDULE_BENCH_H
+
+#include <chrono>
+#include <schedule.h>
+#include "bench_graph.h"
+
+// Analysis, list schedule and register balancing of a ~100k-node FIR graph on a small CGRA.
+void run_schedule_bench() {
+    const int copies = 1500;
+    const int taps = 32;
+    std::vector<std::vector<unsigned short>> data_in(copies), data_out(copies);
+    auto df = benchGraph<unsigned short>(copies, taps, data_in.data(), data_out.data());
+    const int units[FU_NUM_TYPES] = {64, 32, 8, 8, 16};
+    ScheduleAnalysis<unsigned short> sa(*df);
+    sa.setLatency(FU_MULT, 3);
+
+    auto t0 = std::chrono::steady_clock::now();
+    bool ok = sa.analyze();
+    double analyzed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    t0 = std::chrono::steady_clock::now();
+    int length = sa.listSchedule(units);
+    double scheduled = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    int mii = sa.minII(units);
+
+    // Balanced against the unconstrained (ASAP) schedule, as a fully spatial mapping would be.
+    const int unlimited[FU_NUM_TYPES] = {0, 0, 0, 0, 0};
+    int ops = df->getNumOp();
+    t0 = std::chrono::steady_clock::now();
+    sa.listSchedule(unlimited);
+    long registers = sa.getNumBalancingRegisters();
+    long inserted = sa.insertBalancingRegisters();
+    double balanced = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    cout << "schedule " << ops << " ops: analyze " << analyzed * 1e3 << " ms, list schedule " << scheduled * 1e3
+         << " ms (" << length << " cycles, min II " << mii << "), " << inserted << " balancing registers in "
+         << balanced * 1e3 << " ms"
+         << (ok && inserted == registers && df->getNumOp() == ops + inserted && sa.getNumOps(FU_ALU) >= inserted ?
+             "" : ", MISMATCH") << endl;
+    delete df;
+}
+
+#endif //MAIN_SCHEDULE_BENCH_H
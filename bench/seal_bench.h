@@ -0,0 +1,37 @@
+#ifndef MAIN_SEAL_BENCH_H
+#define MAIN_SEAL_BENCH_H
+
+#include <chrono>
+#include "bench_graph.h"
+
+// compute() on the same graph before and after seal().
+void run_seal_bench() {
+    const int copies = 50;
+    const int taps = 16;
+    const int samples = 2000;
+    std::vector<std::vector<unsigned short>> data_in(copies), checked(copies), sealed(copies);
+    for (int j = 0; j < copies; ++j) {
+        for (int i = 0; i < samples; ++i) {
+            data_in[j].push_back((unsigned short) (i * 3 + j));
+        }
+    }
+    auto df = benchGraph<unsigned short>(copies, taps, data_in.data(), checked.data());
+    auto t0 = std::chrono::steady_clock::now();
+    df->compute();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    df->rebind(data_in.data(), sealed.data());
+    std::vector<std::string> errors;
+    bool ok = df->seal(&errors);
+    t0 = std::chrono::steady_clock::now();
+    df->compute();
+    double fast = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    cout << "seal " << df->getNumOp() << " ops x " << samples << " samples: checked " << s * 1e3 << " ms, sealed "
+         << fast * 1e3 << " ms" << (ok && checked == sealed ? "" : ", MISMATCH") << endl;
+    for (auto &e:errors) {
+        cout << "  " << e << endl;
+    }
+    delete df;
+}
+
+#endif //MAIN_SEAL_BENCH_H
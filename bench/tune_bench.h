@@ -0,0 +1,58 @@
+#ifndef MAIN_TUNE_BENCH_H
+#define MAIN_TUNE_BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <autotuner.h>
+#include "bench_graph.h"
+
+void run_tune_bench() {
+    const int copies = 16;
+    const int taps = 16;
+    const int samples = 50000;
+    const double budget = 0.5;
+    const char *cache = "tune_bench.cache";
+    std::vector<std::vector<unsigned short>> data_in(copies), data_out(copies);
+    for (int j = 0; j < copies; ++j) {
+        for (int i = 0; i < samples; ++i) {
+            data_in[j].push_back((unsigned short) (i * (j + 1)));
+        }
+    }
+    remove(cache);
+
+    auto df = benchGraph<unsigned short>(copies, taps, data_in.data(), data_out.data());
+    Autotuner<unsigned short> tuner(cache, budget, samples);
+    auto t0 = std::chrono::steady_clock::now();
+    auto best = tuner.tune(*df);
+    double miss = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    cout << "tune " << df->getNumOp() << " ops, budget " << budget << " s: " << tuner.getTrials().size()
+         << " trials in " << miss << " s" << endl;
+    for (auto &c:tuner.getTrials()) {
+        cout << "  " << engine_names[c.engine] << " " << c.workers << " workers" << (c.numa ? " numa" : "")
+             << (c.batch ? " batch " + std::to_string(c.batch) : "") << ": " << c.tokensPerSec / 1e6
+             << " Mtokens/s" << endl;
+    }
+
+    t0 = std::chrono::steady_clock::now();
+    auto cached = tuner.tune(*df);
+    double hit = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    cout << "  picked " << engine_names[best.engine] << " " << best.workers << " workers, cached lookup "
+         << hit * 1e3 << " ms" << (cached.engine == best.engine && cached.workers == best.workers ? "" : ", MISMATCH")
+         << endl;
+
+    // The picked engine on the whole input, against the serial run.
+    std::vector<std::vector<unsigned short>> ref(copies);
+    auto serial = benchGraph<unsigned short>(copies, taps, data_in.data(), ref.data());
+    serial->compute();
+    df->reset();
+    t0 = std::chrono::steady_clock::now();
+    bool ok = Autotuner<unsigned short>::run(*df, best);
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    cout << "  full run: " << (double) copies * samples / s / 1e6 << " Mtokens/s"
+         << (ok && data_out == ref ? "" : ", MISMATCH") << endl;
+    delete serial;
+    delete df;
+    remove(cache);
+}
+
+#endif //MAIN_TUNE_BENCH_H
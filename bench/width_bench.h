@@ -0,0 +1,69 @@
+#ifndef MAIN_WIDTH_BENCH_H
+#define MAIN_WIDTH_BENCH_H
+
+#include <chrono>
+#include <bit_width.h>
+
+// 8-bit samples through int FIRs clipped by a predicate and a mux: sealed compute() against packed lanes.
+void widthCase(int copies, int samples) {
+    const int taps = 16;
+    std::vector<std::vector<int>> data_in(copies), sealed(copies), packed(copies);
+    for (int j = 0; j < copies; ++j) {
+        for (int i = 0; i < samples; ++i) {
+            data_in[j].push_back((i * 37 + j * 11) & 0xff);
+        }
+    }
+    auto df = new DataFlow<int>(0, "width");
+    int idx = 0;
+    for (int j = 0; j < copies; ++j) {
+        auto in = new InputStream<int>(idx++, data_in[j]);
+        auto out = new OutputStream<int>(idx++, sealed[j]);
+        Operator<int> *sum = nullptr;
+        for (int i = 0; i < taps; ++i) {
+            auto m = new Multi<int>(idx++, i + 1);
+            df->link(in, m, PORT_A);
+            if (sum) {
+                auto add = new Add<int>(idx++);
+                df->link(sum, add, PORT_A);
+                df->link(m, add, PORT_B);
+                sum = add;
+            } else {
+                sum = m;
+            }
+        }
+        auto under = new Slti<int>(idx++, 20000);
+        auto clip = new Muxi<int>(idx++, 20000);
+        df->link(sum, under, PORT_A);
+        df->link(sum, clip, PORT_A);
+        df->link(under, clip, PORT_BRANCH);
+        df->link(clip, out, PORT_A);
+    }
+    df->updateOpLevel();
+    df->seal();
+    auto t0 = std::chrono::steady_clock::now();
+    df->compute();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    WidthAnalysis<int> widths;
+    widths.analyze(*df);
+    df->rebind(data_in.data(), packed.data());
+    PackedExecutor<int> exec(*df, widths);
+    t0 = std::chrono::steady_clock::now();
+    exec.compute();
+    double fast = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    cout << "width " << df->getNumOp() << " ops: " << widths.getCount(W_BIT) << " 1-bit, "
+         << widths.getCount(W_U8) + widths.getCount(W_S8) << " 8-bit, "
+         << widths.getCount(W_U16) + widths.getCount(W_S16) << " 16-bit, " << widths.getCount(W_FULL)
+         << " full; values " << widths.getUniformBytes() << " -> " << exec.getValueBytes() << " bytes; sealed "
+         << s * 1e3 << " ms, packed " << fast * 1e3 << " ms"
+         << (exec.isSupported() && sealed == packed ? "" : ", MISMATCH") << endl;
+    delete df;
+}
+
+// The same number of firings on 1.75k and on 70k operators, where the values no longer fit in cache.
+void run_width_bench() {
+    widthCase(50, 2000);
+    widthCase(2000, 50);
+}
+
+#endif //MAIN_WIDTH_BENCH_H
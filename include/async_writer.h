@@ -0,0 +1,297 @@
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <operator.h>
+
+/*
+ * File written by a background thread. The caller fills one of 2-3 fixed buffers and hands
+ * it over with submit(); the writer thread takes every submitted buffer in one writev() and
+ * hands them back. Both hand-offs are single-producer/single-consumer rings of buffer
+ * indices, so neither side takes a lock. The caller only waits when every buffer is still
+ * queued for writing, and that wait is accounted as stall time.
+ *
+ * With direct, the file is opened with O_DIRECT (when the file system allows it) and buffers
+ * are page-aligned multiples of the page size; the final partial buffer is written without it.
+ * A file that cannot be opened, buffers that cannot be allocated (no writer thread is started
+ * and writes are dropped) or a failed write or close make good() false, and close() reports it.
+ */
+class AsyncFileWriter {
+private:
+    static const unsigned MAX_BUFFERS = 4;
+
+    struct Ring {
+        std::atomic<unsigned> head;
+        char pad0[64 - sizeof(std::atomic<unsigned>)];
+        std::atomic<unsigned> tail;
+        char pad1[64 - sizeof(std::atomic<unsigned>)];
+        unsigned slot[MAX_BUFFERS];
+
+        Ring() : head(0), tail(0) {}
+
+        void push(unsigned v) {
+            unsigned h = head.load(std::memory_order_relaxed);
+            slot[h % MAX_BUFFERS] = v;
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        bool pop(unsigned &v) {
+            unsigned t = tail.load(std::memory_order_relaxed);
+            if (t == head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            v = slot[t % MAX_BUFFERS];
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+    };
+
+    int fd;
+    bool direct;
+    size_t size;
+    std::vector<char *> buffers;
+    std::vector<size_t> lengths;
+    Ring filled;
+    Ring spare;
+    unsigned current;
+    size_t pos;
+    std::atomic<bool> stopping;
+    std::atomic<unsigned long long> written;
+    std::atomic<bool> failed;
+    unsigned long long stallNs;
+    std::thread writer;
+
+    void writeLoop() {
+        int idle = 0;
+        for (;;) {
+            unsigned batch[MAX_BUFFERS], n = 0, b;
+            // Read before draining: once close() has asked to stop, every buffer is already queued.
+            bool stop = stopping.load(std::memory_order_acquire);
+            while (n < MAX_BUFFERS && filled.pop(b)) {
+                batch[n++] = b;
+            }
+            if (n == 0) {
+                if (stop) {
+                    return;
+                }
+                if (++idle < 64) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+                continue;
+            }
+            idle = 0;
+            AsyncFileWriter::writeBuffers(batch, n);
+            for (unsigned i = 0; i < n; ++i) {
+                spare.push(batch[i]);
+            }
+        }
+    }
+
+    void writeBuffers(const unsigned *batch, unsigned n) {
+        struct iovec iov[MAX_BUFFERS];
+        size_t total = 0;
+        for (unsigned i = 0; i < n; ++i) {
+            iov[i].iov_base = buffers[batch[i]];
+            iov[i].iov_len = lengths[batch[i]];
+            total += lengths[batch[i]];
+            if (direct && lengths[batch[i]] % size) {
+                // Only the last buffer is ever partial; O_DIRECT needs whole blocks.
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+                direct = false;
+            }
+        }
+        struct iovec *v = iov;
+        while (total && !failed.load(std::memory_order_relaxed)) {
+            ssize_t w = writev(fd, v, (int) n);
+            if (w < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                failed.store(true, std::memory_order_relaxed);
+                return;
+            }
+            written.fetch_add((unsigned long long) w, std::memory_order_relaxed);
+            total -= (size_t) w;
+            while (n && (size_t) w >= v->iov_len) {
+                w -= v->iov_len;
+                v++;
+                n--;
+            }
+            if (n) {
+                v->iov_base = (char *) v->iov_base + w;
+                v->iov_len -= (size_t) w;
+            }
+        }
+    }
+
+public:
+    explicit AsyncFileWriter(const std::string &fileNamePath, size_t bufferSize = 1 << 20, unsigned numBuffers = 3,
+                             bool direct = false) : fd(-1), direct(false), current(0), pos(0), stopping(false),
+                                                    written(0), failed(false), stallNs(0) {
+        size_t page = (size_t) sysconf(_SC_PAGESIZE);
+        size = (bufferSize + page - 1) / page * page;
+        numBuffers = numBuffers < 2 ? 2 : numBuffers > MAX_BUFFERS ? MAX_BUFFERS : numBuffers;
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+        if (direct) {
+            fd = open(fileNamePath.c_str(), flags | O_DIRECT, 0644);
+            AsyncFileWriter::direct = fd >= 0;
+        }
+#endif
+        if (fd < 0) {
+            fd = open(fileNamePath.c_str(), flags, 0644);
+        }
+        for (unsigned i = 0; i < numBuffers; ++i) {
+            void *p = nullptr;
+            if (posix_memalign(&p, page, size) != 0) {
+                break;
+            }
+            buffers.push_back((char *) p);
+            lengths.push_back(0);
+            if (i > 0) {
+                spare.push(i);
+            }
+        }
+        if (fd < 0 || buffers.size() < numBuffers) {
+            failed.store(true, std::memory_order_relaxed);
+            return;
+        }
+        writer = std::thread(&AsyncFileWriter::writeLoop, this);
+    }
+
+    ~AsyncFileWriter() {
+        AsyncFileWriter::close();
+        for (auto b:buffers) {
+            free(b);
+        }
+    }
+
+    AsyncFileWriter(const AsyncFileWriter &) = delete;
+
+    AsyncFileWriter &operator=(const AsyncFileWriter &) = delete;
+
+    bool isOpen() const {
+        return fd >= 0;
+    }
+
+    bool isDirect() const {
+        return direct;
+    }
+
+    // Appends n bytes, handing each buffer to the writer as it fills up. Dropped once closed or never started.
+    void write(const void *p, size_t n) {
+        if (!writer.joinable()) {
+            failed.store(true, std::memory_order_relaxed);
+            return;
+        }
+        auto s = (const char *) p;
+        while (n) {
+            size_t k = std::min(n, size - pos);
+            memcpy(buffers[current] + pos, s, k);
+            pos += k;
+            s += k;
+            n -= k;
+            if (pos == size) {
+                AsyncFileWriter::submit();
+            }
+        }
+    }
+
+    // Hands the current buffer, full or not, to the writer and takes a free one.
+    void submit() {
+        if (pos == 0 || !writer.joinable()) {
+            return;
+        }
+        lengths[current] = pos;
+        filled.push(current);
+        pos = 0;
+        if (!spare.pop(current)) {
+            auto t0 = std::chrono::steady_clock::now();
+            while (!spare.pop(current)) {
+                std::this_thread::yield();
+            }
+            stallNs += (unsigned long long) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - t0).count();
+        }
+    }
+
+    // False once opening, allocating, writing or closing has failed.
+    bool good() const {
+        return !failed.load(std::memory_order_relaxed);
+    }
+
+    /*
+     * Writes out everything submitted so far and the partial buffer, stops the writer thread
+     * and closes the file; returns good().
+     */
+    bool close() {
+        if (writer.joinable()) {
+            AsyncFileWriter::submit();
+            stopping.store(true, std::memory_order_release);
+            writer.join();
+        }
+        if (fd >= 0) {
+            if (::close(fd) != 0) {
+                failed.store(true, std::memory_order_relaxed);
+            }
+            fd = -1;
+        }
+        return AsyncFileWriter::good();
+    }
+
+    // Time the caller spent waiting for a free buffer.
+    unsigned long long getStallNs() const {
+        return stallNs;
+    }
+
+    unsigned long long getBytesWritten() const {
+        return written.load(std::memory_order_relaxed);
+    }
+};
+
+// OutputStream that appends the raw bytes of every value to an AsyncFileWriter (not owned).
+template<class T>
+class AsyncOutputStream : public Operator<T> {
+private:
+    AsyncFileWriter *writer;
+
+public:
+    AsyncOutputStream(int id, AsyncFileWriter &writer) : Operator<T>(id, OP_PASS_A, OP_OUT, "output"),
+                                                         writer(&writer) {}
+
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new AsyncOutputStream<T>(*this), newId);
+    }
+
+    void compute() override {
+        if (Operator<T>::getSrcA()) {
+            auto v = Operator<T>::getSrcA()->getVal();
+            Operator<T>::setVal(v);
+            writer->write(&v, sizeof(v));
+        }
+    }
+
+    // Submits the partial buffer so the file is complete once the writer drains its queue.
+    void flush() override {
+        writer->submit();
+    }
+
+    void setWriter(AsyncFileWriter &w) {
+        writer = &w;
+    }
+};
+
+#endif //ASYNC_WRITER_H
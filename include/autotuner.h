@@ -0,0 +1,289 @@
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <data_flow.h>
+#include <distributed.h>
+#include <numa_placement.h>
+#include <plan_cache.h>
+
+typedef enum {
+    ENGINE_SERIAL = 0,
+    ENGINE_THREADS = 1,
+    ENGINE_PROCESSES = 2
+} engine_t;
+
+static const char *const engine_names[] = {"serial", "threads", "processes"};
+
+// Values per input of the serial run that sizes the trials.
+static const unsigned long TUNE_PROBE_TOKENS = 256;
+
+typedef struct {
+    engine_t engine;
+    int workers;
+    bool numa;
+    uint32_t batch;
+    double tokensPerSec;
+} tune_config_t;
+
+// The shape of a graph that decides which engine pays off.
+typedef struct {
+    int ops;
+    int edges;
+    int inputs;
+    int outputs;
+    int depth;
+    int maxWidth;
+    double meanWidth;
+    int maxFanOut;
+    int components;
+} graph_profile_t;
+
+/*
+ * Picks how to run a DataFlow: serially with compute(), on threads with NumaExecutor or on
+ * forked processes with DistributedRunner, and with how many workers and what channel batch.
+ * tune() first looks the graph up by structuralHash() in the cache file; on a miss it runs each
+ * candidate on the first values of every input until the time budget runs out, stores the
+ * fastest and restores the graph. Nothing is tuned unless tune() is called.
+ *
+ * A trial cannot be stopped halfway, so the budget is kept by sizing them: a short serial run
+ * cuts the trials (at most trialTokens values per input) to what the serial engine handles in
+ * an equal share of the budget, and no trial starts unless the slowest one so far still fits in
+ * what is left. Only an engine much slower than the serial one can overrun, by its one trial.
+ */
+template<class T>
+class Autotuner {
+private:
+    std::string cachePath;
+    double budget;
+    unsigned long trialTokens;
+    std::vector<tune_config_t> trials;
+
+    static tune_config_t config(engine_t engine, int workers, bool numa, uint32_t batch) {
+        tune_config_t c = {engine, workers, numa, batch, 0};
+        return c;
+    }
+
+    static std::string hex(uint64_t v) {
+        char s[17];
+        snprintf(s, sizeof(s), "%016llx", (unsigned long long) v);
+        return s;
+    }
+
+    std::map<std::string, tune_config_t> load() const {
+        std::map<std::string, tune_config_t> cache;
+        std::ifstream in(cachePath);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string key, engine;
+            tune_config_t c = Autotuner<T>::config(ENGINE_SERIAL, 1, false, 0);
+            int numa = 0;
+            if (line.empty() || line[0] == '#' ||
+                !(fields >> key >> engine >> c.workers >> numa >> c.batch >> c.tokensPerSec)) {
+                continue;
+            }
+            for (int e = ENGINE_SERIAL; e <= ENGINE_PROCESSES; ++e) {
+                if (engine == engine_names[e]) {
+                    c.engine = (engine_t) e;
+                }
+            }
+            c.numa = numa != 0;
+            cache[key] = c;
+        }
+        return cache;
+    }
+
+    void store(const std::map<std::string, tune_config_t> &cache) const {
+        std::ofstream out(cachePath);
+        out << "# fingerprint engine workers numa batch tokens/s" << std::endl;
+        for (auto &item:cache) {
+            auto &c = item.second;
+            out << item.first << " " << engine_names[c.engine] << " " << c.workers << " " << (c.numa ? 1 : 0)
+                << " " << c.batch << " " << c.tokensPerSec << std::endl;
+        }
+    }
+
+    std::vector<tune_config_t> candidates(const graph_profile_t &p) const {
+        std::vector<tune_config_t> list;
+        list.push_back(Autotuner<T>::config(ENGINE_SERIAL, 1, false, 0));
+        int hw = (int) std::max(1u, std::thread::hardware_concurrency());
+        int maxThreads = std::min(std::max(hw, 2), p.components);
+        for (int w = 2; w <= maxThreads; w *= 2) {
+            list.push_back(Autotuner<T>::config(ENGINE_THREADS, w, false, 0));
+            if (NumaTopology().getNumNodes() > 1) {
+                list.push_back(Autotuner<T>::config(ENGINE_THREADS, w, true, 0));
+            }
+        }
+        const uint32_t batches[3] = {64, 256, 1024};
+        for (int w = 2; w <= std::max(hw, 2); w *= 2) {
+            for (auto b:batches) {
+                list.push_back(Autotuner<T>::config(ENGINE_PROCESSES, w, false, b));
+            }
+        }
+        return list;
+    }
+
+public:
+    explicit Autotuner(const std::string &cachePath, double budgetSeconds = 1.0, unsigned long trialTokens = 4096)
+            : cachePath(cachePath), budget(budgetSeconds), trialTokens(trialTokens) {}
+
+    static graph_profile_t characterize(const DataFlow<T> &df) {
+        graph_profile_t p = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+        std::map<int, int> width;
+        for (auto item:df.getOpArray()) {
+            auto op = item.second;
+            p.ops++;
+            p.edges += (int) op->getDst().size();
+            p.inputs += op->getType() == OP_IN ? 1 : 0;
+            p.outputs += op->getType() == OP_OUT ? 1 : 0;
+            p.maxFanOut = std::max(p.maxFanOut, (int) op->getDst().size());
+            width[op->getLevel()]++;
+        }
+        for (auto &w:width) {
+            p.maxWidth = std::max(p.maxWidth, w.second);
+        }
+        p.depth = (int) width.size();
+        p.meanWidth = width.empty() ? 0 : (double) p.ops / width.size();
+        Partitioner<T> partitioner;
+        auto part = partitioner.partition(df, std::max(1, p.ops), false);
+        std::vector<int> used;
+        for (auto &item:part) {
+            used.push_back(item.second);
+        }
+        std::sort(used.begin(), used.end());
+        p.components = (int) (std::unique(used.begin(), used.end()) - used.begin());
+        return p;
+    }
+
+    // Runs the whole graph with the given configuration. Returns false if a worker failed.
+    static bool run(DataFlow<T> &df, const tune_config_t &c) {
+        if (c.engine == ENGINE_THREADS) {
+            NumaExecutor<T> executor(df, c.workers, c.numa);
+            executor.run();
+            return true;
+        }
+        if (c.engine == ENGINE_PROCESSES) {
+            DistributedRunner<T> runner(df, c.workers, TRANSPORT_SHM, c.batch);
+            return runner.run();
+        }
+        df.compute();
+        return true;
+    }
+
+    /*
+     * The configuration for df, from the cache or from calibration trials. Trials need every
+     * input to be an InputStream and every output an OutputStream (they run on truncated copies
+     * of the inputs and into scratch outputs); otherwise the serial engine is returned untried.
+     */
+    tune_config_t tune(DataFlow<T> &df) {
+        std::string key = Autotuner<T>::hex(structuralHash(df));
+        auto cache = Autotuner<T>::load();
+        auto hit = cache.find(key);
+        if (hit != cache.end()) {
+            return hit->second;
+        }
+
+        trials.clear();
+        tune_config_t best = Autotuner<T>::config(ENGINE_SERIAL, 1, false, 0);
+        std::vector<InputStream<T> *> ins;
+        std::vector<OutputStream<T> *> outs;
+        for (auto item:df.getOpArray()) {
+            auto in = dynamic_cast<InputStream<T> *>(item.second);
+            auto out = dynamic_cast<OutputStream<T> *>(item.second);
+            if ((item.second->getType() == OP_IN && !in) || (item.second->getType() == OP_OUT && !out)) {
+                return best;
+            }
+            if (in) {
+                ins.push_back(in);
+            }
+            if (out) {
+                outs.push_back(out);
+            }
+        }
+
+        std::vector<std::vector<T> *> origIn, origOut;
+        std::vector<std::vector<T>> trialIn(ins.size()), trialOut(outs.size());
+        for (size_t i = 0; i < ins.size(); ++i) {
+            origIn.push_back(&ins[i]->getData());
+        }
+        for (size_t i = 0; i < outs.size(); ++i) {
+            origOut.push_back(&outs[i]->getData());
+            outs[i]->setData(trialOut[i]);
+        }
+        // Points every input at its first n values; returns the number of tokens a trial reads.
+        auto truncate = [&](unsigned long n) {
+            unsigned long tokens = 0;
+            for (size_t i = 0; i < ins.size(); ++i) {
+                auto &d = *origIn[i];
+                trialIn[i].assign(d.begin(), d.begin() + std::min((unsigned long) d.size(), n));
+                tokens += trialIn[i].size();
+                ins[i]->setData(trialIn[i]);
+            }
+            return tokens;
+        };
+        // Seconds one run of c takes, or a negative value if it failed.
+        auto trial = [&](const tune_config_t &c) {
+            for (auto &o:trialOut) {
+                o.clear();
+            }
+            df.reset();
+            auto t0 = std::chrono::steady_clock::now();
+            bool ok = Autotuner<T>::run(df, c);
+            double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            return ok ? s : -1.0;
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        auto list = Autotuner<T>::candidates(Autotuner<T>::characterize(df));
+        unsigned long length = std::min(trialTokens, TUNE_PROBE_TOKENS);
+        truncate(length);
+        double probe = trial(best);
+        if (probe > 0) {
+            double fit = (double) length * budget / list.size() / probe;
+            length = (unsigned long) std::max((double) length, std::min((double) trialTokens, fit));
+        }
+        unsigned long tokens = truncate(length);
+        double slowest = 0;
+        for (auto c:list) {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (!trials.empty() && elapsed + slowest > budget) {
+                break;
+            }
+            double s = trial(c);
+            slowest = std::max(slowest, s);
+            c.tokensPerSec = s > 0 ? tokens / s : 0;
+            trials.push_back(c);
+            if (c.tokensPerSec > best.tokensPerSec) {
+                best = c;
+            }
+        }
+
+        for (size_t i = 0; i < ins.size(); ++i) {
+            ins[i]->setData(*origIn[i]);
+        }
+        for (size_t i = 0; i < outs.size(); ++i) {
+            outs[i]->setData(*origOut[i]);
+        }
+        df.reset();
+        cache[key] = best;
+        Autotuner<T>::store(cache);
+        return best;
+    }
+
+    // Every configuration measured by the last tune() that missed the cache.
+    const std::vector<tune_config_t> &getTrials() const {
+        return trials;
+    }
+};
+
+#endif //AUTOTUNER_H
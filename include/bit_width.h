@@ -0,0 +1,855 @@
+#ifndef BIT_WIDTH_H
+#define BIT_WIDTH_H
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <type_traits>
+#include <vector>
+#include <codegen.h>
+#include <data_flow.h>
+
+// How a value is stored by PackedExecutor: one bit, 8/16/32 bits zero- or sign-extended on load, or as a T.
+typedef enum {
+    W_BIT,
+    W_U8,
+    W_S8,
+    W_U16,
+    W_S16,
+    W_U32,
+    W_S32,
+    W_FULL
+} width_class_t;
+
+/*
+ * The values an operator can hold, as found by WidthAnalysis: every value lies in [lo, hi]
+ * and needs bits bits (1 for a 0/1 predicate, one more than the magnitude for a range with
+ * negative values). When nothing narrower than T could be proven, cls is W_FULL, bits is the
+ * size of T and lo/hi are the bounds of T as far as they fit a long long.
+ */
+typedef struct {
+    long long lo;
+    long long hi;
+    int bits;
+    width_class_t cls;
+} value_range_t;
+
+/*
+ * Bit-width inference over a graph. Ranges start at the inputs (declared with
+ * setInputRange(), or else the min and max of an InputStream's data) and the constants of
+ * immediates, and go through every opcode by interval arithmetic in level order: Beq, Bne,
+ * Slt and Sgt give [0, 1], Add widens, And with a non-negative side narrows, Mux joins its
+ * two sides, and so on. A result that may leave the range of T (so wrap around or saturate)
+ * is not narrowed. Only integral T get ranges; for any other T just the predicates are.
+ * Every range includes 0, the value an operator holds before it first fires.
+ */
+template<class T>
+class WidthAnalysis {
+private:
+    typedef struct {
+        bool known;
+        long long lo;
+        long long hi;
+    } interval_t;
+
+    std::map<int, std::pair<long long, long long>> declared;
+    std::map<int, value_range_t> ranges;
+
+    static bool tracked() {
+        return std::is_integral<T>::value;
+    }
+
+    static long long lowT() {
+        return WidthAnalysis<T>::limit(false, std::is_integral<T>());
+    }
+
+    static long long highT() {
+        return WidthAnalysis<T>::limit(true, std::is_integral<T>());
+    }
+
+    static long long limit(bool high, std::true_type) {
+        if (!high) {
+            return std::is_signed<T>::value ? (long long) std::numeric_limits<T>::lowest() : 0;
+        }
+        return (unsigned long long) std::numeric_limits<T>::max() > (unsigned long long) LLONG_MAX ? LLONG_MAX :
+               (long long) std::numeric_limits<T>::max();
+    }
+
+    static long long limit(bool high, std::false_type) {
+        return high ? LLONG_MAX : LLONG_MIN;
+    }
+
+    static long long asLong(T v, std::true_type) {
+        return (long long) v;
+    }
+
+    static long long asLong(T, std::false_type) {
+        return 0;
+    }
+
+    // Min and max of data, or false when some value does not fit a long long.
+    static bool scan(const std::vector<T> &data, long long &lo, long long &hi, std::true_type) {
+        for (auto v:data) {
+            if (!std::is_signed<T>::value && (unsigned long long) v > (unsigned long long) LLONG_MAX) {
+                return false;
+            }
+            lo = std::min(lo, (long long) v);
+            hi = std::max(hi, (long long) v);
+        }
+        return true;
+    }
+
+    static bool scan(const std::vector<T> &, long long &, long long &, std::false_type) {
+        return false;
+    }
+
+    static interval_t unknown() {
+        interval_t r = {false, 0, 0};
+        return r;
+    }
+
+    // [lo, hi] when T holds all of it, else unknown.
+    static interval_t make(long long lo, long long hi) {
+        interval_t r = {lo >= WidthAnalysis<T>::lowT() && hi <= WidthAnalysis<T>::highT(), lo, hi};
+        return r.known ? r : WidthAnalysis<T>::unknown();
+    }
+
+    // Whether an exact long long result is safe: keeps away from the ends of long long.
+    static bool fits(double x) {
+        return x > -4.6e18 && x < 4.6e18;
+    }
+
+    static int bitLength(unsigned long long v) {
+        int n = 0;
+        while (v) {
+            v >>= 1;
+            n++;
+        }
+        return n;
+    }
+
+    // Whether a shift count range stays defined for T after integer promotion.
+    static bool shiftable(interval_t s) {
+        int width = sizeof(T) <= sizeof(int) ? (int) sizeof(int) * 8 : (int) sizeof(T) * 8;
+        return s.known && s.lo >= 0 && s.hi < width - 1;
+    }
+
+    interval_t inputRange(Operator<T> *op) const {
+        auto d = WidthAnalysis<T>::declared.find(op->getId());
+        if (d != WidthAnalysis<T>::declared.end()) {
+            return WidthAnalysis<T>::make(std::min(0LL, d->second.first), std::max(0LL, d->second.second));
+        }
+        auto in = dynamic_cast<InputStream<T> *>(op);
+        if (!in) {
+            return WidthAnalysis<T>::unknown();
+        }
+        long long lo = 0, hi = 0;
+        if (!WidthAnalysis<T>::scan(in->getData(), lo, hi, std::is_integral<T>())) {
+            return WidthAnalysis<T>::unknown();
+        }
+        return WidthAnalysis<T>::make(lo, hi);
+    }
+
+    static interval_t transfer(Operator<T> *op, interval_t a, interval_t b) {
+        auto code = (op_opcode_t) op->getOpCode();
+        if (code == OP_BEQ || code == OP_BNE || code == OP_SLT || code == OP_SGT) {
+            interval_t r = {true, 0, 1};
+            return r;
+        }
+        if (code == OP_PASS_A && op->getRateUp() > 1) {
+            // Upsample fills in zeros between the values of A.
+            return a.known ? WidthAnalysis<T>::make(std::min(0LL, a.lo), std::max(0LL, a.hi)) : a;
+        }
+        // Without integer ranges only predicates are followed, through registers and muxes.
+        if (!WidthAnalysis<T>::tracked() && code != OP_PASS_A && code != OP_PASS_B && code != OP_MUX) {
+            return WidthAnalysis<T>::unknown();
+        }
+        switch (code) {
+            case OP_PASS_A:
+                return a;
+            case OP_PASS_B:
+                return b;
+            case OP_MUX:
+                return a.known && b.known ? WidthAnalysis<T>::make(std::min(a.lo, b.lo), std::max(a.hi, b.hi))
+                                          : WidthAnalysis<T>::unknown();
+            case OP_AND:
+                // Both sides non-negative: bounded by the smaller; one side: bounded by it.
+                if (a.known && b.known && a.lo >= 0 && b.lo >= 0) {
+                    return WidthAnalysis<T>::make(0, std::min(a.hi, b.hi));
+                } else if (a.known && a.lo >= 0) {
+                    return WidthAnalysis<T>::make(0, a.hi);
+                } else if (b.known && b.lo >= 0) {
+                    return WidthAnalysis<T>::make(0, b.hi);
+                }
+                return WidthAnalysis<T>::unknown();
+            default:
+                break;
+        }
+        if (!a.known || (!b.known && code != OP_NOT && code != OP_ABS)) {
+            return WidthAnalysis<T>::unknown();
+        }
+        switch (code) {
+            case OP_MIN:
+                return WidthAnalysis<T>::make(std::min(a.lo, b.lo), std::min(a.hi, b.hi));
+            case OP_MAX:
+                return WidthAnalysis<T>::make(std::max(a.lo, b.lo), std::max(a.hi, b.hi));
+            case OP_ADD:
+                if (!WidthAnalysis<T>::fits((double) a.lo + (double) b.lo) ||
+                    !WidthAnalysis<T>::fits((double) a.hi + (double) b.hi)) {
+                    return WidthAnalysis<T>::unknown();
+                }
+                return WidthAnalysis<T>::make(a.lo + b.lo, a.hi + b.hi);
+            case OP_SUB:
+                if (!WidthAnalysis<T>::fits((double) a.lo - (double) b.hi) ||
+                    !WidthAnalysis<T>::fits((double) a.hi - (double) b.lo)) {
+                    return WidthAnalysis<T>::unknown();
+                }
+                return WidthAnalysis<T>::make(a.lo - b.hi, a.hi - b.lo);
+            case OP_MULT: {
+                long long ends[4][2] = {{a.lo, b.lo}, {a.lo, b.hi}, {a.hi, b.lo}, {a.hi, b.hi}};
+                long long lo = LLONG_MAX, hi = LLONG_MIN;
+                for (auto &e:ends) {
+                    if (!WidthAnalysis<T>::fits((double) e[0] * (double) e[1])) {
+                        return WidthAnalysis<T>::unknown();
+                    }
+                    lo = std::min(lo, e[0] * e[1]);
+                    hi = std::max(hi, e[0] * e[1]);
+                }
+                return WidthAnalysis<T>::make(lo, hi);
+            }
+            case OP_OR:
+            case OP_XOR:
+                if (a.lo < 0 || b.lo < 0) {
+                    return WidthAnalysis<T>::unknown();
+                }
+                return WidthAnalysis<T>::make(0, (long long) ((1ULL << WidthAnalysis<T>::bitLength(
+                        (unsigned long long) std::max(a.hi, b.hi))) - 1));
+            case OP_NOT:
+                if (std::is_signed<T>::value) {
+                    return WidthAnalysis<T>::make(-a.hi - 1, -a.lo - 1);
+                }
+                if (sizeof(T) >= sizeof(long long)) {
+                    return WidthAnalysis<T>::unknown();
+                }
+                return WidthAnalysis<T>::make(WidthAnalysis<T>::highT() - a.hi, WidthAnalysis<T>::highT() - a.lo);
+            case OP_SHL:
+                if (a.lo < 0 || !WidthAnalysis<T>::shiftable(b) ||
+                    !WidthAnalysis<T>::fits(std::ldexp((double) a.hi, (int) b.hi))) {
+                    return WidthAnalysis<T>::unknown();
+                }
+                return WidthAnalysis<T>::make(a.lo << b.lo, a.hi << b.hi);
+            case OP_SHR:
+                if (!WidthAnalysis<T>::shiftable(b)) {
+                    return WidthAnalysis<T>::unknown();
+                }
+                return WidthAnalysis<T>::make(std::min(a.lo >> b.lo, a.lo >> b.hi),
+                                              std::max(a.hi >> b.lo, a.hi >> b.hi));
+            case OP_ABS: {
+                // Abs reads B only when A is not connected; the caller passes that side as a.
+                if (a.lo >= 0) {
+                    return a;
+                } else if (a.lo == LLONG_MIN) {
+                    return WidthAnalysis<T>::unknown();
+                }
+                return a.hi < 0 ? WidthAnalysis<T>::make(-a.hi, -a.lo)
+                                : WidthAnalysis<T>::make(0, std::max(-a.lo, a.hi));
+            }
+            default:
+                return WidthAnalysis<T>::unknown();
+        }
+    }
+
+    static value_range_t classify(interval_t r) {
+        value_range_t v;
+        if (!r.known) {
+            v.lo = WidthAnalysis<T>::lowT();
+            v.hi = WidthAnalysis<T>::highT();
+            v.bits = (int) sizeof(T) * 8;
+            v.cls = W_FULL;
+            return v;
+        }
+        v.lo = r.lo;
+        v.hi = r.hi;
+        if (r.lo >= 0) {
+            v.bits = r.hi <= 1 ? 1 : WidthAnalysis<T>::bitLength((unsigned long long) r.hi);
+            v.cls = r.hi <= 1 ? W_BIT : r.hi <= UINT8_MAX ? W_U8 : r.hi <= UINT16_MAX ? W_U16 :
+                                                                     r.hi <= UINT32_MAX ? W_U32 : W_FULL;
+        } else {
+            v.bits = 1 + WidthAnalysis<T>::bitLength((unsigned long long) std::max(-(r.lo + 1), r.hi));
+            v.cls = r.lo >= INT8_MIN && r.hi <= INT8_MAX ? W_S8 : r.lo >= INT16_MIN && r.hi <= INT16_MAX ? W_S16 :
+                                                                  r.lo >= INT32_MIN && r.hi <= INT32_MAX ? W_S32
+                                                                                                         : W_FULL;
+        }
+        // A lane as wide as T gains nothing over storing the T itself.
+        if (v.cls != W_BIT && v.cls != W_FULL && WidthAnalysis<T>::laneBytes(v.cls) >= sizeof(T)) {
+            v.cls = W_FULL;
+        }
+        return v;
+    }
+
+public:
+    // Bytes one value takes in a lane of class cls (W_BIT rounds up to a byte).
+    static size_t laneBytes(width_class_t cls) {
+        return cls == W_FULL ? sizeof(T) : cls == W_BIT || cls == W_U8 || cls == W_S8 ? 1 :
+                                           cls == W_U16 || cls == W_S16 ? 2 : 4;
+    }
+
+    // Values of input op_id stay in [lo, hi]; takes precedence over scanning its data.
+    void setInputRange(int op_id, long long lo, long long hi) {
+        WidthAnalysis<T>::declared[op_id] = std::make_pair(lo, hi);
+    }
+
+    // Infers the range of every operator of df. Run it again after editing the graph or its input data.
+    const std::map<int, value_range_t> &analyze(const DataFlow<T> &df) {
+        std::vector<Operator<T> *> order;
+        for (auto item:df.getOpArray()) {
+            order.push_back(item.second);
+        }
+        // Inputs first: a leveled input can sit above the operators that read it.
+        std::stable_sort(order.begin(), order.end(), [](Operator<T> *a, Operator<T> *b) {
+            int la = a->getType() == OP_IN ? -1 : a->getLevel();
+            int lb = b->getType() == OP_IN ? -1 : b->getLevel();
+            return la < lb;
+        });
+        std::map<int, interval_t> found;
+        auto rangeOf = [&found](Operator<T> *src) {
+            auto it = src ? found.find(src->getId()) : found.end();
+            return it == found.end() ? WidthAnalysis<T>::unknown() : it->second;
+        };
+        for (auto op:order) {
+            interval_t r;
+            if (op->getType() == OP_IN) {
+                r = WidthAnalysis<T>::inputRange(op);
+            } else {
+                interval_t a = rangeOf(op->getSrcA()), b = rangeOf(op->getSrcB());
+                if (op->getType() == OP_IMMEDIATE) {
+                    long long k = WidthAnalysis<T>::asLong(op->getConst(), std::is_integral<T>());
+                    b = WidthAnalysis<T>::tracked() ? WidthAnalysis<T>::make(k, k) : WidthAnalysis<T>::unknown();
+                }
+                if (op->getOpCode() == OP_ABS && !op->getSrcA()) {
+                    a = b;
+                }
+                r = op->getType() == OP_OUT ? a : WidthAnalysis<T>::transfer(op, a, b);
+                if (r.known && (r.lo > 0 || r.hi < 0)) {
+                    r = WidthAnalysis<T>::make(std::min(0LL, r.lo), std::max(0LL, r.hi));
+                }
+                if (r.known && !WidthAnalysis<T>::tracked() && (r.lo != 0 || r.hi != 1)) {
+                    r = WidthAnalysis<T>::unknown();
+                }
+            }
+            found[op->getId()] = r;
+        }
+        WidthAnalysis<T>::ranges.clear();
+        for (auto item:found) {
+            WidthAnalysis<T>::ranges[item.first] = WidthAnalysis<T>::classify(item.second);
+        }
+        return ranges;
+    }
+
+    const std::map<int, value_range_t> &getRanges() const {
+        return ranges;
+    }
+
+    // The range of op_id from the last analyze(); the full range of T for an unknown id.
+    value_range_t getRange(int op_id) const {
+        auto it = WidthAnalysis<T>::ranges.find(op_id);
+        return it != WidthAnalysis<T>::ranges.end() ? it->second
+                                                    : WidthAnalysis<T>::classify(WidthAnalysis<T>::unknown());
+    }
+
+    // Operators whose values were given storage class cls.
+    int getCount(width_class_t cls) const {
+        int n = 0;
+        for (auto item:WidthAnalysis<T>::ranges) {
+            n += item.second.cls == cls ? 1 : 0;
+        }
+        return n;
+    }
+
+    // Bytes the values take packed by class (predicates at one bit each) and all as T.
+    size_t getPackedBytes() const {
+        size_t bytes = ((size_t) WidthAnalysis<T>::getCount(W_BIT) + 7) / 8;
+        for (auto item:WidthAnalysis<T>::ranges) {
+            bytes += item.second.cls == W_BIT ? 0 : WidthAnalysis<T>::laneBytes(item.second.cls);
+        }
+        return bytes;
+    }
+
+    size_t getUniformBytes() const {
+        return WidthAnalysis<T>::ranges.size() * sizeof(T);
+    }
+};
+
+// Bitwise operators of T; a floating-point graph has no operators that use them.
+template<class T, bool = std::is_floating_point<T>::value>
+struct PackedBitOps {
+    static T bitNot(T a) { return ~a; }
+
+    static T bitAnd(T a, T b) { return a & b; }
+
+    static T bitOr(T a, T b) { return a | b; }
+
+    static T bitXor(T a, T b) { return a ^ b; }
+
+    static T shl(T a, T b) { return a << b; }
+
+    static T shr(T a, T b) { return a >> b; }
+
+    static T absolute(T a) { return absoluteValue(a); }
+
+    // Lane values widen through int when T only converts from it (Fixed); narrow values of such T are predicates.
+    template<class U>
+    static T fromLane(U u) { return fromLaneOf(u, std::is_integral<T>()); }
+
+    template<class U>
+    static T fromLaneOf(U u, std::true_type) { return (T) u; }
+
+    template<class U>
+    static T fromLaneOf(U u, std::false_type) { return T((int) u); }
+
+    template<class U>
+    static U toLane(T v) { return toLaneOf<U>(v, std::is_integral<T>()); }
+
+    template<class U>
+    static U toLaneOf(T v, std::true_type) { return (U) v; }
+
+    template<class U>
+    static U toLaneOf(T v, std::false_type) { return v != T() ? U(1) : U(0); }
+};
+
+template<class T>
+struct PackedBitOps<T, true> {
+    static T bitNot(T a) { return a; }
+
+    static T bitAnd(T a, T) { return a; }
+
+    static T bitOr(T a, T) { return a; }
+
+    static T bitXor(T a, T) { return a; }
+
+    static T shl(T a, T) { return a; }
+
+    static T shr(T a, T) { return a; }
+
+    static T absolute(T a) { return std::abs(a); }
+
+    template<class U>
+    static T fromLane(U u) { return (T) u; }
+
+    template<class U>
+    static U toLane(T v) { return v != T() ? U(1) : U(0); }
+};
+
+/*
+ * Runs a sealed graph in place of DataFlow::compute() with the value of every operator kept
+ * in packed lanes by the storage class WidthAnalysis gave it: predicates one bit each, narrow
+ * intermediates in 8/16/32-bit lanes and the rest as T, each class contiguous in schedule
+ * order. The arithmetic is still done in T, so the outputs are exactly those of compute()
+ * as long as the inputs stay in their analyzed ranges: compute() first scans what is left of
+ * every narrow input and, if a value falls outside its range (new data after rebind(), say),
+ * runs df.compute() instead and says so through usedFallback(). Only InputStream,
+ * OutputStream and the built-in single-rate operators are supported; for a graph with
+ * anything else, or one that is not sealed, compute() always calls df.compute(). Inputs and
+ * outputs are looked up from the operators on every compute(), so rebind() is followed.
+ * Probes, tracing, checkpoints and live stats are not served while the executor runs; the
+ * operators get their final values, input cursors and end flags back when it returns.
+ */
+template<class T>
+class PackedExecutor {
+private:
+    typedef PackedBitOps<T> bit_ops;
+
+    // A value 64 - drop bits wide at bit shift of byte in the lanes; drop 64 is an index into lane_full instead.
+    typedef struct {
+        uint32_t byte;
+        uint8_t shift;
+        uint8_t drop;
+        uint8_t sign;   // sign-extend on load
+    } slot_t;
+
+    typedef struct {
+        int code;       // op_opcode_t, or PACKED_IN / PACKED_OUT
+        bool imm;
+        slot_t dst;
+        slot_t a;
+        slot_t b;
+        slot_t c;
+        T k;
+        uint32_t stream;
+    } instr_t;
+
+    static const int PACKED_IN = -1;
+    static const int PACKED_OUT = -2;
+
+    DataFlow<T> *df;
+    bool supported;
+    bool fallback;
+    unsigned long num_cycles;
+    std::vector<instr_t> code;
+    std::vector<Operator<T> *> ops;
+    std::vector<size_t> level_end;
+    std::vector<size_t> input_end;
+    std::vector<InputStream<T> *> inputs;
+    std::vector<value_range_t> input_range;
+    std::vector<unsigned long> cursor;
+    std::vector<char> ended;
+    std::vector<OutputStream<T> *> outputs;
+    std::vector<std::vector<T> *> sinks;
+    std::vector<uint8_t> lanes;
+    size_t lane_bytes;
+    std::vector<T> lane_full;
+
+    // Values of integral T live in the lanes at every width; other T only keep predicates there.
+    static slot_t makeSlot(width_class_t cls, uint64_t bit) {
+        int width = cls == W_BIT ? 1 : cls == W_FULL ? (int) sizeof(T) * 8 : (int) WidthAnalysis<T>::laneBytes(cls) * 8;
+        bool sign = cls == W_S8 || cls == W_S16 || cls == W_S32 || (cls == W_FULL && std::is_signed<T>::value);
+        slot_t s = {(uint32_t) (bit >> 3), (uint8_t) (bit & 7), (uint8_t) (64 - width), (uint8_t) sign};
+        return s;
+    }
+
+    template<class U>
+    U lane(const slot_t &s) const {
+        U u;
+        memcpy(&u, PackedExecutor<T>::lanes.data() + s.byte, sizeof(u));
+        return u;
+    }
+
+    template<class U>
+    void setLane(const slot_t &s, U u) {
+        memcpy(PackedExecutor<T>::lanes.data() + s.byte, &u, sizeof(u));
+    }
+
+    // Reads and writes exactly the bytes of the value, so a store forwards to the next load of it.
+    T load(const slot_t &s) const {
+        long long v;
+        switch (s.drop) {
+            case 63:
+                v = (PackedExecutor<T>::lane<uint8_t>(s) >> s.shift) & 1;
+                break;
+            case 56:
+                v = s.sign ? (long long) PackedExecutor<T>::lane<int8_t>(s)
+                           : (long long) PackedExecutor<T>::lane<uint8_t>(s);
+                break;
+            case 48:
+                v = s.sign ? (long long) PackedExecutor<T>::lane<int16_t>(s)
+                           : (long long) PackedExecutor<T>::lane<uint16_t>(s);
+                break;
+            case 32:
+                v = s.sign ? (long long) PackedExecutor<T>::lane<int32_t>(s)
+                           : (long long) PackedExecutor<T>::lane<uint32_t>(s);
+                break;
+            case 0:
+                v = PackedExecutor<T>::lane<long long>(s);
+                break;
+            default:
+                return PackedExecutor<T>::lane_full[s.byte];
+        }
+        return bit_ops::fromLane(v);
+    }
+
+    void store(const slot_t &s, T v) {
+        auto u = bit_ops::template toLane<long long>(v);
+        switch (s.drop) {
+            case 63: {
+                auto b = PackedExecutor<T>::lane<uint8_t>(s);
+                PackedExecutor<T>::setLane<uint8_t>(s, (uint8_t) ((b & ~(1u << s.shift)) | ((u & 1) << s.shift)));
+                break;
+            }
+            case 56:
+                PackedExecutor<T>::setLane<uint8_t>(s, (uint8_t) u);
+                break;
+            case 48:
+                PackedExecutor<T>::setLane<uint16_t>(s, (uint16_t) u);
+                break;
+            case 32:
+                PackedExecutor<T>::setLane<uint32_t>(s, (uint32_t) u);
+                break;
+            case 0:
+                PackedExecutor<T>::setLane<long long>(s, u);
+                break;
+            default:
+                PackedExecutor<T>::lane_full[s.byte] = v;
+        }
+    }
+
+    // The same expressions as the computeSealed() of each operator.
+    void execute(const instr_t &i) {
+        if (i.code == PACKED_IN) {
+            auto &data = PackedExecutor<T>::inputs[i.stream]->getData();
+            auto &at = PackedExecutor<T>::cursor[i.stream];
+            if (at < data.size()) {
+                PackedExecutor<T>::store(i.dst, data[at++]);
+            } else {
+                PackedExecutor<T>::ended[i.stream] = 1;
+            }
+            return;
+        }
+        T a = PackedExecutor<T>::load(i.a);
+        if (i.code == PACKED_OUT) {
+            PackedExecutor<T>::store(i.dst, a);
+            PackedExecutor<T>::sinks[i.stream]->push_back(a);
+            return;
+        }
+        T b = i.imm ? i.k : PackedExecutor<T>::load(i.b);
+        T v;
+        switch (i.code) {
+            case OP_PASS_A:
+                v = a;
+                break;
+            case OP_PASS_B:
+                v = b;
+                break;
+            case OP_MIN:
+                v = a < b ? a : b;
+                break;
+            case OP_MAX:
+                v = a > b ? a : b;
+                break;
+            case OP_BEQ:
+                v = a == b ? 1 : 0;
+                break;
+            case OP_BNE:
+                v = a != b ? 1 : 0;
+                break;
+            case OP_SLT:
+                v = a < b ? 1 : 0;
+                break;
+            case OP_SGT:
+                v = a > b ? 1 : 0;
+                break;
+            case OP_ADD:
+                v = a + b;
+                break;
+            case OP_SUB:
+                v = a - b;
+                break;
+            case OP_MULT:
+                v = a * b;
+                break;
+            case OP_XOR:
+                v = bit_ops::bitXor(a, b);
+                break;
+            case OP_AND:
+                v = bit_ops::bitAnd(a, b);
+                break;
+            case OP_OR:
+                v = bit_ops::bitOr(a, b);
+                break;
+            case OP_NOT:
+                v = bit_ops::bitNot(a);
+                break;
+            case OP_SHL:
+                v = bit_ops::shl(a, b);
+                break;
+            case OP_SHR:
+                v = bit_ops::shr(a, b);
+                break;
+            case OP_MUX:
+                v = PackedExecutor<T>::load(i.c) ? a : b;
+                break;
+            default:
+                v = bit_ops::absolute(a);
+        }
+        PackedExecutor<T>::store(i.dst, v);
+    }
+
+public:
+    // Lays out the lanes for df, which must be sealed, with the ranges widths last found for it.
+    PackedExecutor(DataFlow<T> &df, const WidthAnalysis<T> &widths) : df(&df), supported(df.isSealed()),
+                                                                       fallback(false), num_cycles(0),
+                                                                       lane_bytes(0) {
+        for (auto item:df.getOpArray()) {
+            auto op = item.second;
+            bool ok = op->getType() == OP_IN ? dynamic_cast<InputStream<T> *>(op) != nullptr :
+                      op->getType() == OP_OUT ? dynamic_cast<OutputStream<T> *>(op) != nullptr :
+                      isBuiltinOperator(op);
+            PackedExecutor<T>::supported = PackedExecutor<T>::supported && ok;
+            PackedExecutor<T>::ops.push_back(op);
+        }
+        if (!PackedExecutor<T>::supported) {
+            PackedExecutor<T>::ops.clear();
+            return;
+        }
+
+        // Levels in order and ids in order within a level, as the sealed compute() visits them.
+        auto byLevel = [](Operator<T> *a, Operator<T> *b) {
+            return std::max(0, a->getLevel()) < std::max(0, b->getLevel());
+        };
+        auto &order = PackedExecutor<T>::ops;
+        std::stable_sort(order.begin(), order.end(), byLevel);
+        size_t levels = order.empty() ? 0 : (size_t) std::max(0, order.back()->getLevel()) + 1;
+        PackedExecutor<T>::level_end.assign(levels, 0);
+        PackedExecutor<T>::input_end.assign(levels, 0);
+
+        // Predicates first, one bit each, then 8-, 16- and 32-bit values and the full ones, each run in schedule order.
+        uint64_t counts[W_FULL + 1] = {0};
+        for (auto op:order) {
+            auto l = (size_t) std::max(0, op->getLevel());
+            PackedExecutor<T>::level_end[l]++;
+            counts[widths.getRange(op->getId()).cls]++;
+            if (op->getType() == OP_IN) {
+                PackedExecutor<T>::input_end[l]++;
+                PackedExecutor<T>::inputs.push_back((InputStream<T> *) op);
+                PackedExecutor<T>::input_range.push_back(widths.getRange(op->getId()));
+            }
+        }
+        for (size_t l = 1; l < levels; ++l) {
+            PackedExecutor<T>::level_end[l] += PackedExecutor<T>::level_end[l - 1];
+            PackedExecutor<T>::input_end[l] += PackedExecutor<T>::input_end[l - 1];
+        }
+        const width_class_t runs[5][2] = {{W_BIT, W_BIT}, {W_U8, W_S8}, {W_U16, W_S16}, {W_U32, W_S32},
+                                          {W_FULL, W_FULL}};
+        uint64_t next[W_FULL + 1], bit = 0;
+        for (auto &r:runs) {
+            next[r[0]] = bit;
+            bit += counts[r[0]] * (r[0] == W_BIT ? 1 : WidthAnalysis<T>::laneBytes(r[0]) * 8);
+            if (r[1] != r[0]) {
+                next[r[1]] = bit;
+                bit += counts[r[1]] * WidthAnalysis<T>::laneBytes(r[1]) * 8;
+            }
+            bit = r[0] == W_BIT ? (bit + 7) / 8 * 8 : bit;
+        }
+        bool inLanes = std::is_integral<T>::value;
+        PackedExecutor<T>::lane_bytes = (size_t) ((inLanes ? bit : next[W_FULL]) / 8);
+        // A zero byte after the values, read through the ports an operator leaves unused.
+        PackedExecutor<T>::lanes.assign(PackedExecutor<T>::lane_bytes + 1, 0);
+        PackedExecutor<T>::lane_full.assign(inLanes ? 0 : counts[W_FULL], T());
+        std::map<Operator<T> *, slot_t> slots;
+        uint32_t full = 0;
+        for (auto op:order) {
+            auto cls = widths.getRange(op->getId()).cls;
+            if (cls == W_FULL && !inLanes) {
+                slot_t s = {full++, 0, 64, 0};
+                slots[op] = s;
+            } else {
+                slots[op] = PackedExecutor<T>::makeSlot(cls, next[cls]);
+                next[cls] += cls == W_BIT ? 1 : WidthAnalysis<T>::laneBytes(cls) * 8;
+            }
+        }
+
+        slot_t none = PackedExecutor<T>::makeSlot(W_BIT, (uint64_t) PackedExecutor<T>::lane_bytes * 8);
+        uint32_t in = 0;
+        for (auto op:order) {
+            instr_t i = {op->getOpCode(), op->getType() == OP_IMMEDIATE, slots[op], none, none, none, op->getConst(),
+                         0};
+            unsigned ports = op->getPorts();
+            Operator<T> *srcs[3] = {op->getSrcA(), op->getSrcB(), op->getBranchIn()};
+            slot_t *operands[3] = {&i.a, &i.b, &i.c};
+            for (int k = 0; k < 3; ++k) {
+                if ((ports & (1u << k)) && srcs[k]) {
+                    *operands[k] = slots[srcs[k]];
+                }
+            }
+            if (op->getOpCode() == OP_ABS && !op->getSrcA()) {
+                i.a = i.b;
+            }
+            if (op->getType() == OP_IN) {
+                i.code = PACKED_IN;
+                i.stream = in++;
+            } else if (op->getType() == OP_OUT) {
+                i.code = PACKED_OUT;
+                i.stream = (uint32_t) PackedExecutor<T>::outputs.size();
+                PackedExecutor<T>::outputs.push_back((OutputStream<T> *) op);
+            }
+            PackedExecutor<T>::code.push_back(i);
+        }
+    }
+
+    bool isSupported() const {
+        return supported;
+    }
+
+    // Whether the values left in every input narrower than T are within its analyzed range.
+    bool inputsInRange() const {
+        for (size_t j = 0; j < PackedExecutor<T>::inputs.size(); ++j) {
+            auto &r = PackedExecutor<T>::input_range[j];
+            if (r.cls == W_FULL) {
+                continue;
+            }
+            auto &data = PackedExecutor<T>::inputs[j]->getData();
+            for (size_t k = PackedExecutor<T>::inputs[j]->getIndex(); k < data.size(); ++k) {
+                auto v = bit_ops::template toLane<long long>(data[k]);
+                if (v < r.lo || v > r.hi) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Whether the last compute() ran df.compute() instead of the packed lanes.
+    bool usedFallback() const {
+        return fallback;
+    }
+
+    // Runs until every input is at its end, like DataFlow::compute().
+    void compute() {
+        PackedExecutor<T>::fallback = !PackedExecutor<T>::supported || !PackedExecutor<T>::inputsInRange();
+        if (PackedExecutor<T>::fallback) {
+            PackedExecutor<T>::df->compute();
+            PackedExecutor<T>::num_cycles = PackedExecutor<T>::df->getNumCycles();
+            return;
+        }
+        PackedExecutor<T>::sinks.clear();
+        for (auto o:PackedExecutor<T>::outputs) {
+            PackedExecutor<T>::sinks.push_back(&o->getData());
+        }
+        auto &code = PackedExecutor<T>::code;
+        for (size_t i = 0; i < code.size(); ++i) {
+            PackedExecutor<T>::store(code[i].dst, PackedExecutor<T>::ops[i]->getVal());
+        }
+        size_t numIn = PackedExecutor<T>::inputs.size();
+        PackedExecutor<T>::cursor.resize(numIn);
+        PackedExecutor<T>::ended.resize(numIn);
+        for (size_t j = 0; j < numIn; ++j) {
+            PackedExecutor<T>::cursor[j] = PackedExecutor<T>::inputs[j]->getIndex();
+            PackedExecutor<T>::ended[j] = PackedExecutor<T>::inputs[j]->isEnd() ? 1 : 0;
+        }
+
+        unsigned long allIsEnd = 0, cycles = 0;
+        while (allIsEnd != numIn) {
+            allIsEnd = 0;
+            size_t op = 0, in = 0;
+            for (size_t l = 0; l < PackedExecutor<T>::level_end.size(); ++l) {
+                for (; op < PackedExecutor<T>::level_end[l]; ++op) {
+                    PackedExecutor<T>::execute(code[op]);
+                }
+                for (; in < PackedExecutor<T>::input_end[l]; ++in) {
+                    allIsEnd += (unsigned long) PackedExecutor<T>::ended[in];
+                }
+                if (allIsEnd == numIn) {
+                    break;
+                }
+            }
+            cycles++;
+        }
+        PackedExecutor<T>::num_cycles = cycles;
+
+        for (size_t i = 0; i < code.size(); ++i) {
+            PackedExecutor<T>::ops[i]->setVal(PackedExecutor<T>::load(code[i].dst));
+        }
+        for (size_t j = 0; j < numIn; ++j) {
+            PackedExecutor<T>::inputs[j]->setIndex(PackedExecutor<T>::cursor[j]);
+            PackedExecutor<T>::inputs[j]->setEnd(PackedExecutor<T>::ended[j] != 0);
+        }
+        for (auto op:PackedExecutor<T>::ops) {
+            op->flush();
+        }
+    }
+
+    // Cycles run by the last compute(), counted as DataFlow::getNumCycles() does.
+    unsigned long getNumCycles() const {
+        return num_cycles;
+    }
+
+    // Bytes of the value lanes: what the operators' values take while the executor runs.
+    size_t getValueBytes() const {
+        return lane_bytes + lane_full.size() * sizeof(T);
+    }
+};
+
+#endif //BIT_WIDTH_H
@@ -0,0 +1,191 @@
+#ifndef BUFFERED_WRITER_H
+#define BUFFERED_WRITER_H
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifdef DATAFLOW_WITH_ZLIB
+
+#include <zlib.h>
+
+#endif
+
+/*
+ * Output file written in large blocks from a private buffer, with integer formatting
+ * that does not go through printf. A path ending in ".gz" is gzip-compressed when the
+ * library is built with DATAFLOW_WITH_ZLIB, and written uncompressed otherwise.
+ * A file that cannot be opened, a short write or a failed close makes good() false
+ * from then on, and close() reports it.
+ */
+class BufferedWriter {
+private:
+    std::vector<char> buf;
+    size_t pos;
+    FILE *file;
+    bool failed;
+#ifdef DATAFLOW_WITH_ZLIB
+    gzFile gz;
+#endif
+
+    void rawWrite(const char *s, size_t n) {
+#ifdef DATAFLOW_WITH_ZLIB
+        if (gz) {
+            if (gzwrite(gz, s, (unsigned) n) != (int) n) {
+                BufferedWriter::failed = true;
+            }
+            return;
+        }
+#endif
+        if (!file || fwrite(s, 1, n, file) != n) {
+            BufferedWriter::failed = true;
+        }
+    }
+
+    void flush() {
+        if (pos) {
+            BufferedWriter::rawWrite(buf.data(), pos);
+            pos = 0;
+        }
+    }
+
+public:
+    explicit BufferedWriter(const std::string &fileNamePath, size_t blockSize = 1 << 20) : pos(0), file(nullptr),
+                                                                                           failed(false) {
+        buf.resize(blockSize < 64 ? 64 : blockSize);
+#ifdef DATAFLOW_WITH_ZLIB
+        gz = nullptr;
+        if (fileNamePath.size() > 3 && fileNamePath.compare(fileNamePath.size() - 3, 3, ".gz") == 0) {
+            gz = gzopen(fileNamePath.c_str(), "wb1");
+            if (gz) {
+                gzbuffer(gz, (unsigned) buf.size());
+            }
+            BufferedWriter::failed = !gz;
+            return;
+        }
+#endif
+        file = fopen(fileNamePath.c_str(), "wb");
+        if (file) {
+            setvbuf(file, nullptr, _IONBF, 0);
+        }
+        BufferedWriter::failed = !file;
+    }
+
+    ~BufferedWriter() {
+        BufferedWriter::close();
+    }
+
+    BufferedWriter(const BufferedWriter &) = delete;
+
+    BufferedWriter &operator=(const BufferedWriter &) = delete;
+
+    bool isOpen() const {
+#ifdef DATAFLOW_WITH_ZLIB
+        if (gz) {
+            return true;
+        }
+#endif
+        return file != nullptr;
+    }
+
+    // False once opening, writing or closing the file has failed.
+    bool good() const {
+        return !failed;
+    }
+
+    // Writes what is buffered and closes the file; returns good().
+    bool close() {
+        BufferedWriter::flush();
+#ifdef DATAFLOW_WITH_ZLIB
+        if (gz) {
+            if (gzclose(gz) != Z_OK) {
+                BufferedWriter::failed = true;
+            }
+            gz = nullptr;
+        }
+#endif
+        if (file) {
+            if (fclose(file) != 0) {
+                BufferedWriter::failed = true;
+            }
+            file = nullptr;
+        }
+        return !failed;
+    }
+
+    BufferedWriter &put(char c) {
+        if (pos == buf.size()) {
+            BufferedWriter::flush();
+        }
+        buf[pos++] = c;
+        return *this;
+    }
+
+    BufferedWriter &write(const char *s, size_t n) {
+        if (n > buf.size() - pos) {
+            BufferedWriter::flush();
+            if (n > buf.size()) {
+                BufferedWriter::rawWrite(s, n);
+                return *this;
+            }
+        }
+        memcpy(buf.data() + pos, s, n);
+        pos += n;
+        return *this;
+    }
+
+    BufferedWriter &write(const char *s) {
+        return BufferedWriter::write(s, strlen(s));
+    }
+
+    BufferedWriter &write(const std::string &s) {
+        return BufferedWriter::write(s.data(), s.size());
+    }
+
+    BufferedWriter &writeUInt(unsigned long long v) {
+        char tmp[20];
+        int n = 0;
+        do {
+            tmp[19 - n++] = (char) ('0' + v % 10);
+            v /= 10;
+        } while (v);
+        return BufferedWriter::write(tmp + 20 - n, (size_t) n);
+    }
+
+    BufferedWriter &writeInt(long long v) {
+        if (v < 0) {
+            BufferedWriter::put('-');
+            return BufferedWriter::writeUInt(0ULL - (unsigned long long) v);
+        }
+        return BufferedWriter::writeUInt((unsigned long long) v);
+    }
+
+    // Integers as writeInt(), floating point with the "%g" format std::ostream uses by default, and any
+    // other type (Fixed, for one) through its operator<<, as the std::ofstream exporters used to.
+    template<class V>
+    BufferedWriter &writeValue(V v, typename std::enable_if<std::is_integral<V>::value>::type * = nullptr) {
+        if (std::is_signed<V>::value) {
+            return BufferedWriter::writeInt((long long) v);
+        }
+        return BufferedWriter::writeUInt((unsigned long long) v);
+    }
+
+    template<class V>
+    BufferedWriter &writeValue(V v, typename std::enable_if<std::is_floating_point<V>::value>::type * = nullptr) {
+        char tmp[32];
+        int n = snprintf(tmp, sizeof(tmp), "%g", (double) v);
+        return BufferedWriter::write(tmp, (size_t) n);
+    }
+
+    template<class V>
+    BufferedWriter &writeValue(const V &v, typename std::enable_if<!std::is_arithmetic<V>::value>::type * = nullptr) {
+        std::ostringstream text;
+        text << v;
+        return BufferedWriter::write(text.str());
+    }
+};
+
+#endif //BUFFERED_WRITER_H
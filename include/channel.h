@@ -0,0 +1,406 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+ * Batched one-way value channels between processes. A channel carries batches of up to
+ * getBatchSize() values and a final end-of-stream marker; a larger send is split into
+ * several batches, which go out together once that many credits are free, so it must not
+ * need more batches than the channel holds. Neither call waits for the other side:
+ * trySend() returns false while the receiver has no free credit (a ring slot or a TCP
+ * window batch) and tryRecv() returns CHANNEL_EMPTY while nothing has arrived, so the
+ * caller decides what to do while it waits. A channel whose other end is gone reports
+ * isBroken(); it then receives CHANNEL_END and drops what is sent.
+ */
+
+static const int CHANNEL_EMPTY = -1;
+static const int CHANNEL_END = 0;
+
+template<class T>
+class Channel {
+public:
+    virtual ~Channel() {}
+
+    virtual uint32_t getBatchSize() const = 0;
+
+    virtual bool trySend(const T *values, uint32_t n) = 0;
+
+    virtual bool trySendEnd() = 0;
+
+    // Number of values copied into values (at most getBatchSize()), CHANNEL_EMPTY, or CHANNEL_END after the
+    // end marker or once the channel is broken.
+    virtual int tryRecv(T *values) = 0;
+
+    virtual bool isBroken() const {
+        return false;
+    }
+};
+
+/*
+ * Single-producer/single-consumer ring of batch slots in an anonymous shared mapping.
+ * Created before fork(); the parent and its children all see the same ring. The free
+ * slots are the sender's credits. A process cannot tell from the ring that its peer died,
+ * so whoever watches the processes (DistributedRunner waits on them) calls markBroken(),
+ * which sets a flag in the mapping that both ends see.
+ */
+template<class T>
+class ShmChannel : public Channel<T> {
+private:
+    struct Header {
+        std::atomic<uint64_t> head;
+        char pad0[64 - sizeof(std::atomic<uint64_t>)];
+        std::atomic<uint64_t> tail;
+        char pad1[64 - sizeof(std::atomic<uint64_t>)];
+        std::atomic<uint32_t> broken;
+        char pad2[64 - sizeof(std::atomic<uint32_t>)];
+    };
+
+    struct SlotHeader {
+        uint32_t count;
+        uint32_t end;
+    };
+
+    uint32_t batch;
+    uint32_t slots;
+    size_t slotBytes;
+    size_t bytes;
+    char *mem;
+    Header *header;
+
+    SlotHeader *slot(uint64_t i) const {
+        return (SlotHeader *) (mem + sizeof(Header) + (i % slots) * slotBytes);
+    }
+
+    // Fills one slot per batch of n and publishes them together, or none if too few slots are free.
+    bool push(const T *values, uint32_t n, uint32_t end) {
+        if (ShmChannel<T>::isBroken()) {
+            return true;
+        }
+        uint64_t h = header->head.load(std::memory_order_relaxed);
+        uint64_t pieces = n ? (n + batch - 1) / batch : 1;
+        if (h - header->tail.load(std::memory_order_acquire) + pieces > slots) {
+            return false;
+        }
+        for (uint64_t i = 0; i < pieces; ++i) {
+            uint32_t count = n - (uint32_t) i * batch < batch ? n - (uint32_t) i * batch : batch;
+            SlotHeader *s = ShmChannel<T>::slot(h + i);
+            s->count = count;
+            s->end = end;
+            if (count) {
+                memcpy(s + 1, values + i * batch, count * sizeof(T));
+            }
+        }
+        header->head.store(h + pieces, std::memory_order_release);
+        return true;
+    }
+
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "channel values are copied as bytes");
+
+    explicit ShmChannel(uint32_t batch = 256, uint32_t slots = 8) : batch(batch), slots(slots) {
+        slotBytes = (sizeof(SlotHeader) + batch * sizeof(T) + 63) / 64 * 64;
+        bytes = sizeof(Header) + slots * slotBytes;
+        void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        mem = p == MAP_FAILED ? nullptr : (char *) p;
+        header = mem ? new(mem) Header() : nullptr;
+        if (header) {
+            header->head.store(0);
+            header->tail.store(0);
+            header->broken.store(0);
+        }
+    }
+
+    ~ShmChannel() override {
+        if (mem) {
+            munmap(mem, bytes);
+        }
+    }
+
+    ShmChannel(const ShmChannel &) = delete;
+
+    ShmChannel &operator=(const ShmChannel &) = delete;
+
+    bool isOpen() const {
+        return mem != nullptr;
+    }
+
+    uint32_t getBatchSize() const override {
+        return batch;
+    }
+
+    bool trySend(const T *values, uint32_t n) override {
+        return ShmChannel<T>::push(values, n, 0);
+    }
+
+    bool trySendEnd() override {
+        return ShmChannel<T>::push(nullptr, 0, 1);
+    }
+
+    // What a dead sender published before it died is still delivered; then the channel ends.
+    int tryRecv(T *values) override {
+        if (!header) {
+            return CHANNEL_END;
+        }
+        uint64_t t = header->tail.load(std::memory_order_relaxed);
+        if (t == header->head.load(std::memory_order_acquire)) {
+            return ShmChannel<T>::isBroken() ? CHANNEL_END : CHANNEL_EMPTY;
+        }
+        SlotHeader *s = ShmChannel<T>::slot(t);
+        int n = s->end ? CHANNEL_END : (int) s->count;
+        if (n > 0) {
+            memcpy(values, s + 1, n * sizeof(T));
+        }
+        header->tail.store(t + 1, std::memory_order_release);
+        return n;
+    }
+
+    // Tells both ends the other one is gone; callable from any process that maps the ring.
+    void markBroken() {
+        if (header) {
+            header->broken.store(1, std::memory_order_release);
+        }
+    }
+
+    bool isBroken() const override {
+        return !header || header->broken.load(std::memory_order_acquire) != 0;
+    }
+};
+
+inline int tcpListen(const std::string &host, int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t) port);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+        bind(fd, (sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Port a listening socket was bound to, for listeners created on port 0.
+inline int tcpPort(int listenFd) {
+    sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(listenFd, (sockaddr *) &addr, &len) != 0) {
+        return -1;
+    }
+    return ntohs(addr.sin_port);
+}
+
+inline int tcpAccept(int listenFd) {
+    int fd;
+    do {
+        fd = accept(listenFd, nullptr, nullptr);
+    } while (fd < 0 && errno == EINTR);
+    return fd;
+}
+
+inline int tcpConnect(const std::string &host, int port) {
+    addrinfo hints, *res = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0) {
+        return -1;
+    }
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+/*
+ * One direction of a TCP connection. The sender starts with `window` credits and spends
+ * one per batch; the receiver returns a one-byte credit for every batch it consumes.
+ * The socket stays blocking: a batch is written whole, and credits keep at most a window
+ * of batches in flight, with socket buffers asked to hold that much, so a send waits in
+ * the kernel only when the kernel caps the buffers below the window. Receiving never
+ * waits. An error or a peer that hangs up breaks the channel. Each process constructs
+ * only its own end: sender on one side, receiver on the other.
+ */
+template<class T>
+class TcpChannel : public Channel<T> {
+private:
+    int fd;
+    bool sender;
+    bool broken;
+    bool creditsClosed;
+    uint32_t batch;
+    uint32_t credits;
+    std::vector<char> rx;
+    size_t rxPos;
+    size_t rxLen;
+
+    bool frameReady() const {
+        uint32_t n;
+        if (rxLen - rxPos < 8) {
+            return false;
+        }
+        memcpy(&n, rx.data() + rxPos, sizeof(n));
+        return rxLen - rxPos >= 8 + (size_t) n * sizeof(T);
+    }
+
+    // A frame longer than a batch would never fit the receive buffer: the stream is corrupt.
+    bool frameTooLong() const {
+        uint32_t n;
+        if (rxLen - rxPos < 8) {
+            return false;
+        }
+        memcpy(&n, rx.data() + rxPos, sizeof(n));
+        return n > batch;
+    }
+
+    bool writeAll(const char *p, size_t n) {
+        while (n) {
+            ssize_t w = ::send(fd, p, n, MSG_NOSIGNAL);
+            if (w < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            p += w;
+            n -= (size_t) w;
+        }
+        return true;
+    }
+
+    // Sends n values as one frame per batch, all of them once enough credits have come back.
+    bool sendFrames(const T *values, uint32_t n, uint32_t end) {
+        if (broken) {
+            return true;
+        }
+        char c[256];
+        ssize_t r;
+        while ((r = ::recv(fd, c, sizeof(c), MSG_DONTWAIT)) > 0) {
+            credits += (uint32_t) r;
+        }
+        if (r == 0 || (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            broken = true;
+            return true;
+        }
+        uint32_t pieces = n ? (n + batch - 1) / batch : 1;
+        if (credits < pieces) {
+            return false;
+        }
+        for (uint32_t i = 0; i < pieces; ++i) {
+            uint32_t count = n - i * batch < batch ? n - i * batch : batch;
+            uint32_t frame[2] = {count, end};
+            if (!TcpChannel<T>::writeAll((const char *) frame, sizeof(frame)) ||
+                !TcpChannel<T>::writeAll((const char *) (values + (size_t) i * batch), count * sizeof(T))) {
+                broken = true;
+                return true;
+            }
+        }
+        credits -= pieces;
+        return true;
+    }
+
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "channel values are copied as bytes");
+
+    TcpChannel(int fd, bool sender, uint32_t batch = 256, uint32_t window = 8) : fd(fd), sender(sender),
+                                                                                  broken(fd < 0),
+                                                                                  creditsClosed(false),
+                                                                                  batch(batch), credits(window),
+                                                                                  rxPos(0), rxLen(0) {
+        rx.resize((8 + batch * sizeof(T)) * 2);
+        int one = 1;
+        int buf = (int) ((8 + batch * sizeof(T)) * window * 2);
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(fd, SOL_SOCKET, sender ? SO_SNDBUF : SO_RCVBUF, &buf, sizeof(buf));
+    }
+
+    ~TcpChannel() override {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    TcpChannel(const TcpChannel &) = delete;
+
+    TcpChannel &operator=(const TcpChannel &) = delete;
+
+    uint32_t getBatchSize() const override {
+        return batch;
+    }
+
+    bool trySend(const T *values, uint32_t n) override {
+        return sender && TcpChannel<T>::sendFrames(values, n, 0);
+    }
+
+    bool trySendEnd() override {
+        return sender && TcpChannel<T>::sendFrames(nullptr, 0, 1);
+    }
+
+    int tryRecv(T *values) override {
+        if (sender || broken) {
+            return CHANNEL_END;
+        }
+        if (!TcpChannel<T>::frameReady()) {
+            if (rxPos) {
+                memmove(rx.data(), rx.data() + rxPos, rxLen - rxPos);
+                rxLen -= rxPos;
+                rxPos = 0;
+            }
+            ssize_t r = ::recv(fd, rx.data() + rxLen, rx.size() - rxLen, MSG_DONTWAIT);
+            if (r > 0) {
+                rxLen += (size_t) r;
+            } else if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                broken = true;
+                return CHANNEL_END;
+            }
+            if (TcpChannel<T>::frameTooLong()) {
+                broken = true;
+                return CHANNEL_END;
+            }
+            if (!TcpChannel<T>::frameReady()) {
+                return CHANNEL_EMPTY;
+            }
+        }
+        uint32_t frame[2];
+        memcpy(frame, rx.data() + rxPos, sizeof(frame));
+        if (frame[0]) {
+            memcpy(values, rx.data() + rxPos + sizeof(frame), frame[0] * sizeof(T));
+        }
+        rxPos += sizeof(frame) + frame[0] * sizeof(T);
+        // A sender that has gone can take no credits, but what it sent before is still read.
+        char credit = 1;
+        if (!creditsClosed && !TcpChannel<T>::writeAll(&credit, 1)) {
+            creditsClosed = true;
+        }
+        return frame[1] ? CHANNEL_END : (int) frame[0];
+    }
+
+    bool isBroken() const override {
+        return broken;
+    }
+};
+
+#endif //CHANNEL_H
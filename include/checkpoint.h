@@ -0,0 +1,128 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+ * Binary state of a snapshot, written and read as raw bytes in host byte order. Snapshots are
+ * for resuming on the same build of the same graph, not for exchange between machines.
+ */
+class StateWriter {
+private:
+    std::vector<uint8_t> &out;
+
+public:
+    explicit StateWriter(std::vector<uint8_t> &out) : out(out) {}
+
+    void write(const void *p, size_t n) {
+        out.insert(out.end(), (const uint8_t *) p, (const uint8_t *) p + n);
+    }
+
+    template<class V>
+    void put(const V &v) {
+        StateWriter::write(&v, sizeof(v));
+    }
+
+    size_t size() const {
+        return out.size();
+    }
+
+    std::vector<uint8_t> &getData() {
+        return out;
+    }
+};
+
+class StateReader {
+private:
+    const uint8_t *p;
+    const uint8_t *end;
+
+public:
+    StateReader(const uint8_t *p, const uint8_t *end) : p(p), end(end) {}
+
+    // Copies n bytes, or returns false without moving if fewer are left.
+    bool read(void *dst, size_t n) {
+        if ((size_t) (end - p) < n) {
+            return false;
+        }
+        memcpy(dst, p, n);
+        p += n;
+        return true;
+    }
+
+    bool skip(size_t n) {
+        if ((size_t) (end - p) < n) {
+            return false;
+        }
+        p += n;
+        return true;
+    }
+
+    template<class V>
+    bool get(V &v) {
+        return StateReader::read(&v, sizeof(v));
+    }
+
+    const uint8_t *position() const {
+        return p;
+    }
+
+    size_t remaining() const {
+        return (size_t) (end - p);
+    }
+};
+
+// "DFS1" in little endian: the first word of every DataFlow snapshot.
+static const uint32_t CHECKPOINT_MAGIC = 0x31534644;
+
+static const uint64_t FNV1A_OFFSET = 14695981039346656037ULL;
+
+// FNV-1a over n bytes; pass the previous result as h to hash several pieces as one.
+inline uint64_t checkpointHash(const void *data, size_t n, uint64_t h = FNV1A_OFFSET) {
+    auto p = (const uint8_t *) data;
+    for (size_t i = 0; i < n; ++i) {
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+// Writes to path + ".tmp" and renames it over path, so a crash never leaves a torn file.
+inline bool writeFileAtomic(const std::string &path, const std::vector<uint8_t> &bytes) {
+    std::string tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+    ok = fclose(f) == 0 && ok;
+    return ok && rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+inline bool readFile(const std::string &path, std::vector<uint8_t> &bytes) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    bytes.clear();
+    uint8_t buf[1 << 16];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        bytes.insert(bytes.end(), buf, buf + n);
+    }
+    fclose(f);
+    return true;
+}
+
+inline bool saveCheckpoint(const std::string &path, const std::vector<uint8_t> &snapshot) {
+    return writeFileAtomic(path, snapshot);
+}
+
+inline bool loadCheckpoint(const std::string &path, std::vector<uint8_t> &snapshot) {
+    return readFile(path, snapshot);
+}
+
+#endif //CHECKPOINT_H
@@ -0,0 +1,303 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <buffered_writer.h>
+#include <data_flow.h>
+#include <operator.h>
+
+// Bumped whenever the code emitCpp() writes or the kernel signature changes.
+static const unsigned NATIVE_KERNEL_ABI = 1;
+
+// The C++ spelling of T for generated code, or nullptr when T cannot be emitted.
+template<class T>
+const char *codegenTypeName(T *) {
+    return nullptr;
+}
+
+inline const char *codegenTypeName(char *) { return "char"; }
+
+inline const char *codegenTypeName(signed char *) { return "signed char"; }
+
+inline const char *codegenTypeName(unsigned char *) { return "unsigned char"; }
+
+inline const char *codegenTypeName(short *) { return "short"; }
+
+inline const char *codegenTypeName(unsigned short *) { return "unsigned short"; }
+
+inline const char *codegenTypeName(int *) { return "int"; }
+
+inline const char *codegenTypeName(unsigned *) { return "unsigned"; }
+
+inline const char *codegenTypeName(long *) { return "long"; }
+
+inline const char *codegenTypeName(unsigned long *) { return "unsigned long"; }
+
+inline const char *codegenTypeName(long long *) { return "long long"; }
+
+inline const char *codegenTypeName(unsigned long long *) { return "unsigned long long"; }
+
+inline const char *codegenTypeName(float *) { return "float"; }
+
+inline const char *codegenTypeName(double *) { return "double"; }
+
+// v as an exact value_t expression: integers in full, floating point with round-trip precision.
+template<class T>
+std::string codegenLiteral(T v, typename std::enable_if<std::is_integral<T>::value>::type * = nullptr) {
+    if (!std::is_signed<T>::value) {
+        return "(value_t) " + std::to_string((unsigned long long) v) + "ULL";
+    }
+    if ((long long) v == LLONG_MIN) {
+        return "(value_t) (-9223372036854775807LL - 1)";
+    }
+    return "(value_t) " + std::to_string((long long) v) + "LL";
+}
+
+template<class T>
+std::string codegenLiteral(T v, typename std::enable_if<std::is_floating_point<T>::value>::type * = nullptr) {
+    if (std::isnan(v)) {
+        return "std::numeric_limits<value_t>::quiet_NaN()";
+    } else if (std::isinf(v)) {
+        return v > 0 ? "std::numeric_limits<value_t>::infinity()" : "-std::numeric_limits<value_t>::infinity()";
+    }
+    char buf[64];
+    snprintf(buf, sizeof(buf), "(value_t) %.17g", (double) v);
+    return buf;
+}
+
+template<class T>
+std::string codegenLiteral(T, typename std::enable_if<!std::is_arithmetic<T>::value>::type * = nullptr) {
+    return "value_t()";
+}
+
+// Whether op is an object of B, or of I when it takes an immediate.
+template<class B, class I, class T>
+bool isBuiltinClass(const Operator<T> *op) {
+    return op->getType() == OP_IMMEDIATE ? dynamic_cast<const I *>(op) != nullptr
+                                         : dynamic_cast<const B *>(op) != nullptr;
+}
+
+/*
+ * Whether op is one of the single-rate operators defined in operator.h (not an input or
+ * output): its opcode and type name the class, and the object must be of that class, since
+ * other operators (Downsample, Upsample, user subclasses of Operator) may reuse an opcode.
+ * Backends that replace compute() with their own code for each opcode, like PackedExecutor
+ * and emitCpp(), only take these.
+ */
+template<class T>
+bool isBuiltinOperator(const Operator<T> *op) {
+    if (op->getRateUp() != 1 || op->getRateDown() != 1 ||
+        (op->getType() != OP_BASIC && op->getType() != OP_IMMEDIATE)) {
+        return false;
+    }
+    bool basic = op->getType() == OP_BASIC;
+    switch (op->getOpCode()) {
+        case OP_PASS_A:
+            return basic && dynamic_cast<const PassA<T> *>(op) != nullptr;
+        case OP_PASS_B:
+            return isBuiltinClass<PassB<T>, PassBi<T>>(op);
+        case OP_MIN:
+            return isBuiltinClass<Min<T>, Mini<T>>(op);
+        case OP_MAX:
+            return isBuiltinClass<Max<T>, Maxi<T>>(op);
+        case OP_BEQ:
+            return isBuiltinClass<Beq<T>, Beqi<T>>(op);
+        case OP_BNE:
+            return isBuiltinClass<Bne<T>, Bnei<T>>(op);
+        case OP_SLT:
+            return isBuiltinClass<Slt<T>, Slti<T>>(op);
+        case OP_SGT:
+            return isBuiltinClass<Sgt<T>, Sgti<T>>(op);
+        case OP_ADD:
+            return isBuiltinClass<Add<T>, Addi<T>>(op);
+        case OP_SUB:
+            return isBuiltinClass<Sub<T>, Subi<T>>(op);
+        case OP_MULT:
+            return isBuiltinClass<Mult<T>, Multi<T>>(op);
+        case OP_XOR:
+            return isBuiltinClass<Xor<T>, Xori<T>>(op);
+        case OP_AND:
+            return isBuiltinClass<And<T>, Andi<T>>(op);
+        case OP_OR:
+            return isBuiltinClass<Or<T>, Ori<T>>(op);
+        case OP_NOT:
+            return basic && dynamic_cast<const Not<T> *>(op) != nullptr;
+        case OP_SHL:
+            return isBuiltinClass<Shl<T>, Shli<T>>(op);
+        case OP_SHR:
+            return isBuiltinClass<Shr<T>, Shri<T>>(op);
+        case OP_MUX:
+            return isBuiltinClass<Mux<T>, Muxi<T>>(op);
+        case OP_ABS:
+            return basic && dynamic_cast<const Abs<T> *>(op) != nullptr;
+        default:
+            return false;
+    }
+}
+
+// The source emitCpp() writes.
+template<class T>
+bool generateCpp(const DataFlow<T> &df, std::string &source) {
+    const char *type = codegenTypeName((T *) nullptr);
+    if (!type) {
+        return false;
+    }
+    std::vector<Operator<T> *> order;
+    for (auto item:df.getOpArray()) {
+        auto op = item.second;
+        bool ok = op->getType() == OP_IN ? dynamic_cast<InputStream<T> *>(op) != nullptr :
+                  op->getType() == OP_OUT ? dynamic_cast<OutputStream<T> *>(op) != nullptr :
+                  isBuiltinOperator(op);
+        Operator<T> *srcs[3] = {op->getSrcA(), op->getSrcB(), op->getBranchIn()};
+        for (int k = 0; k < 3; ++k) {
+            ok = ok && (!(op->getPorts() & (1u << k)) ||
+                        (srcs[k] && df.getOpArray().count(srcs[k]->getId())));
+        }
+        if (!ok) {
+            return false;
+        }
+        order.push_back(op);
+    }
+    std::stable_sort(order.begin(), order.end(), [](Operator<T> *a, Operator<T> *b) {
+        return std::max(0, a->getLevel()) < std::max(0, b->getLevel());
+    });
+
+    std::map<const Operator<T> *, std::string> var;
+    std::string ids, inIds, outIds, load, store;
+    int numIn = 0, numOut = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        auto n = std::to_string(i);
+        var[order[i]] = "v" + n;
+        ids += (i ? ", " : "") + std::to_string(order[i]->getId());
+        load += "    value_t v" + n + " = s[" + n + "];\n";
+        store += "    s[" + n + "] = v" + n + ";\n";
+        if (order[i]->getType() == OP_IN) {
+            auto k = std::to_string(numIn++);
+            inIds += (k == "0" ? "" : ", ") + std::to_string(order[i]->getId());
+            load += "    const value_t *d" + k + " = in[" + k + "]->data();\n";
+            load += "    unsigned long n" + k + " = in[" + k + "]->size(), p" + k + " = pos[" + k + "];\n";
+            load += "    unsigned char e" + k + " = end[" + k + "];\n";
+            store += "    pos[" + k + "] = p" + k + ";\n    end[" + k + "] = e" + k + ";\n";
+        } else if (order[i]->getType() == OP_OUT) {
+            auto k = std::to_string(numOut++);
+            outIds += (k == "0" ? "" : ", ") + std::to_string(order[i]->getId());
+            load += "    std::vector<value_t> &o" + k + " = *out[" + k + "];\n";
+        }
+    }
+
+    std::string body;
+    std::string ended;
+    int in = 0, out = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        auto op = order[i];
+        auto v = var[op];
+        auto a = op->getSrcA() ? var[op->getSrcA()] : "";
+        auto b = op->getType() == OP_IMMEDIATE ? codegenLiteral(op->getConst()) :
+                 op->getSrcB() ? var[op->getSrcB()] : "";
+        auto c = op->getBranchIn() ? var[op->getBranchIn()] : "";
+        std::string line;
+        if (op->getType() == OP_IN) {
+            auto k = std::to_string(in++);
+            line = "if (p" + k + " < n" + k + ") { " + v + " = d" + k + "[p" + k + "++]; } else { e" + k +
+                   " = 1; }";
+            ended += " + e" + k;
+        } else if (op->getType() == OP_OUT) {
+            line = v + " = " + a + "; o" + std::to_string(out++) + ".push_back(" + v + ");";
+        } else {
+            static const char *const binary[] = {"", "", "", "", "==", "!=", "<", ">", "+", "-", "*", "^", "&", "|",
+                                                 "", "<<", ">>"};
+            int code = op->getOpCode();
+            switch (code) {
+                case OP_PASS_A:
+                    line = v + " = " + a + ";";
+                    break;
+                case OP_PASS_B:
+                    line = v + " = " + b + ";";
+                    break;
+                case OP_MIN:
+                    line = v + " = " + a + " < " + b + " ? " + a + " : " + b + ";";
+                    break;
+                case OP_MAX:
+                    line = v + " = " + a + " > " + b + " ? " + a + " : " + b + ";";
+                    break;
+                case OP_BEQ:
+                case OP_BNE:
+                case OP_SLT:
+                case OP_SGT:
+                    line = v + " = (value_t) (" + a + " " + binary[code] + " " + b + " ? 1 : 0);";
+                    break;
+                case OP_NOT:
+                    line = v + " = (value_t) ~" + a + ";";
+                    break;
+                case OP_MUX:
+                    line = v + " = " + c + " ? " + a + " : " + b + ";";
+                    break;
+                case OP_ABS:
+                    // std::abs, as a plain abs() would take the C int overload for floating point.
+                    line = std::is_unsigned<T>::value ? v + " = " + (a.empty() ? b : a) + ";" :
+                           v + " = (value_t) std::abs(" + (a.empty() ? b : a) + ");";
+                    break;
+                default:
+                    line = v + " = (value_t) (" + a + " " + binary[code] + " " + b + ");";
+            }
+        }
+        body += "        " + line + "\n";
+        bool levelEnds = i + 1 == order.size() ||
+                         std::max(0, order[i + 1]->getLevel()) != std::max(0, op->getLevel());
+        if (levelEnds && !ended.empty()) {
+            body += "        all +=" + ended + ";\n        if (all == " + std::to_string(numIn) +
+                    ") {\n            cycle++;\n            break;\n        }\n";
+            ended.clear();
+        }
+    }
+
+    char abi[32];
+    snprintf(abi, sizeof(abi), "0x%04x%04x", NATIVE_KERNEL_ABI, (unsigned) sizeof(T));
+    source = "// Generated by emitCpp() from graph \"" + df.getName() + "\": " +
+             std::to_string(order.size()) + " operators, " + std::to_string(numIn) + " inputs, " +
+             std::to_string(numOut) + " outputs.\n"
+             "#include <cmath>\n#include <cstdlib>\n#include <limits>\n#include <vector>\n\n"
+             "typedef " + std::string(type) + " value_t;\n\n"
+             "extern \"C\" const unsigned dataflow_kernel_abi = " + abi + ";\n"
+             "extern \"C\" const unsigned long dataflow_kernel_counts[3] = {" + std::to_string(order.size()) +
+             ", " + std::to_string(numIn) + ", " + std::to_string(numOut) + "};\n"
+             "extern \"C\" const int dataflow_kernel_ops[] = {" + (ids.empty() ? "-1" : ids) + "};\n"
+             "extern \"C\" const int dataflow_kernel_inputs[] = {" + (inIds.empty() ? "-1" : inIds) + "};\n"
+             "extern \"C\" const int dataflow_kernel_outputs[] = {" + (outIds.empty() ? "-1" : outIds) + "};\n\n"
+             "// Runs up to maxCycles cycles, stopping after the one that finds every input at its end.\n"
+             "extern \"C\" unsigned long dataflow_kernel(value_t *s, const std::vector<value_t> *const *in,\n"
+             "                                       unsigned long *pos, unsigned char *end,\n"
+             "                                       std::vector<value_t> *const *out,\n"
+             "                                       unsigned long maxCycles) {\n" +
+             load + "    unsigned long cycle = 0;\n" +
+             (numIn ? "    while (cycle < maxCycles) {\n        unsigned long all = 0;\n" + body +
+                      "        cycle++;\n    }\n" : "") +
+             store + "    return cycle;\n}\n";
+    return true;
+}
+
+/*
+ * Writes the graph as a C++ kernel that NativeKernel compiles and loads: one statement per
+ * operator in the order the sealed compute() runs them, every value in a local, and the
+ * end-of-input checks of compute() after each level that holds an input. The kernel runs a
+ * block of cycles over the vectors of the InputStream and OutputStream operators; the ids of
+ * its values, inputs and outputs are exported with it. Only arithmetic T and graphs of
+ * streams and the built-in single-rate operators with every read port connected can be
+ * emitted; anything else returns false and writes nothing.
+ */
+template<class T>
+bool emitCpp(const DataFlow<T> &df, const std::string &fileNamePath) {
+    std::string source;
+    if (!generateCpp(df, source)) {
+        return false;
+    }
+    BufferedWriter out(fileNamePath);
+    out.write(source);
+    return out.close();
+}
+
+#endif //CODEGEN_H
@@ -1,14 +1,29 @@
 #ifndef DATAFLOW_H
 #define DATAFLOW_H
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
 #include <queue>
 #include <map>
+#include <mutex>
+#include <string>
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <thread>
 #include <operator.h>
+#include <probe.h>
+#include <tracer.h>
+#include <buffered_writer.h>
+#include <perf_counters.h>
 
 using namespace std;
 
+// Only DataFlow::merge() uses builders; it is instantiated where graph_builder.h is included.
+template<class T>
+class GraphBuilder;
+
 template<class T>
 class DataFlow {
 
@@ -20,7 +35,44 @@ private:
     int num_op_in;
     int num_op_out;
     int num_op;
+    int num_edges;
     int max_level;
+    Tracer *tracer;
+    PerfCounterGroup *perf;
+    bool perf_per_level;
+    perf_sample_t perf_total;
+    std::vector<perf_sample_t> perf_levels;
+    std::vector<unsigned long> level_firings;
+    unsigned long num_cycles;
+    unsigned long num_tokens;
+    bool multi_rate;
+    std::vector<Operator<T> *> rate_inputs;
+    std::vector<Operator<T> *> rate_outputs;
+    unsigned long resume_cycle;
+    unsigned long checkpoint_every;
+    std::function<void(std::vector<uint8_t> &)> checkpoint_fn;
+    std::atomic<bool> checkpoint_requested;
+    static const int MAX_PROBES = 64;
+    std::atomic<Probe<T> *> probes[MAX_PROBES];
+    std::atomic<int> num_probes;
+    std::atomic<bool> computing;
+    std::atomic<unsigned long> probe_epoch;
+    bool sealed;
+
+    // Consecutive operators of one level with the same period, skipped as a whole on the cycles they do not fire.
+    struct ScheduleRun {
+        size_t end;
+        int period;
+    };
+
+    bool schedule_stale;
+    std::vector<Operator<T> *> schedule_ops;
+    std::vector<size_t> schedule_level_end;
+    std::vector<Operator<T> *> schedule_inputs;
+    std::vector<size_t> schedule_input_end;
+    std::vector<ScheduleRun> schedule_runs;
+    std::vector<size_t> schedule_run_end;
+    LiveStats live;
 
     void addOperator(Operator<T> *op) {
         if(DataFlow<T>::op_array.find(op->getId()) == DataFlow<T>::op_array.end()) {
@@ -37,6 +89,323 @@ private:
             }
         }
     }
+
+    struct ExportFilter {
+        int minLevel;
+        int maxLevel;
+        std::vector<int> ops;
+
+        bool selected(Operator<T> *op) const {
+            if (op->getLevel() < minLevel || op->getLevel() > maxLevel) {
+                return false;
+            }
+            return ops.empty() || std::binary_search(ops.begin(), ops.end(), op->getId());
+        }
+    };
+
+    static ExportFilter exportAll() {
+        return DataFlow<T>::exportLevels(INT_MIN, INT_MAX);
+    }
+
+    static ExportFilter exportLevels(int minLevel, int maxLevel) {
+        ExportFilter f;
+        f.minLevel = minLevel;
+        f.maxLevel = maxLevel;
+        return f;
+    }
+
+    static ExportFilter exportOps(const std::vector<int> &ops) {
+        ExportFilter f = DataFlow<T>::exportAll();
+        f.ops = ops;
+        std::sort(f.ops.begin(), f.ops.end());
+        if (f.ops.empty()) {
+            f.minLevel = INT_MAX;
+        }
+        return f;
+    }
+
+    bool exportDOT(const std::string &fileNamePath, const ExportFilter &filter) {
+        BufferedWriter out(fileNamePath);
+        out.write("digraph ").write(DataFlow<T>::name).write("{\n");
+        for (auto op:DataFlow<T>::op_array) {
+            if (!filter.selected(op.second)) {
+                continue;
+            }
+            out.put(' ').writeInt(op.first);
+            if (op.second->getType() == OP_IN) {
+                out.write(" [ label = in").writeInt(op.second->getId()).write(" ]\n");
+            } else if (op.second->getType() == OP_OUT) {
+                out.write(" [ label = out").writeInt(op.second->getId()).write(" ]\n");
+            } else if (op.second->getType() == OP_IMMEDIATE) {
+                out.write(" [ label = ").write(op.second->getLabel());
+                out.write(", value = ").writeValue(op.second->getConst()).write("]\n");
+                out.write(" \"").writeInt(op.first).put('.').writeValue(op.second->getConst());
+                out.write("\"[ label = ").writeValue(op.second->getConst()).write(" ]\n");
+            } else {
+                out.write(" [ label = ").write(op.second->getLabel()).write("]\n");
+            }
+        }
+        for (auto op:DataFlow<T>::op_array) {
+            if (!filter.selected(op.second)) {
+                continue;
+            }
+            if (op.second->getType() == OP_IMMEDIATE) {
+                out.write(" \"").writeInt(op.first).put('.').writeValue(op.second->getConst());
+                out.write("\" -> ").writeInt(op.first).put('\n');
+            }
+            for (auto op_dst:op.second->getDst()) {
+                if (filter.selected(op_dst)) {
+                    out.put(' ').writeInt(op.first).write(" -> ").writeInt(op_dst->getId()).put('\n');
+                }
+            }
+        }
+        out.write("}\n");
+        return out.close();
+    }
+
+    bool exportJSON(const std::string &fileNamePath, const ExportFilter &filter) {
+        BufferedWriter out(fileNamePath);
+        out.write("[\n");
+        int max_id = 0;
+        for (auto item:DataFlow<T>::op_array) {
+            auto op = item.second;
+            if (!filter.selected(op)) {
+                continue;
+            }
+            out.write(R"({"data":{"id":")").writeInt(op->getId());
+            if (op->getLabel() == "sub") {
+                out.write(R"(","op1":")").writeInt(op->getSrcA() ? op->getSrcA()->getId() : -1);
+                out.write(R"(","op2":")").writeInt(op->getSrcB() ? op->getSrcB()->getId() : -1);
+            }
+            out.write(R"(","type":")").write(op->getLabel()).write(R"("},"group":"nodes"},)").put('\n');
+            if (op->getId() > max_id) {
+                max_id = op->getId();
+            }
+        }
+        int id_edges = max_id + 1;
+        bool first = true;
+        for (auto item:DataFlow<T>::op_array) {
+            auto op = item.second;
+            if (!filter.selected(op)) {
+                continue;
+            }
+            for (auto neighbor:op->getDst()) {
+                if (!filter.selected(neighbor)) {
+                    continue;
+                }
+                out.write(first ? "" : ",\n");
+                first = false;
+                out.write(R"({"data":{"id":")").writeInt(id_edges++);
+                out.write(R"(","source":")").writeInt(op->getId());
+                out.write(R"(","target":")").writeInt(neighbor->getId()).write(R"("},"group":"edges"})");
+            }
+        }
+        out.write(first ? "]" : "\n]");
+        return out.close();
+    }
+
+    // magic | sizeof(T) | #ops | next cycle | per op in id order: id, state size, state | FNV-1a of the rest
+    std::vector<uint8_t> snapshotAt(unsigned long cycle) const {
+        std::vector<uint8_t> buf;
+        StateWriter out(buf);
+        out.put(CHECKPOINT_MAGIC);
+        out.put((uint32_t) sizeof(T));
+        out.put((uint32_t) DataFlow<T>::op_array.size());
+        out.put((uint64_t) cycle);
+        for (auto item:DataFlow<T>::op_array) {
+            out.put((int32_t) item.first);
+            size_t at = out.size();
+            out.put((uint32_t) 0);
+            item.second->saveState(out);
+            uint32_t len = (uint32_t) (out.size() - at - sizeof(uint32_t));
+            memcpy(buf.data() + at, &len, sizeof(len));
+        }
+        out.put(checkpointHash(buf.data(), buf.size()));
+        return buf;
+    }
+
+    // Hands the value of every probed operator that fired this cycle to its probe.
+    void recordProbes(unsigned long cycle) {
+        for (auto &slot:DataFlow<T>::probes) {
+            auto probe = slot.load(std::memory_order_acquire);
+            if (probe && cycle % probe->getOp()->getPeriod() == 0) {
+                probe->record(cycle);
+            }
+        }
+        DataFlow<T>::probe_epoch.fetch_add(1, std::memory_order_release);
+    }
+
+    static void setPort(Operator<T> *src, Operator<T> *dst, PORT dstPort) {
+        if (dstPort == PORT_A) {
+            dst->setSrcA(src);
+        } else if (dstPort == PORT_B) {
+            dst->setSrcB(src);
+        } else if (dstPort == PORT_BRANCH) {
+            dst->setBranchIn(src);
+        }
+    }
+
+    // Runs fn(begin, end) over [0, n) split into one range per thread, or inline when n is under two grains.
+    static void parallelFor(size_t n, int threads, const std::function<void(size_t, size_t)> &fn,
+                            size_t grain = 4096) {
+        size_t parts = std::min((size_t) std::max(threads, 1), (n + grain - 1) / grain);
+        if (parts <= 1) {
+            fn(0, n);
+            return;
+        }
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < parts; ++t) {
+            workers.emplace_back(fn, n * t / parts, n * (t + 1) / parts);
+        }
+        fn(0, n / parts);
+        for (auto &w:workers) {
+            w.join();
+        }
+    }
+
+    // Makes the next compute() rebuild its schedule; called by everything that edits the graph or its levels.
+    void invalidateSchedule() {
+        DataFlow<T>::schedule_stale = true;
+    }
+
+    /*
+     * Rebuilds what compute() runs from: the periods (updateRates()), the operators by level
+     * and by id within a level (a negative level runs as level 0), the inputs in the same order,
+     * and the runs of operators with the same period in each level.
+     */
+    void buildSchedule() {
+        DataFlow<T>::updateRates();
+        size_t levels = 0;
+        for (auto item:DataFlow<T>::op_array) {
+            levels = std::max(levels, (size_t) std::max(0, item.second->getLevel()) + 1);
+        }
+        auto &ops = DataFlow<T>::schedule_ops;
+        auto &inputs = DataFlow<T>::schedule_inputs;
+        auto &levelEnd = DataFlow<T>::schedule_level_end;
+        auto &inputEnd = DataFlow<T>::schedule_input_end;
+        ops.clear();
+        inputs.clear();
+        levelEnd.assign(levels, 0);
+        inputEnd.assign(levels, 0);
+        for (auto item:DataFlow<T>::op_array) {
+            auto l = (size_t) std::max(0, item.second->getLevel());
+            levelEnd[l]++;
+            inputEnd[l] += item.second->getType() == OP_IN ? 1 : 0;
+            ops.push_back(item.second);
+            if (item.second->getType() == OP_IN) {
+                inputs.push_back(item.second);
+            }
+        }
+        for (size_t l = 1; l < levels; ++l) {
+            levelEnd[l] += levelEnd[l - 1];
+            inputEnd[l] += inputEnd[l - 1];
+        }
+        auto byLevel = [](Operator<T> *a, Operator<T> *b) {
+            return std::max(0, a->getLevel()) < std::max(0, b->getLevel());
+        };
+        std::stable_sort(ops.begin(), ops.end(), byLevel);
+        std::stable_sort(inputs.begin(), inputs.end(), byLevel);
+
+        DataFlow<T>::schedule_runs.clear();
+        DataFlow<T>::schedule_run_end.assign(levels, 0);
+        for (size_t l = 0, i = 0; l < levels; ++l) {
+            for (size_t begin = i; i < levelEnd[l]; ++i) {
+                int period = ops[i]->getPeriod();
+                if (i == begin || DataFlow<T>::schedule_runs.back().period != period) {
+                    ScheduleRun run = {i + 1, period};
+                    DataFlow<T>::schedule_runs.push_back(run);
+                } else {
+                    DataFlow<T>::schedule_runs.back().end = i + 1;
+                }
+            }
+            DataFlow<T>::schedule_run_end[l] = DataFlow<T>::schedule_runs.size();
+        }
+        DataFlow<T>::schedule_stale = false;
+    }
+
+    // Passes every operator of schedule level l that fires on this cycle to fire(op); returns how many fired.
+    template<class F>
+    unsigned long fireLevel(size_t l, unsigned long cycle, const F &fire) {
+        unsigned long fired = 0;
+        size_t run = l ? DataFlow<T>::schedule_run_end[l - 1] : 0;
+        size_t op = run ? DataFlow<T>::schedule_runs[run - 1].end : 0;
+        for (; run < DataFlow<T>::schedule_run_end[l]; ++run) {
+            const ScheduleRun &r = DataFlow<T>::schedule_runs[run];
+            if (r.period == 1 || cycle % r.period == 0) {
+                fired += r.end - op;
+                for (; op < r.end; ++op) {
+                    fire(DataFlow<T>::schedule_ops[op]);
+                }
+            }
+            op = r.end;
+        }
+        return fired;
+    }
+
+    // Inputs of schedule level l that are at their end.
+    int endedInputs(size_t l) const {
+        int ended = 0;
+        size_t in = l ? DataFlow<T>::schedule_input_end[l - 1] : 0;
+        for (; in < DataFlow<T>::schedule_input_end[l]; ++in) {
+            ended += DataFlow<T>::schedule_inputs[in]->isEnd() ? 1 : 0;
+        }
+        return ended;
+    }
+
+    // One iteration of compute(): the levels in order, each firing through fire(op), until every input is at its end.
+    template<class F>
+    int computeCycle(unsigned long cycle, const F &fire) {
+        int allIsEnd = 0;
+        for (size_t l = 0; l < DataFlow<T>::schedule_level_end.size(); ++l) {
+            DataFlow<T>::fireLevel(l, cycle, fire);
+            allIsEnd += DataFlow<T>::endedInputs(l);
+            if (allIsEnd == DataFlow<T>::getNumOpIn()) {
+                break;
+            }
+        }
+        return allIsEnd;
+    }
+
+    static long gcd(long a, long b) {
+        while (b) {
+            long r = a % b;
+            a = b;
+            b = r;
+        }
+        return a;
+    }
+
+    // Same as one iteration of compute(), recording the cycle, each level phase and every stream operator
+    // when traced, and the counter delta of each level when per-level profiling is on.
+    int computeInstrumentedCycle(unsigned long cycle, bool traced) {
+        auto t = traced ? DataFlow<T>::tracer : nullptr;
+        auto p = DataFlow<T>::perf_per_level ? DataFlow<T>::perf : nullptr;
+        auto fire = [t](Operator<T> *op) {
+            if (t && (op->getType() == OP_IN || op->getType() == OP_OUT)) {
+                TraceScope streamScope(t, op->getType() == OP_IN ? "stream_in" : "stream_out", "io", "op", op->getId());
+                op->compute();
+            } else {
+                op->compute();
+            }
+        };
+        int allIsEnd = 0;
+        TraceScope cycleScope(t, "cycle", "compute", "cycle", (long long) cycle);
+        for (size_t l = 0; l < DataFlow<T>::schedule_level_end.size(); ++l) {
+            TraceScope levelScope(t, "level", "compute", "level", (long long) l);
+            perf_sample_t begin = p ? p->read() : perfSampleZero();
+            unsigned long firings = DataFlow<T>::fireLevel(l, cycle, fire);
+            if (p) {
+                perfSampleAdd(DataFlow<T>::perf_levels[l], perfSampleDiff(p->read(), begin));
+                DataFlow<T>::level_firings[l] += firings;
+            }
+            allIsEnd += DataFlow<T>::endedInputs(l);
+            if (allIsEnd == DataFlow<T>::getNumOpIn()) {
+                break;
+            }
+        }
+        return allIsEnd;
+    }
+
     /*
     void load(const vector<tuple<string, int, int, int>>& d) {
         for(auto c : d){
@@ -68,7 +437,15 @@ private:
 public:
 
     DataFlow(int id, std::string name) : id(id), name(std::move(name)), num_op_in(0), num_op_out(0), num_op(0),
-                                         max_level(0) {}
+                                         num_edges(0), max_level(0), tracer(nullptr), perf(nullptr),
+                                         perf_per_level(false), perf_total(perfSampleZero()), num_cycles(0),
+                                         num_tokens(0), multi_rate(false), resume_cycle(0), checkpoint_every(0),
+                                         checkpoint_requested(false), num_probes(0), computing(false),
+                                         probe_epoch(0), sealed(false), schedule_stale(true) {
+        for (auto &p:DataFlow<T>::probes) {
+            p.store(nullptr);
+        }
+    }
 
     ~DataFlow() {
         DataFlow<T>::op_array.clear();
@@ -79,32 +456,115 @@ public:
     }
 
     Operator<T> *removeOperator(int op_id) {
+        if (DataFlow<T>::sealed) {
+            return nullptr;
+        }
         Operator<T> *r = DataFlow<T>::op_array[op_id];
         DataFlow<T>::op_array.erase(op_id);
+        DataFlow<T>::invalidateSchedule();
         r->setDataFlowId(-1);
         return r;
     }
 
     void compute() {
-        auto n = DataFlow<T>::getMaxLevel();
-        unsigned long allIsEnd = 0;
+        int allIsEnd = 0;
+        unsigned long start = DataFlow<T>::resume_cycle;
+        unsigned long cycle = start;
+        DataFlow<T>::resume_cycle = 0;
+        DataFlow<T>::num_tokens = 0;
+        if (DataFlow<T>::schedule_stale) {
+            DataFlow<T>::buildSchedule();
+        }
+        if (DataFlow<T>::perf) {
+            DataFlow<T>::perf_levels.assign(DataFlow<T>::schedule_level_end.size(), perfSampleZero());
+            DataFlow<T>::level_firings.assign(DataFlow<T>::schedule_level_end.size(), 0);
+            DataFlow<T>::perf->start();
+        }
+        unsigned long long tokensOut = 0;
+        DataFlow<T>::live.begin(1);
+        DataFlow<T>::computing.store(true);
         while (allIsEnd != DataFlow<T>::getNumOpIn()) {
-            allIsEnd = 0;
-            for (int i = 0; i <= n; ++i) {
-                for (auto item:DataFlow<T>::getOpArray()) {
-                    auto op = item.second;
-                    if (op->getLevel() == i) {
-                        op->compute();
-                        if (op->getType() == OP_IN && op->isEnd()) {
-                            allIsEnd++;
-                        }
-                    }
+            if (DataFlow<T>::checkpoint_fn &&
+                ((DataFlow<T>::checkpoint_every && cycle != start && cycle % DataFlow<T>::checkpoint_every == 0) ||
+                 (DataFlow<T>::checkpoint_requested.load(std::memory_order_relaxed) &&
+                  DataFlow<T>::checkpoint_requested.exchange(false)))) {
+                auto snapshot = DataFlow<T>::snapshotAt(cycle);
+                DataFlow<T>::checkpoint_fn(snapshot);
+            }
+            bool traced = DataFlow<T>::tracer && DataFlow<T>::tracer->sampleCycle(cycle);
+            if (traced || (DataFlow<T>::perf && DataFlow<T>::perf_per_level)) {
+                allIsEnd = DataFlow<T>::computeInstrumentedCycle(cycle, traced);
+            } else if (DataFlow<T>::sealed) {
+                allIsEnd = DataFlow<T>::computeCycle(cycle, [](Operator<T> *op) {
+                    op->computeSealed();
+                });
+            } else {
+                allIsEnd = DataFlow<T>::computeCycle(cycle, [](Operator<T> *op) {
+                    op->compute();
+                });
+            }
+            bool ran = allIsEnd != DataFlow<T>::getNumOpIn();
+            if (DataFlow<T>::multi_rate) {
+                for (auto in:DataFlow<T>::rate_inputs) {
+                    DataFlow<T>::num_tokens += cycle % in->getPeriod() == 0 && !in->isEnd() ? 1 : 0;
                 }
-                if (allIsEnd == DataFlow<T>::getNumOpIn()) {
-                    break;
+                for (auto out:DataFlow<T>::rate_outputs) {
+                    tokensOut += ran && cycle % out->getPeriod() == 0 ? 1 : 0;
                 }
+            } else {
+                DataFlow<T>::num_tokens += DataFlow<T>::getNumOpIn() - allIsEnd;
+                tokensOut += ran ? DataFlow<T>::getNumOpOut() : 0;
+            }
+            DataFlow<T>::live.publish(0, cycle - start + 1, DataFlow<T>::num_tokens, tokensOut);
+            if (DataFlow<T>::num_probes.load(std::memory_order_relaxed) && ran) {
+                DataFlow<T>::recordProbes(cycle);
+            }
+            cycle++;
+        }
+        DataFlow<T>::computing.store(false);
+        DataFlow<T>::num_cycles = cycle - start;
+        for (auto item:DataFlow<T>::op_array) {
+            item.second->flush();
+        }
+        DataFlow<T>::live.finish(0);
+        DataFlow<T>::live.end();
+        if (DataFlow<T>::perf) {
+            DataFlow<T>::perf_total = DataFlow<T>::perf->read();
+            DataFlow<T>::perf->stop();
+        }
+    }
+
+    /*
+     * Puts every operator back to its initial state (input cursors to the start, values and
+     * end flags cleared) so compute() can run again without rebuilding or re-leveling.
+     * Output vectors belong to the caller and are not cleared.
+     */
+    void reset() {
+        for (auto item:DataFlow<T>::op_array) {
+            item.second->reset();
+        }
+        DataFlow<T>::num_cycles = 0;
+        DataFlow<T>::num_tokens = 0;
+        DataFlow<T>::resume_cycle = 0;
+    }
+
+    /*
+     * Points the InputStream and OutputStream operators, taken in increasing id order, at
+     * inputs[i] and outputs[i] (the same arrays a builder like FIR() takes) and resets the graph.
+     */
+    void rebind(std::vector<T> *inputs, std::vector<T> *outputs) {
+        int i = 0, o = 0;
+        for (auto item:DataFlow<T>::op_array) {
+            auto in = dynamic_cast<InputStream<T> *>(item.second);
+            if (in && inputs) {
+                in->setData(inputs[i++]);
+            }
+            auto out = dynamic_cast<OutputStream<T> *>(item.second);
+            if (out && outputs) {
+                out->setData(outputs[o++]);
             }
         }
+        DataFlow<T>::reset();
     }
 
     const std::map<int, Operator<T> *> &getOpArray() const {
@@ -118,85 +578,31 @@ public:
         return nullptr;
     }
 
-    void toDOT(const std::string& fileNamePath) {
+    // The exporters return false when the file could not be opened, written or closed.
+    bool toDOT(const std::string &fileNamePath) {
+        return DataFlow<T>::exportDOT(fileNamePath, DataFlow<T>::exportAll());
+    }
 
-        std::ofstream myfile;
-        myfile.open(fileNamePath);
-        myfile << "digraph " << DataFlow<T>::name << "{" << std::endl;
-        for (auto op:DataFlow<T>::op_array) {
-            if (op.second->getType() == OP_IN) {
-                myfile << " " << op.first << " [ label = in" << op.second->getId() << " ]" << std::endl;
-            } else if (op.second->getType() == OP_OUT) {
-                myfile << " " << op.first << " [ label = out" << op.second->getId() << " ]" << std::endl;
-            } else if (op.second->getType() == OP_IMMEDIATE) {
-                myfile << " " << op.first;
-                myfile << " [ label = " << op.second->getLabel();
-                myfile << ", value = " << op.second->getConst();
-                myfile << "]" << std::endl;
-                myfile << " \"" << op.first << "." << op.second->getConst() << "\"[ label = "
-                       << op.second->getConst()
-                       << " ]" << std::endl;
+    // Only the operators with minLevel <= level <= maxLevel and the edges between them.
+    bool toDOT(const std::string &fileNamePath, int minLevel, int maxLevel) {
+        return DataFlow<T>::exportDOT(fileNamePath, DataFlow<T>::exportLevels(minLevel, maxLevel));
+    }
 
-            } else {
-                myfile << " " << op.first << " [ label = " << op.second->getLabel() << "]" << std::endl;
-            }
+    // Only the given operators and the edges between them.
+    bool toDOT(const std::string &fileNamePath, const std::vector<int> &ops) {
+        return DataFlow<T>::exportDOT(fileNamePath, DataFlow<T>::exportOps(ops));
+    }
 
-        }
-        for (auto op:DataFlow<T>::op_array) {
-            if (op.second->getType() == OP_IMMEDIATE) {
-                myfile << " \"" << op.first << "." << op.second->getConst() << "\" -> " << op.first << std::endl;
-            }
-            for (auto op_dst:op.second->getDst()) {
-                myfile << " " << op.first << " -> " << op_dst->getId() << std::endl;
-            }
-        }
-        myfile << "}" << std::endl;
-        myfile.close();
-    }
-
-    void toJSON(const std::string &fileNamePath) {
-        std::ofstream myfile;
-        myfile.open(fileNamePath);
-        myfile << "[" << endl;
-        
-        char str_node_sub[] = R"({"data":{"id":"%d","op1":"%d","op2":"%d","type":"sub"},"group":"nodes"})";
-        char str_node[] = R"({"data":{"id":"%d","type":"%s"},"group":"nodes"})";
-        char str_edge[] = R"({"data":{"id":"%d","source":"%d","target":"%d"},"group":"edges"})";
-        
-        char buf[256];
-        int numOp = DataFlow<T>::getNumOp();
-        int numEdge = DataFlow<T>::getNumEdges();
-        int cnt = 0;
-        int max_id = 0;
-        int id_edges = 0;
-        for (auto item:DataFlow<T>::op_array) {
-            cnt++;
-            auto op = item.second;
-            if(op->getLabel() == "sub"){
-                 sprintf(buf, str_node_sub, op->getId(),op->getSrcA(),op->getSrcB(), op->getLabel().c_str());
-            }else{
-                sprintf(buf, str_node, op->getId(), op->getLabel().c_str()); 
-            }
-            if (op->getId() > max_id) {
-                max_id = op->getId();
-            }
-            myfile << buf << "," << endl;
-        }
-        id_edges = max_id + 1;
-        cnt = 0;
-        for (auto item:DataFlow<T>::op_array) {
-            auto op = item.second;
-            for (auto neighbor:op->getDst()) {
-                cnt++;
-                sprintf(buf, str_edge, id_edges++, op->getId(), neighbor->getId());
-                if (cnt < numEdge)
-                    myfile << buf << "," << endl;
-                else
-                    myfile << buf << endl;
-            }
-        }
-        myfile << "]";
-        myfile.close();
+    bool toJSON(const std::string &fileNamePath) {
+        return DataFlow<T>::exportJSON(fileNamePath, DataFlow<T>::exportAll());
+    }
+
+    bool toJSON(const std::string &fileNamePath, int minLevel, int maxLevel) {
+        return DataFlow<T>::exportJSON(fileNamePath, DataFlow<T>::exportLevels(minLevel, maxLevel));
+    }
+
+    bool toJSON(const std::string &fileNamePath, const std::vector<int> &ops) {
+        return DataFlow<T>::exportJSON(fileNamePath, DataFlow<T>::exportOps(ops));
     }
 
     void loadFromJSON(const std::string& fileNamePath) {
@@ -204,24 +610,679 @@ public:
     }
 
     void connect(Operator<T> *src, Operator<T> *dst, PORT dstPort) {
+        if (DataFlow<T>::sealed) {
+            return;
+        }
+        TraceScope scope(DataFlow<T>::tracer, "connect", "build", "dst", dst->getId());
+        DataFlow<T>::link(src, dst, dstPort);
+        DataFlow<T>::updateOpLevel();
+    }
 
+    // connect() without re-leveling, for bulk edits that call updateOpLevel() once at the end.
+    void link(Operator<T> *src, Operator<T> *dst, PORT dstPort) {
+        if (DataFlow<T>::sealed) {
+            return;
+        }
         DataFlow<T>::addOperator(src);
         DataFlow<T>::addOperator(dst);
+        DataFlow<T>::invalidateSchedule();
         DataFlow<T>::graph[src->getId()].push_back(dst->getId());
+        DataFlow<T>::num_edges++;
 
         src->getDst().push_back(dst);
+        DataFlow<T>::setPort(src, dst, dstPort);
+    }
 
+    // Removes one src -> dst edge and clears dstPort of dst. Levels are left as they are.
+    void unlink(Operator<T> *src, Operator<T> *dst, PORT dstPort) {
+        if (DataFlow<T>::sealed) {
+            return;
+        }
+        DataFlow<T>::invalidateSchedule();
+        auto &children = DataFlow<T>::graph[src->getId()];
+        auto it = std::find(children.begin(), children.end(), dst->getId());
+        if (it != children.end()) {
+            children.erase(it);
+            DataFlow<T>::num_edges--;
+        }
+        auto &dsts = src->getDst();
+        auto d = std::find(dsts.begin(), dsts.end(), dst);
+        if (d != dsts.end()) {
+            dsts.erase(d);
+        }
         if (dstPort == PORT_A) {
-            dst->setSrcA(src);
+            dst->setSrcA(nullptr);
         } else if (dstPort == PORT_B) {
-            dst->setSrcB(src);
+            dst->setSrcB(nullptr);
         } else if (dstPort == PORT_BRANCH) {
-            dst->setBranchIn(src);
+            dst->setBranchIn(nullptr);
         }
-        DataFlow<T>::updateOpLevel();
+    }
+
+    /*
+     * The dynamic state of every operator (stream cursors, values, end flags and the state of
+     * stateful operators) as a checksummed binary blob. Taken outside compute(), it resumes
+     * where the last restore() left off, or from the start.
+     */
+    std::vector<uint8_t> snapshot() const {
+        return DataFlow<T>::snapshotAt(DataFlow<T>::resume_cycle);
+    }
+
+    /*
+     * Loads a snapshot of this graph (same operator ids, as rebuilt by the same builder) so the
+     * next compute() continues from the cycle it was taken at. Output vectors are cut back to
+     * what was written at that point. Returns false on a corrupt or foreign snapshot; the graph
+     * may then be partly loaded and should be reset().
+     */
+    bool restore(const std::vector<uint8_t> &snapshot) {
+        uint64_t hash;
+        if (snapshot.size() < 20 + sizeof(hash)) {
+            return false;
+        }
+        size_t body = snapshot.size() - sizeof(hash);
+        memcpy(&hash, snapshot.data() + body, sizeof(hash));
+        if (hash != checkpointHash(snapshot.data(), body)) {
+            return false;
+        }
+        StateReader in(snapshot.data(), snapshot.data() + body);
+        uint32_t magic, size, count;
+        uint64_t cycle;
+        if (!in.get(magic) || !in.get(size) || !in.get(count) || !in.get(cycle) || magic != CHECKPOINT_MAGIC ||
+            size != sizeof(T) || count != DataFlow<T>::op_array.size()) {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            int32_t id;
+            uint32_t len;
+            if (!in.get(id) || !in.get(len) || len > in.remaining()) {
+                return false;
+            }
+            auto op = DataFlow<T>::getOp(id);
+            StateReader state(in.position(), in.position() + len);
+            if (!op || !op->loadState(state) || state.remaining() != 0) {
+                return false;
+            }
+            in.skip(len);
+        }
+        DataFlow<T>::resume_cycle = cycle;
+        return true;
+    }
+
+    /*
+     * Calls fn with a snapshot between two cycles of compute(): every `every` cycles (0 for
+     * never) and once after each requestCheckpoint(). The compute thread pauses only to copy
+     * the state; fn can hand the buffer to another thread for writing.
+     */
+    void setCheckpoint(unsigned long every, const std::function<void(std::vector<uint8_t> &)> &fn) {
+        DataFlow<T>::checkpoint_every = every;
+        DataFlow<T>::checkpoint_fn = fn;
+    }
+
+    // Safe to call from any thread while compute() runs.
+    void requestCheckpoint() {
+        DataFlow<T>::checkpoint_requested.store(true);
+    }
+
+    /*
+     * Checks the wiring of every operator and, if it is sound, freezes the topology and builds
+     * the schedule compute() then runs without any port checks. Rejected are: a port the
+     * operator reads that is not connected, a connected port it never reads, an edge whose two
+     * ends disagree or that leaves the graph, and a source that is not at a lower level (the
+     * graph was not leveled after its last edit). Each problem is appended to errors, when given,
+     * as "op <id> (<label>): <problem>". While sealed, link(), connect(), unlink(),
+     * removeOperator(), replicate(), merge(), attachSink(), replaceSink() and both level
+     * updates change nothing (and report failure where they return a value) until unseal().
+     */
+    bool seal(std::vector<std::string> *errors = nullptr) {
+        TraceScope scope(DataFlow<T>::tracer, "seal", "build");
+        const char *const portNames[3] = {"A", "B", "branch"};
+        bool ok = true;
+        auto fail = [&](Operator<T> *op, const std::string &problem) {
+            ok = false;
+            if (errors) {
+                errors->push_back("op " + std::to_string(op->getId()) + " (" + op->getLabel() + "): " + problem);
+            }
+        };
+        for (auto item:DataFlow<T>::op_array) {
+            auto op = item.second;
+            Operator<T> *srcs[3] = {op->getSrcA(), op->getSrcB(), op->getBranchIn()};
+            unsigned ports = op->getPorts();
+            for (int k = 0; k < 3; ++k) {
+                std::string port = std::string("port ") + portNames[k];
+                auto src = srcs[k];
+                if (!src) {
+                    if (ports & (1u << k)) {
+                        fail(op, port + " is not connected");
+                    }
+                    continue;
+                }
+                std::string from = " comes from op " + std::to_string(src->getId());
+                if (!(ports & (1u << k))) {
+                    fail(op, port + " is connected but never read");
+                } else if (DataFlow<T>::getOp(src->getId()) != src) {
+                    fail(op, port + from + ", which is not in this graph");
+                } else if (std::find(src->getDst().begin(), src->getDst().end(), op) == src->getDst().end()) {
+                    fail(op, port + from + ", which does not list it as a destination");
+                } else if (src->getType() != OP_IN && src->getLevel() >= op->getLevel()) {
+                    fail(op, port + from + " at level " + std::to_string(src->getLevel()) + ", not below level " +
+                             std::to_string(op->getLevel()) + " (not leveled since the last edit?)");
+                }
+            }
+            for (auto dst:op->getDst()) {
+                if (dst->getSrcA() != op && dst->getSrcB() != op && dst->getBranchIn() != op) {
+                    fail(op, "feeds op " + std::to_string(dst->getId()) + ", which reads none of its ports from it");
+                } else if (DataFlow<T>::getOp(dst->getId()) != dst) {
+                    fail(op, "feeds op " + std::to_string(dst->getId()) + ", which is not in this graph");
+                }
+            }
+        }
+        if (!ok) {
+            return false;
+        }
+
+        DataFlow<T>::buildSchedule();
+        DataFlow<T>::sealed = true;
+        return true;
+    }
+
+    // Allows edits again; compute() goes back to the checked path.
+    void unseal() {
+        DataFlow<T>::sealed = false;
+        DataFlow<T>::invalidateSchedule();
+    }
+
+    bool isSealed() const {
+        return sealed;
+    }
+
+    /*
+     * Starts recording the values of op_id into probe after each cycle of compute() it fires
+     * in. Neither the graph nor its levels change, and it can be called from any thread while
+     * compute() runs. Returns false for an unknown operator, a probe already attached or when
+     * every probe slot is taken.
+     */
+    bool attachProbe(int op_id, Probe<T> *probe) {
+        auto op = DataFlow<T>::getOp(op_id);
+        if (!op || !probe || probe->getOp()) {
+            return false;
+        }
+        probe->setOp(op);
+        for (auto &slot:DataFlow<T>::probes) {
+            Probe<T> *empty = nullptr;
+            if (slot.compare_exchange_strong(empty, probe)) {
+                DataFlow<T>::num_probes.fetch_add(1);
+                return true;
+            }
+        }
+        probe->setOp(nullptr);
+        return false;
+    }
+
+    /*
+     * Stops recording into probe. When compute() is running on another thread, waits for the
+     * end of the cycle in progress, so the probe can be read one last time and deleted after.
+     */
+    bool detachProbe(Probe<T> *probe) {
+        for (auto &slot:DataFlow<T>::probes) {
+            Probe<T> *p = probe;
+            if (probe && slot.compare_exchange_strong(p, nullptr)) {
+                unsigned long epoch = DataFlow<T>::probe_epoch.load(std::memory_order_acquire);
+                while (DataFlow<T>::computing.load() &&
+                       DataFlow<T>::probe_epoch.load(std::memory_order_acquire) == epoch) {
+                    std::this_thread::yield();
+                }
+                DataFlow<T>::num_probes.fetch_sub(1);
+                probe->setOp(nullptr);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*
+     * Balances the rates of a graph with Downsample/Upsample operators, as in synchronous
+     * dataflow: every operator gets the period, in cycles, at which it fires. Inputs produce one
+     * value per firing; Downsample fires at the rate of its input and Upsample at the rate of its
+     * output, and everything else at the rate of its sources. The cycle is the fastest rate in
+     * the graph, so a region after Downsample(k) fires every k-th cycle. Called by compute() when
+     * the graph changed since its last run; returns false if some operator has sources running at
+     * different rates (its srcA wins).
+     */
+    bool updateRates() {
+        DataFlow<T>::multi_rate = false;
+        DataFlow<T>::rate_inputs.clear();
+        DataFlow<T>::rate_outputs.clear();
+        for (auto item:DataFlow<T>::op_array) {
+            item.second->setPeriod(1);
+            if (item.second->getRateUp() != 1 || item.second->getRateDown() != 1) {
+                DataFlow<T>::multi_rate = true;
+            }
+        }
+        if (!DataFlow<T>::multi_rate) {
+            return true;
+        }
+        std::vector<Operator<T> *> order;
+        for (auto item:DataFlow<T>::op_array) {
+            order.push_back(item.second);
+        }
+        std::stable_sort(order.begin(), order.end(), [](Operator<T> *a, Operator<T> *b) {
+            return a->getLevel() < b->getLevel();
+        });
+        // Output and firing rates as reduced fractions of the input rate.
+        typedef std::pair<long, long> rate_t;
+        std::map<int, rate_t> out, fire;
+        bool consistent = true;
+        long den = 1;
+        for (auto op:order) {
+            rate_t in(1, 1);
+            Operator<T> *srcs[3] = {op->getSrcA(), op->getSrcB(), op->getBranchIn()};
+            bool found = false;
+            for (auto src:srcs) {
+                auto r = src ? out.find(src->getId()) : out.end();
+                if (r == out.end()) {
+                    continue;
+                }
+                if (found && r->second != in) {
+                    consistent = false;
+                } else if (!found) {
+                    in = r->second;
+                    found = true;
+                }
+            }
+            long num = in.first * op->getRateUp(), d = in.second * op->getRateDown();
+            long g = DataFlow<T>::gcd(num, d);
+            out[op->getId()] = rate_t(num / g, d / g);
+            fire[op->getId()] = op->getRateUp() != 1 ? out[op->getId()] : in;
+            den = den / DataFlow<T>::gcd(den, fire[op->getId()].second) * fire[op->getId()].second;
+        }
+        // Scaled to integers, the fastest rate is the lcm of all of them; period = fastest / own rate.
+        long base = 1;
+        for (auto &f:fire) {
+            long m = f.second.first * (den / f.second.second);
+            base = base / DataFlow<T>::gcd(base, m) * m;
+        }
+        for (auto op:order) {
+            auto &f = fire[op->getId()];
+            op->setPeriod((int) (base / (f.first * (den / f.second))));
+            if (op->getType() == OP_IN) {
+                DataFlow<T>::rate_inputs.push_back(op);
+            }
+            if (op->getType() == OP_OUT) {
+                DataFlow<T>::rate_outputs.push_back(op);
+            }
+        }
+        return consistent;
+    }
+
+    /*
+     * Stamps out n copies of the operators in subgraph with fresh ids, wired like the originals
+     * and at the same levels, so nothing is re-leveled. Edges into the subgraph from operators
+     * outside it are shared by every copy; edges leaving it are not copied. The InputStream and
+     * OutputStream operators of copy c, in template id order, are bound to inputs[c * k + i] and
+     * outputs[c * m + i] (k inputs and m outputs per copy; a null array keeps the template's).
+     * Copy c of the j-th template operator in id order gets id first + c * size + j, where first
+     * is the returned id. Returns -1, adding nothing, if an id is unknown or an operator has no clone().
+     */
+    int replicate(const std::vector<int> &subgraph, int n, std::vector<T> *inputs, std::vector<T> *outputs) {
+        TraceScope scope(DataFlow<T>::tracer, "replicate", "build", "copies", n);
+        if (DataFlow<T>::sealed) {
+            return -1;
+        }
+        typedef struct {
+            Operator<T> *ext;
+            int src;
+            int dst;
+            PORT port;
+        } edge_t;
+        std::vector<int> ids(subgraph);
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        std::map<int, int> index;
+        std::vector<Operator<T> *> tmpl;
+        for (auto id:ids) {
+            auto op = DataFlow<T>::getOp(id);
+            if (!op) {
+                return -1;
+            }
+            index[id] = (int) tmpl.size();
+            tmpl.push_back(op);
+        }
+        int first = DataFlow<T>::op_array.empty() ? 0 : DataFlow<T>::op_array.rbegin()->first + 1;
+        if (n <= 0 || tmpl.empty()) {
+            return first;
+        }
+
+        // Internal edges in the order of graph[] (which is also the order of getDst()), then
+        // the edges coming from outside. A pair linked twice (x * x) takes its ports in order.
+        std::vector<edge_t> edges;
+        const PORT ports[3] = {PORT_A, PORT_B, PORT_BRANCH};
+        for (size_t j = 0; j < tmpl.size(); ++j) {
+            std::map<int, int> seen;
+            for (auto child:DataFlow<T>::graph[ids[j]]) {
+                auto d = index.find(child);
+                if (d == index.end()) {
+                    continue;
+                }
+                Operator<T> *dst = tmpl[d->second];
+                Operator<T> *srcs[3] = {dst->getSrcA(), dst->getSrcB(), dst->getBranchIn()};
+                int skip = seen[child]++;
+                for (int k = 0; k < 3; ++k) {
+                    if (srcs[k] == tmpl[j] && skip-- == 0) {
+                        edge_t e = {nullptr, (int) j, d->second, ports[k]};
+                        edges.push_back(e);
+                        break;
+                    }
+                }
+            }
+        }
+        for (size_t j = 0; j < tmpl.size(); ++j) {
+            Operator<T> *srcs[3] = {tmpl[j]->getSrcA(), tmpl[j]->getSrcB(), tmpl[j]->getBranchIn()};
+            for (int k = 0; k < 3; ++k) {
+                if (srcs[k] && !index.count(srcs[k]->getId())) {
+                    edge_t e = {srcs[k], -1, (int) j, ports[k]};
+                    edges.push_back(e);
+                }
+            }
+        }
+
+        std::vector<Operator<T> *> clones(tmpl.size());
+        int nextIn = 0, nextOut = 0;
+        for (int c = 0; c < n; ++c) {
+            for (size_t j = 0; j < tmpl.size(); ++j) {
+                clones[j] = tmpl[j]->clone(first + c * (int) tmpl.size() + (int) j);
+                if (!clones[j]) {
+                    for (size_t i = 0; i < j; ++i) {
+                        delete clones[i];
+                    }
+                    return -1;
+                }
+            }
+            // Fresh ids are above every existing one, so each insert lands at the end of the maps.
+            DataFlow<T>::invalidateSchedule();
+            for (auto op:clones) {
+                op->setDataFlowId(DataFlow<T>::id);
+                DataFlow<T>::op_array.emplace_hint(DataFlow<T>::op_array.end(), op->getId(), op);
+                DataFlow<T>::num_op++;
+                DataFlow<T>::num_op_in += op->getType() == OP_IN ? 1 : 0;
+                DataFlow<T>::num_op_out += op->getType() == OP_OUT ? 1 : 0;
+                auto in = dynamic_cast<InputStream<T> *>(op);
+                if (in && inputs) {
+                    in->setData(inputs[nextIn++]);
+                }
+                auto out = dynamic_cast<OutputStream<T> *>(op);
+                if (out && outputs) {
+                    out->setData(outputs[nextOut++]);
+                }
+            }
+            std::vector<std::vector<int> *> children(tmpl.size(), nullptr);
+            for (auto &e:edges) {
+                Operator<T> *src = e.ext ? e.ext : clones[e.src];
+                Operator<T> *dst = clones[e.dst];
+                if (e.ext) {
+                    DataFlow<T>::graph[src->getId()].push_back(dst->getId());
+                } else {
+                    if (!children[e.src]) {
+                        children[e.src] = &DataFlow<T>::graph.emplace_hint(DataFlow<T>::graph.end(), src->getId(),
+                                                                           std::vector<int>())->second;
+                    }
+                    children[e.src]->push_back(dst->getId());
+                }
+                DataFlow<T>::num_edges++;
+                src->getDst().push_back(dst);
+                if (e.port == PORT_A) {
+                    dst->setSrcA(src);
+                } else if (e.port == PORT_B) {
+                    dst->setSrcB(src);
+                } else {
+                    dst->setBranchIn(src);
+                }
+            }
+        }
+        return first;
+    }
+
+    /*
+     * Moves the operators and edges of builders (filled on any threads beforehand) into this
+     * graph and levels it once with updateOpLevelParallel(). Operator i of builder b gets id
+     * first + offset(b) + i, where offset(b) is the number of operators of the builders before
+     * it and first, the returned id, is above every id in the graph. Builders are wired on up to
+     * `threads` threads and emptied. Returns -1, adding nothing, if an edge names an unknown
+     * builder or operator or an operator already belongs to a graph.
+     */
+    int merge(std::vector<GraphBuilder<T> *> &builders, int threads) {
+        TraceScope scope(DataFlow<T>::tracer, "merge", "build", "builders", (long long) builders.size());
+        if (DataFlow<T>::sealed) {
+            return -1;
+        }
+        int first = DataFlow<T>::op_array.empty() ? 0 : DataFlow<T>::op_array.rbegin()->first + 1;
+        std::vector<int> offset(builders.size() + 1, first);
+        for (size_t b = 0; b < builders.size(); ++b) {
+            offset[b + 1] = offset[b] + builders[b]->size();
+        }
+        for (size_t b = 0; b < builders.size(); ++b) {
+            for (auto op:builders[b]->getOps()) {
+                if (op->getDataFlowId() != -1) {
+                    return -1;
+                }
+            }
+            for (auto &e:builders[b]->getEdges()) {
+                int from = e.srcBuilder < 0 ? (int) b : e.srcBuilder;
+                if (from >= (int) builders.size() || e.src < 0 || e.src >= builders[from]->size() || e.dst < 0 ||
+                    e.dst >= builders[b]->size()) {
+                    return -1;
+                }
+            }
+        }
+
+        // Each builder's own edges only touch its own operators, so builders are wired in parallel.
+        std::vector<std::vector<std::vector<int>>> children(builders.size());
+        DataFlow<T>::parallelFor(builders.size(), threads, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                auto &ops = builders[b]->getOps();
+                children[b].resize(ops.size());
+                for (size_t i = 0; i < ops.size(); ++i) {
+                    ops[i]->setId(offset[b] + (int) i);
+                    ops[i]->setDataFlowId(DataFlow<T>::id);
+                }
+                for (auto &e:builders[b]->getEdges()) {
+                    if (e.srcBuilder < 0) {
+                        ops[e.src]->getDst().push_back(ops[e.dst]);
+                        children[b][e.src].push_back(offset[b] + e.dst);
+                        DataFlow<T>::setPort(ops[e.src], ops[e.dst], e.port);
+                    }
+                }
+            }
+        }, 1);
+
+        // New ids are above every existing one, so each insert lands at the end of the maps.
+        for (size_t b = 0; b < builders.size(); ++b) {
+            auto &ops = builders[b]->getOps();
+            for (size_t i = 0; i < ops.size(); ++i) {
+                DataFlow<T>::op_array.emplace_hint(DataFlow<T>::op_array.end(), ops[i]->getId(), ops[i]);
+                DataFlow<T>::num_op++;
+                DataFlow<T>::num_op_in += ops[i]->getType() == OP_IN ? 1 : 0;
+                DataFlow<T>::num_op_out += ops[i]->getType() == OP_OUT ? 1 : 0;
+                if (!children[b][i].empty()) {
+                    DataFlow<T>::num_edges += (int) children[b][i].size();
+                    DataFlow<T>::graph.emplace_hint(DataFlow<T>::graph.end(), ops[i]->getId(),
+                                                    std::move(children[b][i]));
+                }
+            }
+        }
+        for (size_t b = 0; b < builders.size(); ++b) {
+            for (auto &e:builders[b]->getEdges()) {
+                if (e.srcBuilder >= 0) {
+                    auto src = builders[e.srcBuilder]->getOp(e.src);
+                    auto dst = builders[b]->getOp(e.dst);
+                    DataFlow<T>::graph[src->getId()].push_back(dst->getId());
+                    DataFlow<T>::num_edges++;
+                    src->getDst().push_back(dst);
+                    DataFlow<T>::setPort(src, dst, e.port);
+                }
+            }
+            builders[b]->clear();
+        }
+        DataFlow<T>::updateOpLevelParallel(threads);
+        return first;
+    }
+
+    /*
+     * Same levels as updateOpLevel(), computed by visiting the graph in topological order one
+     * frontier at a time, each frontier split over up to `threads` threads. Every edge is
+     * followed once, where updateOpLevel() follows it once per path from an input.
+     */
+    void updateOpLevelParallel(int threads) {
+        TraceScope scope(DataFlow<T>::tracer, "updateOpLevelParallel", "build", "threads", threads);
+        if (DataFlow<T>::sealed) {
+            return;
+        }
+        DataFlow<T>::invalidateSchedule();
+        std::vector<int> ids;
+        std::vector<Operator<T> *> ops;
+        for (auto item:DataFlow<T>::op_array) {
+            ids.push_back(item.first);
+            ops.push_back(item.second);
+        }
+        size_t n = ops.size();
+        auto indexOf = [&ids](int id) {
+            return (int) (std::lower_bound(ids.begin(), ids.end(), id) - ids.begin());
+        };
+
+        // Children as indices, in compressed rows.
+        std::vector<size_t> row(n + 1, 0);
+        std::vector<const std::vector<int> *> lists(n, nullptr);
+        for (size_t i = 0; i < n; ++i) {
+            auto g = DataFlow<T>::graph.find(ids[i]);
+            if (g != DataFlow<T>::graph.end()) {
+                lists[i] = &g->second;
+            }
+            row[i + 1] = row[i] + (lists[i] ? lists[i]->size() : 0);
+        }
+        std::vector<int> child(row[n]);
+        DataFlow<T>::parallelFor(n, threads, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                for (size_t k = 0; lists[i] && k < lists[i]->size(); ++k) {
+                    child[row[i] + k] = indexOf((*lists[i])[k]);
+                }
+            }
+        });
+
+        // Levels only follow paths from the inputs, so find what they reach first.
+        std::vector<std::atomic<char>> reached(n);
+        std::vector<std::atomic<int>> pending(n);
+        std::vector<std::atomic<int>> level(n);
+        std::vector<int> frontier, all;
+        for (size_t i = 0; i < n; ++i) {
+            reached[i].store(ops[i]->getType() == OP_IN);
+            pending[i].store(0);
+            level[i].store(ops[i]->getLevel());
+            if (ops[i]->getType() == OP_IN) {
+                frontier.push_back((int) i);
+            }
+        }
+        // Visits every child of the frontier, collecting into the next frontier those visit() accepts.
+        auto expand = [&](const std::vector<int> &from, const std::function<bool(int, int)> &visit) {
+            std::vector<int> next;
+            std::mutex lock;
+            DataFlow<T>::parallelFor(from.size(), threads, [&](size_t begin, size_t end) {
+                std::vector<int> local;
+                for (size_t f = begin; f < end; ++f) {
+                    for (size_t k = row[from[f]]; k < row[from[f] + 1]; ++k) {
+                        if (visit(from[f], child[k])) {
+                            local.push_back(child[k]);
+                        }
+                    }
+                }
+                std::lock_guard<std::mutex> guard(lock);
+                next.insert(next.end(), local.begin(), local.end());
+            });
+            return next;
+        };
+        std::vector<int> inputs(frontier);
+        while (!frontier.empty()) {
+            all.insert(all.end(), frontier.begin(), frontier.end());
+            frontier = expand(frontier, [&](int, int c) {
+                return !reached[c].exchange(1);
+            });
+        }
+        DataFlow<T>::parallelFor(all.size(), threads, [&](size_t begin, size_t end) {
+            for (size_t a = begin; a < end; ++a) {
+                for (size_t k = row[all[a]]; k < row[all[a] + 1]; ++k) {
+                    pending[child[k]].fetch_add(1);
+                }
+            }
+        });
+
+        // An operator is final once every edge from a reached parent has been followed.
+        frontier = inputs;
+        while (!frontier.empty()) {
+            frontier = expand(frontier, [&](int p, int c) {
+                int l = level[p].load() + 1, lc = level[c].load();
+                while (lc < l && !level[c].compare_exchange_weak(lc, l)) {
+                }
+                return pending[c].fetch_sub(1) == 1;
+            });
+        }
+        for (size_t i = 0; i < n; ++i) {
+            ops[i]->setLevel(level[i].load());
+        }
+        for (auto i:inputs) {
+            int l = 0;
+            for (size_t k = row[i]; k < row[i + 1]; ++k) {
+                l = std::max(l, level[child[k]].load());
+            }
+            ops[i]->setLevel(l > 0 ? l - 1 : 0);
+        }
+        for (auto op:ops) {
+            DataFlow<T>::max_level = std::max(DataFlow<T>::max_level, op->getLevel());
+        }
+    }
+
+    /*
+     * Adds sink (typically a ReduceSink) as one more consumer of op_id, one level below it,
+     * without re-leveling the rest of the graph. Returns false if op_id is not in the graph.
+     */
+    bool attachSink(int op_id, Operator<T> *sink) {
+        Operator<T> *src = DataFlow<T>::getOp(op_id);
+        if (!src || DataFlow<T>::sealed) {
+            return false;
+        }
+        DataFlow<T>::link(src, sink, PORT_A);
+        sink->setLevel(src->getLevel() + 1);
+        if (sink->getLevel() > DataFlow<T>::max_level) {
+            DataFlow<T>::max_level = sink->getLevel();
+        }
+        return true;
+    }
+
+    /*
+     * Swaps the output operator out_id for sink, at the same level and fed by the same source,
+     * so a builder's unbounded OutputStream can be turned into a bounded reduction. Returns the
+     * removed operator (now owned by the caller), or nullptr if out_id is not a connected output.
+     */
+    Operator<T> *replaceSink(int out_id, Operator<T> *sink) {
+        Operator<T> *out = DataFlow<T>::getOp(out_id);
+        if (!out || out->getType() != OP_OUT || !out->getSrcA() || DataFlow<T>::sealed) {
+            return nullptr;
+        }
+        Operator<T> *src = out->getSrcA();
+        DataFlow<T>::unlink(src, out, PORT_A);
+        DataFlow<T>::op_array.erase(out_id);
+        DataFlow<T>::graph.erase(out_id);
+        DataFlow<T>::num_op--;
+        DataFlow<T>::num_op_out--;
+        out->setDataFlowId(-1);
+        DataFlow<T>::link(src, sink, PORT_A);
+        sink->setLevel(out->getLevel());
+        return out;
     }
 
     void updateOpLevel() {
+        TraceScope scope(DataFlow<T>::tracer, "updateOpLevel", "build");
+        if (DataFlow<T>::sealed) {
+            return;
+        }
+        DataFlow<T>::invalidateSchedule();
         std::queue<int> q;
         int parent;
         for (auto op:DataFlow<T>::op_array) {
@@ -265,6 +1326,97 @@ public:
         return id;
     }
 
+    Tracer *getTracer() const {
+        return tracer;
+    }
+
+    // Tracing is off by default; the tracer is not owned and must outlive every traced call.
+    void setTracer(Tracer *t) {
+        DataFlow<T>::tracer = t;
+    }
+
+    /*
+     * Counts the whole of every compute() call on the given group (not owned). With perLevel,
+     * each level is also read separately, which costs two reads per level per cycle. Only
+     * compute() is measured, on the thread that created the group; NumaExecutor and
+     * DistributedRunner runs are not.
+     */
+    void setPerfCounters(PerfCounterGroup *group, bool perLevel = false) {
+        DataFlow<T>::perf = group;
+        DataFlow<T>::perf_per_level = perLevel;
+    }
+
+    /*
+     * Counters of the last compute() per input token and per operator firing. Firings are
+     * counted with per-level profiling; otherwise they are estimated as cycles x operators,
+     * which overcounts multi-rate graphs and the cycle that finds the inputs at their end.
+     */
+    PerfReport getPerfReport() const {
+        unsigned long firings = DataFlow<T>::num_cycles * DataFlow<T>::num_op;
+        if (DataFlow<T>::perf_per_level) {
+            firings = 0;
+            for (auto f:DataFlow<T>::level_firings) {
+                firings += f;
+            }
+        }
+        PerfReport report(DataFlow<T>::perf, DataFlow<T>::perf_total, DataFlow<T>::num_tokens, firings,
+                          !DataFlow<T>::perf_per_level);
+        for (unsigned long l = 0; l < DataFlow<T>::perf_levels.size() && DataFlow<T>::perf_per_level; ++l) {
+            report.addLevel(DataFlow<T>::perf_levels[l], DataFlow<T>::level_firings[l]);
+        }
+        return report;
+    }
+
+    // Cycles run by the last compute(), including the one that found every input at its end.
+    unsigned long getNumCycles() const {
+        return num_cycles;
+    }
+
+    // Values consumed from input streams by the last compute().
+    unsigned long getNumTokens() const {
+        return num_tokens;
+    }
+
+    /*
+     * Counters of the run in progress or the last one: cycles, values read from inputs and
+     * written by outputs, tokens per second and per-thread utilization. Filled by compute()
+     * and NumaExecutor::run(); any thread can call this while they run, without locking.
+     */
+    runtime_stats_t getRuntimeStats() const {
+        return live.read();
+    }
+
+    LiveStats &getLiveStats() {
+        return live;
+    }
+
+    /*
+     * Bytes held by the graph: operator objects, their values, the edge lists and id maps,
+     * stream buffers and sink state, and the schedules built to run it. Map nodes are counted
+     * as their contents plus four words of tree overhead, and vectors by capacity.
+     */
+    memory_usage_t getMemoryUsage() const {
+        memory_usage_t usage = {0, 0, 0, 0, 0, 0};
+        const size_t node = 4 * sizeof(void *);
+        for (auto item:DataFlow<T>::op_array) {
+            item.second->accountMemory(usage);
+        }
+        usage.edges += DataFlow<T>::op_array.size() * (node + sizeof(std::pair<const int, Operator<T> *>));
+        for (auto &g:DataFlow<T>::graph) {
+            usage.edges += node + sizeof(std::pair<const int, std::vector<int>>) + g.second.capacity() * sizeof(int);
+        }
+        usage.runtime += (DataFlow<T>::schedule_ops.capacity() + DataFlow<T>::schedule_inputs.capacity() +
+                          DataFlow<T>::rate_inputs.capacity() + DataFlow<T>::rate_outputs.capacity()) *
+                         sizeof(Operator<T> *) +
+                         (DataFlow<T>::schedule_level_end.capacity() + DataFlow<T>::schedule_input_end.capacity() +
+                          DataFlow<T>::schedule_run_end.capacity()) * sizeof(size_t) +
+                         DataFlow<T>::schedule_runs.capacity() * sizeof(ScheduleRun) +
+                         DataFlow<T>::perf_levels.capacity() * sizeof(perf_sample_t) +
+                         DataFlow<T>::level_firings.capacity() * sizeof(unsigned long);
+        usage.total = usage.operators + usage.values + usage.edges + usage.streams + usage.runtime;
+        return usage;
+    }
+
     void setId(int df_id) {
         DataFlow<T>::id = df_id;
     }
@@ -273,8 +1425,10 @@ public:
         return DataFlow<T>::max_level;
     }
 
+    // Also the call that tells the graph its operators were re-leveled by hand (see PlanCache).
     void setMaxLevel(int maxLevel) {
         DataFlow<T>::max_level = maxLevel;
+        DataFlow<T>::invalidateSchedule();
     }
 
     const std::string &getName() const {
@@ -298,10 +1452,6 @@ public:
     }
 
     int getNumEdges() const {
-        int num_edges = 0;
-        for (const auto &v:DataFlow<T>::graph) {
-            num_edges += v.second.size();
-        }
         return num_edges;
     }
 };
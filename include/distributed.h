@@ -0,0 +1,606 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <queue>
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+#include <channel.h>
+#include <data_flow.h>
+
+typedef enum {
+    TRANSPORT_SHM,
+    TRANSPORT_TCP
+} transport_t;
+
+template<class T>
+class ChannelSink;
+
+/*
+ * The channel operators of one process. Before it waits on a channel, an operator flushes
+ * the partial batches of every sink in the process, so a peer is never left waiting on
+ * values sitting in a local buffer.
+ */
+template<class T>
+class ChannelGroup {
+private:
+    std::vector<ChannelSink<T> *> sinks;
+    unsigned long spins;
+
+public:
+    ChannelGroup() : spins(0) {}
+
+    void add(ChannelSink<T> *sink) {
+        sinks.push_back(sink);
+    }
+
+    void wait() {
+        for (auto s:sinks) {
+            s->tryFlush();
+        }
+        if (++spins % 64 == 0) {
+            usleep(20);
+        } else {
+            sched_yield();
+        }
+    }
+
+    // Flushes every sink and sends end of stream on each of them.
+    void finish() {
+        for (auto s:sinks) {
+            s->finish();
+        }
+    }
+};
+
+// Sends the value of srcA to another partition, one batch at a time.
+template<class T>
+class ChannelSink : public Operator<T> {
+private:
+    Channel<T> *channel;
+    ChannelGroup<T> *group;
+    std::vector<T> buf;
+
+public:
+    ChannelSink(int id, Channel<T> *channel, ChannelGroup<T> *group) : Operator<T>(id, OP_PASS_A, OP_OUT, "send"),
+                                                                         channel(channel), group(group) {
+        buf.reserve(channel->getBatchSize());
+    }
+
+    void compute() override {
+        if (Operator<T>::getSrcA()) {
+            auto v = Operator<T>::getSrcA()->getVal();
+            Operator<T>::setVal(v);
+            buf.push_back(v);
+            if (buf.size() == channel->getBatchSize()) {
+                while (!ChannelSink::tryFlush() && !channel->isBroken()) {
+                    group->wait();
+                }
+            }
+        }
+    }
+
+    bool tryFlush() {
+        if (buf.empty()) {
+            return true;
+        }
+        if (!channel->trySend(buf.data(), (uint32_t) buf.size())) {
+            return false;
+        }
+        buf.clear();
+        return true;
+    }
+
+    void finish() {
+        while (!ChannelSink::tryFlush() && !channel->isBroken()) {
+            group->wait();
+        }
+        while (!channel->trySendEnd() && !channel->isBroken()) {
+            group->wait();
+        }
+    }
+};
+
+// Input stream fed by a ChannelSink in another partition; ends when that partition ends.
+template<class T>
+class ChannelSource : public Operator<T> {
+private:
+    Channel<T> *channel;
+    ChannelGroup<T> *group;
+    std::vector<T> buf;
+    int pos;
+    int len;
+
+public:
+    ChannelSource(int id, Channel<T> *channel, ChannelGroup<T> *group) : Operator<T>(id, OP_PASS_A, OP_IN, "recv"),
+                                                                           channel(channel), group(group), pos(0),
+                                                                           len(0) {
+        buf.resize(channel->getBatchSize());
+    }
+
+    void compute() override {
+        if (Operator<T>::isEnd()) {
+            return;
+        }
+        if (pos == len) {
+            int n;
+            while ((n = channel->tryRecv(buf.data())) == CHANNEL_EMPTY) {
+                group->wait();
+            }
+            if (n == CHANNEL_END) {
+                Operator<T>::setEnd(true);
+                return;
+            }
+            pos = 0;
+            len = n;
+        }
+        Operator<T>::setVal(buf[pos++]);
+    }
+};
+
+/*
+ * Splits a DataFlow into parts so that the quotient graph between parts is acyclic and
+ * few edges are cut. Weakly connected components (e.g. the `copies` of FIR()) are never
+ * split unless one is much larger than the target part size; small components are packed
+ * onto the least loaded part. A split component is cut into contiguous runs of a DFS
+ * topological order, which keeps chains together, and the run boundaries are then moved
+ * node by node while that lowers the cut and keeps parts within 10% of the target.
+ */
+template<class T>
+class Partitioner {
+private:
+    std::vector<int> ids;
+    std::map<int, int> index;
+    std::vector<std::vector<int>> succ;
+    std::vector<std::vector<int>> pred;
+    std::vector<int> part;
+
+    int find(std::vector<int> &uf, int x) {
+        while (uf[x] != x) {
+            uf[x] = uf[uf[x]];
+            x = uf[x];
+        }
+        return x;
+    }
+
+    // Reverse DFS postorder restricted to nodes: a topological order that visits chains contiguously.
+    std::vector<int> topoOrder(const std::vector<int> &nodes) {
+        std::vector<char> state(ids.size(), 0);
+        std::vector<int> post;
+        std::vector<std::pair<int, size_t>> stack;
+        for (auto root:nodes) {
+            if (!pred[root].empty() || state[root]) {
+                continue;
+            }
+            stack.push_back(std::make_pair(root, (size_t) 0));
+            state[root] = 1;
+            while (!stack.empty()) {
+                auto &top = stack.back();
+                if (top.second < succ[top.first].size()) {
+                    int s = succ[top.first][top.second++];
+                    if (!state[s]) {
+                        state[s] = 1;
+                        stack.push_back(std::make_pair(s, (size_t) 0));
+                    }
+                } else {
+                    post.push_back(top.first);
+                    stack.pop_back();
+                }
+            }
+        }
+        std::reverse(post.begin(), post.end());
+        return post;
+    }
+
+    void split(const std::vector<int> &nodes, int firstPart, int k) {
+        auto order = Partitioner<T>::topoOrder(nodes);
+        std::vector<int> load((unsigned long) k, 0);
+        size_t chunk = (order.size() + k - 1) / k;
+        for (size_t i = 0; i < order.size(); ++i) {
+            part[order[i]] = firstPart + (int) (i / chunk);
+            load[i / chunk]++;
+        }
+        int limit = (int) (chunk + chunk / 10 + 1);
+        for (int pass = 0; pass < 4; ++pass) {
+            bool moved = false;
+            for (auto v:order) {
+                int p = part[v];
+                int minPart = firstPart, maxPart = firstPart + k - 1;
+                int toPrev = 0, toNext = 0, own = 0;
+                for (auto u:pred[v]) {
+                    minPart = std::max(minPart, part[u]);
+                    (part[u] == p ? own : toPrev)++;
+                }
+                for (auto u:succ[v]) {
+                    maxPart = std::min(maxPart, part[u]);
+                    (part[u] == p ? own : toNext)++;
+                }
+                if (minPart == p - 1 && toPrev > own && load[p - 1 - firstPart] < limit) {
+                    part[v] = p - 1;
+                } else if (maxPart == p + 1 && toNext > own && load[p + 1 - firstPart] < limit) {
+                    part[v] = p + 1;
+                } else {
+                    continue;
+                }
+                load[p - firstPart]--;
+                load[part[v] - firstPart]++;
+                moved = true;
+            }
+            if (!moved) {
+                break;
+            }
+        }
+    }
+
+public:
+    // With split false every component stays whole, for executors that cannot carry cut edges.
+    std::map<int, int> partition(const DataFlow<T> &df, int parts, bool split = true) {
+        std::map<int, int> result;
+        ids.clear();
+        index.clear();
+        for (auto item:df.getOpArray()) {
+            index[item.first] = (int) ids.size();
+            ids.push_back(item.first);
+        }
+        int n = (int) ids.size();
+        succ.assign((unsigned long) n, std::vector<int>());
+        pred.assign((unsigned long) n, std::vector<int>());
+        std::vector<int> uf((unsigned long) n);
+        for (int i = 0; i < n; ++i) {
+            uf[i] = i;
+        }
+        for (auto &g:df.getGraph()) {
+            if (!index.count(g.first)) {
+                continue;
+            }
+            int s = index[g.first];
+            for (auto child:g.second) {
+                int d = index[child];
+                succ[s].push_back(d);
+                pred[d].push_back(s);
+                uf[Partitioner<T>::find(uf, s)] = Partitioner<T>::find(uf, d);
+            }
+        }
+        std::map<int, std::vector<int>> comps;
+        for (int i = 0; i < n; ++i) {
+            comps[Partitioner<T>::find(uf, i)].push_back(i);
+        }
+        std::vector<std::vector<int> *> bySize;
+        for (auto &c:comps) {
+            bySize.push_back(&c.second);
+        }
+        std::stable_sort(bySize.begin(), bySize.end(), [](const std::vector<int> *a, const std::vector<int> *b) {
+            return a->size() > b->size();
+        });
+
+        part.assign((unsigned long) n, 0);
+        parts = std::max(1, parts);
+        double target = (double) n / parts;
+        int nextPart = 0;
+        size_t c = 0;
+        // Components worth two or more parts get their own parts.
+        for (; split && c < bySize.size(); ++c) {
+            int k = (int) (bySize[c]->size() / target + 0.5);
+            int reserve = c + 1 < bySize.size() ? 1 : 0;
+            k = std::min(k, parts - nextPart - reserve);
+            if (k < 2) {
+                break;
+            }
+            Partitioner<T>::split(*bySize[c], nextPart, k);
+            nextPart += k;
+        }
+        // The rest are packed whole onto the least loaded of the remaining parts.
+        typedef std::pair<long, int> load_t;
+        std::priority_queue<load_t, std::vector<load_t>, std::greater<load_t>> load;
+        for (int p = std::min(nextPart, parts - 1); p < parts; ++p) {
+            load.push(load_t(0, p));
+        }
+        for (; c < bySize.size(); ++c) {
+            auto l = load.top();
+            load.pop();
+            for (auto v:*bySize[c]) {
+                part[v] = l.second;
+            }
+            load.push(load_t(l.first + (long) bySize[c]->size(), l.second));
+        }
+        for (int i = 0; i < n; ++i) {
+            result[ids[i]] = part[i];
+        }
+        return result;
+    }
+};
+
+/*
+ * Runs a DataFlow split across worker processes. Edges between partitions become
+ * ChannelSink -> ChannelSource pairs over batched channels: shared-memory rings for the
+ * workers run() forks on this host, or TCP (loopback here, or between hosts when each
+ * host rebuilds the same graph and calls runPartition() with its own channel ends).
+ * A worker that finishes flushes its sinks and sends end of stream, which ends the
+ * ChannelSource operators downstream the same way an exhausted InputStream ends.
+ */
+template<class T>
+class DistributedRunner {
+public:
+    typedef struct {
+        int src;
+        int srcPart;
+        int dstPart;
+    } cross_edge_t;
+
+private:
+    DataFlow<T> &df;
+    int workers;
+    transport_t transport;
+    uint32_t batch;
+    uint32_t window;
+    std::map<int, int> part;
+    std::vector<cross_edge_t> cross;
+
+    static bool writeAll(int fd, const void *p, size_t n) {
+        auto c = (const char *) p;
+        while (n) {
+            ssize_t w = write(fd, c, n);
+            if (w < 0 && errno == EINTR) {
+                continue;
+            }
+            if (w <= 0) {
+                return false;
+            }
+            c += w;
+            n -= (size_t) w;
+        }
+        return true;
+    }
+
+    static bool readAll(int fd, void *p, size_t n) {
+        auto c = (char *) p;
+        while (n) {
+            ssize_t r = read(fd, c, n);
+            if (r < 0 && errno == EINTR) {
+                continue;
+            }
+            if (r <= 0) {
+                return false;
+            }
+            c += r;
+            n -= (size_t) r;
+        }
+        return true;
+    }
+
+public:
+    DistributedRunner(DataFlow<T> &df, int workers, transport_t transport = TRANSPORT_SHM, uint32_t batch = 256,
+                      uint32_t window = 8) : df(df), workers(workers < 1 ? 1 : workers), transport(transport),
+                                             batch(batch), window(window) {
+        Partitioner<T> partitioner;
+        part = partitioner.partition(df, DistributedRunner<T>::workers);
+        for (auto item:df.getOpArray()) {
+            std::vector<int> dstParts;
+            for (auto dst:item.second->getDst()) {
+                int p = part[dst->getId()];
+                if (p != part[item.first] && std::find(dstParts.begin(), dstParts.end(), p) == dstParts.end()) {
+                    dstParts.push_back(p);
+                }
+            }
+            std::sort(dstParts.begin(), dstParts.end());
+            for (auto p:dstParts) {
+                cross_edge_t e = {item.first, part[item.first], p};
+                cross.push_back(e);
+            }
+        }
+    }
+
+    const std::map<int, int> &getPartition() const {
+        return part;
+    }
+
+    // One entry per (producer, consumer partition) pair, in producer id order; channel i carries entry i.
+    const std::vector<cross_edge_t> &getCrossEdges() const {
+        return cross;
+    }
+
+    int getCutEdges() const {
+        int cut = 0;
+        for (auto &g:df.getGraph()) {
+            for (auto child:g.second) {
+                cut += part.at(g.first) != part.at(child) ? 1 : 0;
+            }
+        }
+        return cut;
+    }
+
+    /*
+     * Moves the operators of partition p into a new DataFlow whose cross-partition inputs read
+     * rx[i] and whose cross-partition outputs write tx[i]. This rewires the operators in place,
+     * so it is meant for the process that runs p on its own copy of the graph.
+     */
+    DataFlow<T> *extractPartition(int p, const std::vector<Channel<T> *> &tx, const std::vector<Channel<T> *> &rx,
+                                  ChannelGroup<T> &group) {
+        auto sub = new DataFlow<T>(df.getId(), df.getName());
+        std::vector<Operator<T> *> mine;
+        int next = 0;
+        for (auto item:df.getOpArray()) {
+            next = std::max(next, item.first + 1);
+            if (part[item.first] == p) {
+                mine.push_back(item.second);
+            }
+        }
+        std::map<int, Operator<T> *> remote;
+        std::vector<std::pair<Operator<T> *, ChannelSink<T> *>> sinks;
+        for (size_t i = 0; i < cross.size(); ++i) {
+            if (cross[i].dstPart == p) {
+                remote[cross[i].src] = new ChannelSource<T>(next++, rx[i], &group);
+            }
+            if (cross[i].srcPart == p) {
+                auto sink = new ChannelSink<T>(next++, tx[i], &group);
+                group.add(sink);
+                sinks.push_back(std::make_pair(df.getOp(cross[i].src), sink));
+            }
+        }
+        for (auto op:mine) {
+            op->getDst().clear();
+            op->setDataFlowId(-1);
+        }
+        const PORT ports[3] = {PORT_A, PORT_B, PORT_BRANCH};
+        for (auto op:mine) {
+            Operator<T> *srcs[3] = {op->getSrcA(), op->getSrcB(), op->getBranchIn()};
+            for (int k = 0; k < 3; ++k) {
+                if (srcs[k]) {
+                    auto r = remote.find(srcs[k]->getId());
+                    sub->link(r == remote.end() ? srcs[k] : r->second, op, ports[k]);
+                }
+            }
+        }
+        for (auto &s:sinks) {
+            sub->link(s.first, s.second, PORT_A);
+        }
+        sub->updateOpLevel();
+        return sub;
+    }
+
+    // Runs partition p to completion in this process and ends every outgoing channel.
+    DataFlow<T> *runPartition(int p, const std::vector<Channel<T> *> &tx, const std::vector<Channel<T> *> &rx) {
+        ChannelGroup<T> group;
+        auto sub = DistributedRunner<T>::extractPartition(p, tx, rx, group);
+        sub->compute();
+        group.finish();
+        return sub;
+    }
+
+    /*
+     * Forks one worker per partition, runs them to completion and appends what each
+     * partition's OutputStream operators produced to their vectors in this process.
+     * Returns false if a worker failed. The channels of a worker that dies end for its
+     * peers (rings are marked broken, sockets hang up), so the run still returns.
+     */
+    bool run() {
+        size_t nc = cross.size();
+        std::vector<Channel<T> *> tx(nc), rx(nc);
+        for (size_t i = 0; i < nc; ++i) {
+            if (transport == TRANSPORT_SHM) {
+                tx[i] = rx[i] = new ShmChannel<T>(batch, window);
+            } else {
+                int l = tcpListen("127.0.0.1", 0);
+                int c = tcpConnect("127.0.0.1", tcpPort(l));
+                int a = tcpAccept(l);
+                close(l);
+                tx[i] = new TcpChannel<T>(c, true, batch, window);
+                rx[i] = new TcpChannel<T>(a, false, batch, window);
+            }
+        }
+        std::vector<int> used;
+        for (auto &item:part) {
+            if (std::find(used.begin(), used.end(), item.second) == used.end()) {
+                used.push_back(item.second);
+            }
+        }
+        std::cout.flush();
+        std::vector<pid_t> pids;
+        std::vector<int> pipes;
+        for (auto p:used) {
+            int fds[2];
+            if (pipe(fds) != 0) {
+                break;
+            }
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(fds[0]);
+                // Drop the other partitions' ends, so a TCP peer sees this process hang up when it exits.
+                for (size_t i = 0; i < nc; ++i) {
+                    bool src = cross[i].srcPart == p, dst = cross[i].dstPart == p;
+                    if (tx[i] == rx[i]) {
+                        if (!src && !dst) {
+                            delete tx[i];
+                            tx[i] = rx[i] = nullptr;
+                        }
+                        continue;
+                    }
+                    if (!src) {
+                        delete tx[i];
+                        tx[i] = nullptr;
+                    }
+                    if (!dst) {
+                        delete rx[i];
+                        rx[i] = nullptr;
+                    }
+                }
+                auto sub = DistributedRunner<T>::runPartition(p, tx, rx);
+                bool ok = true;
+                for (auto item:sub->getOpArray()) {
+                    auto out = dynamic_cast<OutputStream<T> *>(item.second);
+                    if (out) {
+                        int32_t id = item.first;
+                        uint64_t n = out->getData().size();
+                        ok = ok && writeAll(fds[1], &id, sizeof(id)) && writeAll(fds[1], &n, sizeof(n)) &&
+                             writeAll(fds[1], out->getData().data(), n * sizeof(T));
+                    }
+                }
+                close(fds[1]);
+                _exit(ok ? 0 : 1);
+            }
+            close(fds[1]);
+            if (pid < 0) {
+                close(fds[0]);
+                break;
+            }
+            pids.push_back(pid);
+            pipes.push_back(fds[0]);
+        }
+        bool ok = pids.size() == used.size();
+        if (transport == TRANSPORT_TCP) {
+            for (size_t i = 0; i < nc; ++i) {
+                delete tx[i];
+                delete rx[i];
+                tx[i] = rx[i] = nullptr;
+            }
+        }
+        // A worker that dies breaks its rings, or its peers would wait on them forever.
+        std::vector<int> status(pids.size(), 0);
+        std::vector<std::thread> watchers;
+        for (size_t k = 0; k < pids.size(); ++k) {
+            watchers.emplace_back([&, k]() {
+                waitpid(pids[k], &status[k], 0);
+                if (WIFEXITED(status[k]) && WEXITSTATUS(status[k]) == 0) {
+                    return;
+                }
+                for (size_t i = 0; i < nc; ++i) {
+                    auto shm = dynamic_cast<ShmChannel<T> *>(tx[i]);
+                    if (shm && (cross[i].srcPart == used[k] || cross[i].dstPart == used[k])) {
+                        shm->markBroken();
+                    }
+                }
+            });
+        }
+        for (auto fd:pipes) {
+            int32_t id;
+            uint64_t n;
+            while (readAll(fd, &id, sizeof(id)) && readAll(fd, &n, sizeof(n))) {
+                auto out = dynamic_cast<OutputStream<T> *>(df.getOp(id));
+                std::vector<T> values(n);
+                ok = ok && out && readAll(fd, values.data(), n * sizeof(T));
+                if (out) {
+                    out->getData().insert(out->getData().end(), values.begin(), values.end());
+                }
+            }
+            close(fd);
+        }
+        for (size_t k = 0; k < watchers.size(); ++k) {
+            watchers[k].join();
+            ok = ok && WIFEXITED(status[k]) && WEXITSTATUS(status[k]) == 0;
+        }
+        for (size_t i = 0; i < nc; ++i) {
+            if (rx[i] != tx[i]) {
+                delete rx[i];
+            }
+            delete tx[i];
+        }
+        return ok;
+    }
+};
+
+#endif //DISTRIBUTED_H
@@ -0,0 +1,278 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <immintrin.h>
+#define DATAFLOW_FIXED_X86
+#endif
+
+/*
+ * Signed fixed-point value with F fractional bits stored in the integer type R (Q(bits-1-F).F),
+ * usable as the T of every operator. Add, Sub, Abs, Shl and the multiplies saturate instead of
+ * wrapping; a multiply rounds the double-width product back to F fractional bits. The bitwise
+ * operators and Shr work on the raw bits. An int converts to its integer value, so the 1 of
+ * Beq/Sgt/... is 1.0 (the largest value when F leaves no integer bit); a double must be
+ * converted explicitly. With F = 0 this is a saturating integer.
+ */
+template<int F, class R = int16_t>
+class Fixed {
+    static_assert(std::is_integral<R>::value && std::is_signed<R>::value && sizeof(R) <= 4,
+                  "Fixed needs a signed integer of up to 32 bits");
+    static_assert(F >= 0 && F < (int) sizeof(R) * 8, "F must leave the sign bit");
+
+public:
+    typedef R raw_t;
+    typedef typename std::conditional<sizeof(R) < 4, int32_t, int64_t>::type wide_t;
+    static const int FRAC = F;
+
+private:
+    R raw;
+
+    static R saturate(int64_t v) {
+        return v > std::numeric_limits<R>::max() ? std::numeric_limits<R>::max() :
+               v < std::numeric_limits<R>::min() ? std::numeric_limits<R>::min() : (R) v;
+    }
+
+public:
+    Fixed() : raw(0) {}
+
+    Fixed(int v) : raw(saturate((int64_t) v * ((int64_t) 1 << F))) {}
+
+    explicit Fixed(double v) {
+        double scaled = v * (double) ((int64_t) 1 << F);
+        scaled += scaled < 0 ? -0.5 : 0.5;
+        raw = scaled >= (double) std::numeric_limits<R>::max() ? std::numeric_limits<R>::max() :
+              scaled <= (double) std::numeric_limits<R>::min() ? std::numeric_limits<R>::min() : (R) scaled;
+    }
+
+    static Fixed fromRaw(R r) {
+        Fixed f;
+        f.raw = r;
+        return f;
+    }
+
+    R getRaw() const {
+        return raw;
+    }
+
+    explicit operator double() const {
+        return (double) raw / (double) ((int64_t) 1 << F);
+    }
+
+    explicit operator bool() const {
+        return raw != 0;
+    }
+
+    // The integer part, rounded towards minus infinity.
+    int toInt() const {
+        return (int) (raw >> F);
+    }
+
+    friend Fixed operator+(Fixed a, Fixed b) {
+        return fromRaw(saturate((int64_t) a.raw + b.raw));
+    }
+
+    friend Fixed operator-(Fixed a, Fixed b) {
+        return fromRaw(saturate((int64_t) a.raw - b.raw));
+    }
+
+    friend Fixed operator*(Fixed a, Fixed b) {
+        wide_t p = (wide_t) a.raw * b.raw;
+        return fromRaw(saturate(F ? (p + ((wide_t) 1 << (F ? F - 1 : 0))) >> F : p));
+    }
+
+    friend Fixed operator&(Fixed a, Fixed b) {
+        return fromRaw((R) (a.raw & b.raw));
+    }
+
+    friend Fixed operator|(Fixed a, Fixed b) {
+        return fromRaw((R) (a.raw | b.raw));
+    }
+
+    friend Fixed operator^(Fixed a, Fixed b) {
+        return fromRaw((R) (a.raw ^ b.raw));
+    }
+
+    friend Fixed operator~(Fixed a) {
+        return fromRaw((R) ~a.raw);
+    }
+
+    // Shifts by whole bits; a shift count given as a Fixed uses its integer part.
+    friend Fixed operator<<(Fixed a, int s) {
+        if (s <= 0 || a.raw == 0) {
+            return s < 0 ? a >> -s : a;
+        }
+        if (s >= (int) sizeof(R) * 8) {
+            return fromRaw(a.raw > 0 ? std::numeric_limits<R>::max() : std::numeric_limits<R>::min());
+        }
+        return fromRaw(saturate((int64_t) a.raw * ((int64_t) 1 << s)));
+    }
+
+    friend Fixed operator>>(Fixed a, int s) {
+        if (s <= 0) {
+            return s < 0 ? a << -s : a;
+        }
+        return fromRaw(s >= (int) sizeof(R) * 8 ? (R) (a.raw < 0 ? -1 : 0) : (R) (a.raw >> s));
+    }
+
+    friend Fixed operator<<(Fixed a, Fixed s) {
+        return a << s.toInt();
+    }
+
+    friend Fixed operator>>(Fixed a, Fixed s) {
+        return a >> s.toInt();
+    }
+
+    friend bool operator==(Fixed a, Fixed b) {
+        return a.raw == b.raw;
+    }
+
+    friend bool operator!=(Fixed a, Fixed b) {
+        return a.raw != b.raw;
+    }
+
+    friend bool operator<(Fixed a, Fixed b) {
+        return a.raw < b.raw;
+    }
+
+    friend bool operator>(Fixed a, Fixed b) {
+        return a.raw > b.raw;
+    }
+
+    friend bool operator<=(Fixed a, Fixed b) {
+        return a.raw <= b.raw;
+    }
+
+    friend bool operator>=(Fixed a, Fixed b) {
+        return a.raw >= b.raw;
+    }
+
+    // |min| does not fit and saturates to max.
+    friend Fixed abs(Fixed a) {
+        return fromRaw(saturate(a.raw < 0 ? -(int64_t) a.raw : (int64_t) a.raw));
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, Fixed a) {
+        return os << (double) a;
+    }
+};
+
+typedef Fixed<7, int8_t> q7_t;
+typedef Fixed<15, int16_t> q15_t;
+typedef Fixed<31, int32_t> q31_t;
+typedef Fixed<0, int8_t> sat8_t;
+typedef Fixed<0, int16_t> sat16_t;
+typedef Fixed<0, int32_t> sat32_t;
+
+namespace std {
+template<int F, class R>
+class numeric_limits<Fixed<F, R>> {
+public:
+    static const bool is_specialized = true;
+    static const bool is_signed = true;
+    static const bool is_integer = F == 0;
+    static const bool is_exact = true;
+    static const int digits = numeric_limits<R>::digits;
+
+    static Fixed<F, R> min() {
+        return Fixed<F, R>::fromRaw(numeric_limits<R>::min());
+    }
+
+    static Fixed<F, R> max() {
+        return Fixed<F, R>::fromRaw(numeric_limits<R>::max());
+    }
+
+    static Fixed<F, R> lowest() {
+        return Fixed<F, R>::fromRaw(numeric_limits<R>::min());
+    }
+
+    static Fixed<F, R> epsilon() {
+        return Fixed<F, R>::fromRaw(1);
+    }
+};
+}
+
+/*
+ * Block kernels over n values at a time, with the same results as the scalar operators:
+ * out = a + b, out = a * b and out = a * c. For 16-bit values on x86 they run 8 lanes at a
+ * time with paddsw and, for Q15 multiplies on CPUs with SSSE3, pmulhrsw; anything else runs
+ * the scalar loop.
+ */
+template<int F, class R>
+void addSat(const Fixed<F, R> *a, const Fixed<F, R> *b, Fixed<F, R> *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = a[i] + b[i];
+    }
+}
+
+template<int F, class R>
+void mulFixed(const Fixed<F, R> *a, const Fixed<F, R> *b, Fixed<F, R> *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = a[i] * b[i];
+    }
+}
+
+template<int F, class R>
+void mulFixedConst(const Fixed<F, R> *a, Fixed<F, R> c, Fixed<F, R> *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = a[i] * c;
+    }
+}
+
+#ifdef DATAFLOW_FIXED_X86
+
+template<int F>
+void addSat(const Fixed<F, int16_t> *a, const Fixed<F, int16_t> *b, Fixed<F, int16_t> *out, size_t n) {
+    size_t tail = n - n % 8;
+    for (size_t i = 0; i < tail; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *) (b + i));
+        _mm_storeu_si128((__m128i *) (out + i), _mm_adds_epi16(x, y));
+    }
+    for (size_t j = tail; j < n; ++j) {
+        out[j] = a[j] + b[j];
+    }
+}
+
+inline bool fixedHasSsse3() {
+    static const bool has = __builtin_cpu_supports("ssse3");
+    return has;
+}
+
+// pmulhrsw is (a * b + 2^14) >> 15, which only overflows for -1 * -1; that lane is saturated.
+__attribute__((target("ssse3")))
+inline size_t mulQ15Ssse3(const int16_t *a, const int16_t *b, int16_t c, int16_t *out, size_t n) {
+    const __m128i min = _mm_set1_epi16(INT16_MIN);
+    const __m128i k = _mm_set1_epi16(c);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i y = b ? _mm_loadu_si128((const __m128i *) (b + i)) : k;
+        __m128i p = _mm_mulhrs_epi16(x, y);
+        _mm_storeu_si128((__m128i *) (out + i), _mm_xor_si128(p, _mm_cmpeq_epi16(p, min)));
+    }
+    return i;
+}
+
+inline void mulFixed(const q15_t *a, const q15_t *b, q15_t *out, size_t n) {
+    size_t i = fixedHasSsse3() ? mulQ15Ssse3((const int16_t *) a, (const int16_t *) b, 0, (int16_t *) out, n) : 0;
+    for (; i < n; ++i) {
+        out[i] = a[i] * b[i];
+    }
+}
+
+inline void mulFixedConst(const q15_t *a, q15_t c, q15_t *out, size_t n) {
+    size_t i = fixedHasSsse3() ? mulQ15Ssse3((const int16_t *) a, nullptr, c.getRaw(), (int16_t *) out, n) : 0;
+    for (; i < n; ++i) {
+        out[i] = a[i] * c;
+    }
+}
+
+#endif
+
+#endif //FIXED_POINT_H
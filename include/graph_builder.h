@@ -0,0 +1,70 @@
+#ifndef GRAPH_BUILDER_H
+#define GRAPH_BUILDER_H
+
+#include <vector>
+#include <defs.h>
+#include <operator.h>
+
+// An edge recorded by a GraphBuilder: src of builder srcBuilder (-1 for the same builder) into port of dst.
+typedef struct {
+    int srcBuilder;
+    int src;
+    int dst;
+    PORT port;
+} builder_edge_t;
+
+/*
+ * Part of a DataFlow built on its own thread. A builder only records its operators and edges
+ * in local vectors, so any number of them can be filled concurrently, one per thread, and
+ * combined afterwards with DataFlow::merge(). Operators are referred to by the index add()
+ * returns; the ids they were constructed with are replaced by the merge. An edge from an
+ * operator of another builder names that builder by its position in the list given to merge().
+ */
+template<class T>
+class GraphBuilder {
+private:
+    std::vector<Operator<T> *> ops;
+    std::vector<builder_edge_t> edges;
+
+public:
+    // Takes op (not yet in any graph) and returns its index in this builder.
+    int add(Operator<T> *op) {
+        GraphBuilder<T>::ops.push_back(op);
+        return (int) GraphBuilder<T>::ops.size() - 1;
+    }
+
+    void link(int src, int dst, PORT dstPort) {
+        builder_edge_t e = {-1, src, dst, dstPort};
+        GraphBuilder<T>::edges.push_back(e);
+    }
+
+    // Edge from operator src of builder srcBuilder into dst of this one.
+    void linkFrom(int srcBuilder, int src, int dst, PORT dstPort) {
+        builder_edge_t e = {srcBuilder, src, dst, dstPort};
+        GraphBuilder<T>::edges.push_back(e);
+    }
+
+    Operator<T> *getOp(int index) const {
+        return GraphBuilder<T>::ops[index];
+    }
+
+    const std::vector<Operator<T> *> &getOps() const {
+        return ops;
+    }
+
+    const std::vector<builder_edge_t> &getEdges() const {
+        return edges;
+    }
+
+    int size() const {
+        return (int) ops.size();
+    }
+
+    // Forgets every operator and edge, e.g. once they have been merged into a graph.
+    void clear() {
+        GraphBuilder<T>::ops.clear();
+        GraphBuilder<T>::edges.clear();
+    }
+};
+
+#endif //GRAPH_BUILDER_H
@@ -0,0 +1,304 @@
+#ifndef NATIVE_KERNEL_H
+#define NATIVE_KERNEL_H
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <checkpoint.h>
+#include <codegen.h>
+#include <data_flow.h>
+
+/*
+ * Runs a graph as native code generated by emitCpp(). load() looks in the cache
+ * directory for a kernel built from the same source: the file name is a hash of the generated
+ * source, the compiler, what its --version prints and the flags, so any change to the graph,
+ * its levels, its constants, T or the toolchain gets a kernel of its own. On a miss it writes
+ * the source there, compiles it into a shared object (the compiler is run without a shell,
+ * with the flags split at whitespace, and its output goes to a .log next to it) and renames
+ * the object into place, so processes sharing a directory never load a partial file. Then
+ * it dlopens the object.
+ *
+ * compute() runs the graph like DataFlow::compute(): the kernel reads the InputStream
+ * vectors and appends to the OutputStream vectors the operators point at, and the operators
+ * get their values, input cursors and end flags back afterwards. Probes, tracing,
+ * checkpoints and live stats are not served by the kernel.
+ */
+template<class T>
+class NativeKernel {
+private:
+    typedef unsigned long (*kernel_fn)(T *, const std::vector<T> *const *, unsigned long *, unsigned char *,
+                                       std::vector<T> *const *, unsigned long);
+
+    std::string dir;
+    std::string compiler;
+    std::string flags;
+    std::string version;
+    void *handle;
+    kernel_fn fn;
+    std::vector<Operator<T> *> ops;
+    std::vector<InputStream<T> *> inputs;
+    std::vector<OutputStream<T> *> outputs;
+    std::string path;
+    std::string error;
+    bool cached;
+    unsigned long num_cycles;
+
+    bool fail(const std::string &e) {
+        NativeKernel<T>::unload();
+        NativeKernel<T>::error = e;
+        return false;
+    }
+
+    static bool exists(const std::string &file) {
+        FILE *f = fopen(file.c_str(), "rb");
+        if (f) {
+            fclose(f);
+        }
+        return f != nullptr;
+    }
+
+    /*
+     * Runs args[0] from the PATH with args as its arguments and waits for it; its output and
+     * errors go to fd, or into captured when that is given. True if it exited with status 0.
+     */
+    static bool execute(const std::vector<std::string> &args, int fd, std::string *captured = nullptr) {
+        std::vector<char *> argv;
+        for (auto &a:args) {
+            argv.push_back(const_cast<char *>(a.c_str()));
+        }
+        argv.push_back(nullptr);
+        int pipeFds[2] = {-1, -1};
+        if (captured && pipe(pipeFds) != 0) {
+            return false;
+        }
+        int out = captured ? pipeFds[1] : fd;
+        pid_t pid = fork();
+        if (pid == 0) {
+            if (captured) {
+                close(pipeFds[0]);
+            }
+            dup2(out, 1);
+            dup2(out, 2);
+            execvp(argv[0], argv.data());
+            _exit(127);
+        }
+        if (captured) {
+            close(pipeFds[1]);
+            char buf[256];
+            ssize_t r;
+            while (pid > 0 && ((r = read(pipeFds[0], buf, sizeof(buf))) > 0 || (r < 0 && errno == EINTR))) {
+                captured->append(buf, r > 0 ? (size_t) r : 0);
+            }
+            close(pipeFds[0]);
+        }
+        int status = 0;
+        if (pid < 0 || waitpid(pid, &status, 0) != pid) {
+            return false;
+        }
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    void unload() {
+        if (NativeKernel<T>::handle) {
+            dlclose(NativeKernel<T>::handle);
+        }
+        NativeKernel<T>::handle = nullptr;
+        NativeKernel<T>::fn = nullptr;
+        NativeKernel<T>::ops.clear();
+        NativeKernel<T>::inputs.clear();
+        NativeKernel<T>::outputs.clear();
+    }
+
+public:
+    explicit NativeKernel(const std::string &cacheDir = ".", const std::string &cxx = "c++",
+                          const std::string &cxxFlags = "-O2") : dir(cacheDir), compiler(cxx), flags(cxxFlags),
+                                                                 handle(nullptr), fn(nullptr), cached(false),
+                                                                 num_cycles(0) {}
+
+    NativeKernel(const NativeKernel &) = delete;
+
+    NativeKernel &operator=(const NativeKernel &) = delete;
+
+    ~NativeKernel() {
+        NativeKernel<T>::unload();
+    }
+
+    // Builds or finds the kernel of df and binds it to df's operators. On failure getError() says why.
+    bool load(DataFlow<T> &df) {
+        NativeKernel<T>::unload();
+        NativeKernel<T>::error.clear();
+        std::string source;
+        if (!generateCpp(df, source)) {
+            return NativeKernel<T>::fail("the graph has an operator or a type emitCpp() does not support");
+        }
+        std::vector<std::string> args(1, NativeKernel<T>::compiler);
+        std::istringstream split(NativeKernel<T>::flags);
+        for (std::string flag; split >> flag;) {
+            args.push_back(flag);
+        }
+        args.push_back("-std=c++11");
+        args.push_back("-shared");
+        args.push_back("-fPIC");
+        if (NativeKernel<T>::version.empty() &&
+            !NativeKernel<T>::execute({NativeKernel<T>::compiler, "--version"}, -1, &(NativeKernel<T>::version))) {
+            NativeKernel<T>::version.clear();
+            return NativeKernel<T>::fail("cannot run " + NativeKernel<T>::compiler + " --version");
+        }
+        std::string keyed = source + "\n" + NativeKernel<T>::version;
+        for (auto &a:args) {
+            keyed += "\n" + a;
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "dataflow_%016llx",
+                 (unsigned long long) checkpointHash((const uint8_t *) keyed.data(), keyed.size()));
+        std::string base = NativeKernel<T>::dir + "/" + name;
+        NativeKernel<T>::path = base + ".so";
+        NativeKernel<T>::cached = NativeKernel<T>::exists(NativeKernel<T>::path);
+        if (!NativeKernel<T>::cached) {
+            if (!writeFileAtomic(base + ".cpp", std::vector<uint8_t>(source.begin(), source.end()))) {
+                return NativeKernel<T>::fail("cannot write " + base + ".cpp");
+            }
+            std::string tmp = base + "." + std::to_string((long) getpid()) + ".tmp";
+            int log = open((base + ".log").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (log < 0) {
+                return NativeKernel<T>::fail("cannot write " + base + ".log");
+            }
+            args.push_back("-o");
+            args.push_back(tmp);
+            args.push_back(base + ".cpp");
+            bool built = NativeKernel<T>::execute(args, log);
+            close(log);
+            if (!built) {
+                remove(tmp.c_str());
+                return NativeKernel<T>::fail("compiling " + base + ".cpp failed, see " + base + ".log");
+            }
+            if (rename(tmp.c_str(), NativeKernel<T>::path.c_str()) != 0) {
+                remove(tmp.c_str());
+                return NativeKernel<T>::fail("cannot move the kernel to " + NativeKernel<T>::path);
+            }
+        }
+        NativeKernel<T>::handle = dlopen(NativeKernel<T>::path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!NativeKernel<T>::handle) {
+            const char *e = dlerror();
+            return NativeKernel<T>::fail(e ? e : "dlopen failed");
+        }
+
+        auto abi = (const unsigned *) dlsym(NativeKernel<T>::handle, "dataflow_kernel_abi");
+        auto counts = (const unsigned long *) dlsym(NativeKernel<T>::handle, "dataflow_kernel_counts");
+        auto opIds = (const int *) dlsym(NativeKernel<T>::handle, "dataflow_kernel_ops");
+        auto inIds = (const int *) dlsym(NativeKernel<T>::handle, "dataflow_kernel_inputs");
+        auto outIds = (const int *) dlsym(NativeKernel<T>::handle, "dataflow_kernel_outputs");
+        NativeKernel<T>::fn = (kernel_fn) dlsym(NativeKernel<T>::handle, "dataflow_kernel");
+        if (!abi || !counts || !opIds || !inIds || !outIds || !NativeKernel<T>::fn ||
+            *abi != (NATIVE_KERNEL_ABI << 16 | (unsigned) sizeof(T))) {
+            return NativeKernel<T>::fail(NativeKernel<T>::path + " is not a kernel of this version and type");
+        }
+        for (unsigned long i = 0; i < counts[0]; ++i) {
+            auto op = df.getOp(opIds[i]);
+            if (!op) {
+                return NativeKernel<T>::fail("the kernel has an operator the graph does not");
+            }
+            NativeKernel<T>::ops.push_back(op);
+        }
+        for (unsigned long i = 0; i < counts[1]; ++i) {
+            auto in = dynamic_cast<InputStream<T> *>(df.getOp(inIds[i]));
+            if (!in) {
+                return NativeKernel<T>::fail("kernel input " + std::to_string(inIds[i]) + " is not an InputStream");
+            }
+            NativeKernel<T>::inputs.push_back(in);
+        }
+        for (unsigned long i = 0; i < counts[2]; ++i) {
+            auto out = dynamic_cast<OutputStream<T> *>(df.getOp(outIds[i]));
+            if (!out) {
+                return NativeKernel<T>::fail("kernel output " + std::to_string(outIds[i]) + " is not an OutputStream");
+            }
+            NativeKernel<T>::outputs.push_back(out);
+        }
+        return true;
+    }
+
+    bool isLoaded() const {
+        return fn != nullptr;
+    }
+
+    // Whether the last load() found the kernel already built.
+    bool isCached() const {
+        return cached;
+    }
+
+    const std::string &getPath() const {
+        return path;
+    }
+
+    const std::string &getError() const {
+        return error;
+    }
+
+    /*
+     * Runs at most maxCycles cycles from where the operators are and returns true once every
+     * input is at its end, so a caller can run the graph in blocks and do other work between them.
+     */
+    bool compute(unsigned long maxCycles) {
+        if (!NativeKernel<T>::fn) {
+            return true;
+        }
+        auto &ops = NativeKernel<T>::ops;
+        std::vector<T> values(ops.size());
+        for (size_t i = 0; i < ops.size(); ++i) {
+            values[i] = ops[i]->getVal();
+        }
+        std::vector<const std::vector<T> *> in;
+        std::vector<unsigned long> pos;
+        std::vector<unsigned char> end;
+        for (auto i:NativeKernel<T>::inputs) {
+            in.push_back(&i->getData());
+            pos.push_back(i->getIndex());
+            end.push_back(i->isEnd() ? 1 : 0);
+        }
+        std::vector<std::vector<T> *> out;
+        for (auto o:NativeKernel<T>::outputs) {
+            out.push_back(&o->getData());
+        }
+        NativeKernel<T>::num_cycles += NativeKernel<T>::fn(values.data(), in.data(), pos.data(), end.data(),
+                                                           out.data(), maxCycles);
+
+        for (size_t i = 0; i < ops.size(); ++i) {
+            ops[i]->setVal(values[i]);
+        }
+        bool done = true;
+        for (size_t i = 0; i < NativeKernel<T>::inputs.size(); ++i) {
+            NativeKernel<T>::inputs[i]->setIndex(pos[i]);
+            NativeKernel<T>::inputs[i]->setEnd(end[i] != 0);
+            done = done && end[i];
+        }
+        if (done) {
+            for (auto op:ops) {
+                op->flush();
+            }
+        }
+        return done;
+    }
+
+    // Runs until every input is at its end, like DataFlow::compute().
+    void compute() {
+        NativeKernel<T>::num_cycles = 0;
+        while (!NativeKernel<T>::compute(ULONG_MAX)) {
+        }
+    }
+
+    // Cycles run by the last compute(), and by compute(maxCycles) calls since.
+    unsigned long getNumCycles() const {
+        return num_cycles;
+    }
+};
+
+#endif //NATIVE_KERNEL_H
@@ -0,0 +1,381 @@
+#ifndef NUMA_PLACEMENT_H
+#define NUMA_PLACEMENT_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <data_flow.h>
+#include <distributed.h>
+
+/*
+ * NUMA nodes and their CPUs, read from /sys/devices/system/node. Without that directory
+ * (or on a single-socket box) this is one node holding every online CPU.
+ */
+class NumaTopology {
+private:
+    std::vector<std::vector<int>> cpus;
+
+    static std::vector<int> parseCpuList(const char *s) {
+        std::vector<int> list;
+        while (*s) {
+            char *end;
+            long a = strtol(s, &end, 10);
+            if (end == s) {
+                break;
+            }
+            long b = a;
+            s = end;
+            if (*s == '-') {
+                b = strtol(s + 1, &end, 10);
+                s = end;
+            }
+            for (long c = a; c <= b; ++c) {
+                list.push_back((int) c);
+            }
+            while (*s == ',' || *s == '\n') {
+                s++;
+            }
+        }
+        return list;
+    }
+
+public:
+    NumaTopology() {
+        for (int node = 0;; ++node) {
+            std::string path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+            FILE *f = fopen(path.c_str(), "r");
+            if (!f) {
+                break;
+            }
+            char line[4096] = {0};
+            if (fgets(line, sizeof(line), f)) {
+                cpus.push_back(NumaTopology::parseCpuList(line));
+            }
+            fclose(f);
+        }
+        if (cpus.empty()) {
+            long n = sysconf(_SC_NPROCESSORS_ONLN);
+            cpus.push_back(std::vector<int>());
+            for (int c = 0; c < (n < 1 ? 1 : n); ++c) {
+                cpus[0].push_back(c);
+            }
+        }
+    }
+
+    int getNumNodes() const {
+        return (int) cpus.size();
+    }
+
+    const std::vector<int> &getCpus(int node) const {
+        return cpus[node];
+    }
+};
+
+/*
+ * Moves the pages holding the given addresses to node (pages already there stay put) and
+ * fills status with the node of each page afterwards, or a negative errno. With node < 0
+ * nothing moves and status only reports where the pages are. Returns false when the
+ * kernel has no move_pages().
+ */
+inline bool numaMovePages(std::vector<void *> &pages, int node, std::vector<int> &status) {
+    status.assign(pages.size(), -1);
+#ifdef SYS_move_pages
+    if (pages.empty()) {
+        return true;
+    }
+    std::vector<int> nodes(pages.size(), node);
+    return syscall(SYS_move_pages, 0, (unsigned long) pages.size(), pages.data(),
+                   node < 0 ? nullptr : nodes.data(), status.data(), 2 /* MPOL_MF_MOVE */) >= 0;
+#else
+    return false;
+#endif
+}
+
+// Page-aligned addresses of every page overlapping [p, p + bytes), appended to pages.
+inline void numaPagesOf(const void *p, size_t bytes, std::vector<void *> &pages) {
+    if (!p || !bytes) {
+        return;
+    }
+    uintptr_t size = (uintptr_t) sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t) p & ~(size - 1);
+    uintptr_t last = ((uintptr_t) p + bytes - 1) & ~(size - 1);
+    for (uintptr_t a = first; a <= last; a += size) {
+        pages.push_back((void *) a);
+    }
+}
+
+typedef struct {
+    unsigned long local;
+    unsigned long remote;
+    unsigned long unknown;
+    unsigned long shared;   // pages holding data of more than one part, counted once and not in the others
+} numa_locality_t;
+
+/*
+ * Runs a DataFlow on one thread per part, each part a set of whole weakly connected
+ * components (e.g. the `copies` of FIR()), so no values cross threads. Parts are assigned
+ * to NUMA nodes round-robin and, in NUMA-aware mode, each worker is pinned to a CPU of its
+ * node and the part's operators and input buffers are moved to that node before the run.
+ * Output vectors grow on the pinned worker, so first touch puts their new pages there too.
+ * Operators are allocated by whoever built the graph, so the objects of different parts can
+ * share a heap page; such pages stay where they are and are reported as shared.
+ * Each part stops when its own inputs end, like a partition of DistributedRunner.
+ * Multi-rate graphs fire each operator at the period set by DataFlow::updateRates().
+ */
+template<class T>
+class NumaExecutor {
+private:
+    DataFlow<T> &df;
+    int workers;
+    bool numaAware;
+    NumaTopology topology;
+    std::map<int, int> part;
+    std::vector<std::vector<std::vector<Operator<T> *>>> levels;
+    std::vector<int> numIn;
+    std::vector<std::vector<Operator<T> *>> ins;
+    std::vector<std::vector<Operator<T> *>> outs;
+    numa_locality_t locality;
+    double seconds;
+
+    int workerCpu(int p) const {
+        auto &cpus = topology.getCpus(NumaExecutor<T>::getNode(p));
+        return cpus[(p / topology.getNumNodes()) % cpus.size()];
+    }
+
+    // Bytes of the operator object itself, derived members included (see Operator::accountMemory()).
+    static size_t objectSize(const Operator<T> *op) {
+        memory_usage_t usage = {0, 0, 0, 0, 0, 0};
+        op->accountMemory(usage);
+        return usage.operators + usage.values;
+    }
+
+    std::vector<void *> pagesOf(int p) const {
+        std::vector<void *> pages;
+        for (auto &level:levels[p]) {
+            for (auto op:level) {
+                numaPagesOf(op, NumaExecutor<T>::objectSize(op), pages);
+                auto in = dynamic_cast<InputStream<T> *>(op);
+                if (in) {
+                    numaPagesOf(in->getData().data(), in->getData().size() * sizeof(T), pages);
+                }
+                auto out = dynamic_cast<OutputStream<T> *>(op);
+                if (out) {
+                    numaPagesOf(out->getData().data(), out->getData().size() * sizeof(T), pages);
+                }
+            }
+        }
+        std::sort(pages.begin(), pages.end());
+        pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+        return pages;
+    }
+
+    // Pages of every part, each split into the pages only that part touches and, once, the shared ones.
+    void splitPages(std::vector<std::vector<void *>> &own, std::vector<void *> &shared) const {
+        std::map<void *, int> owner;
+        own.assign((unsigned long) workers, std::vector<void *>());
+        shared.clear();
+        for (int p = 0; p < workers; ++p) {
+            for (auto page:NumaExecutor<T>::pagesOf(p)) {
+                auto it = owner.insert(std::make_pair(page, p)).first;
+                if (it->second != p) {
+                    it->second = -1;
+                }
+            }
+        }
+        for (auto &item:owner) {
+            if (item.second < 0) {
+                shared.push_back(item.first);
+            } else {
+                own[item.second].push_back(item.first);
+            }
+        }
+    }
+
+    void runPart(int p) {
+        if (numaAware) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(NumaExecutor<T>::workerCpu(p), &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+        auto &lv = levels[p];
+        auto &live = df.getLiveStats();
+        unsigned long long tokensIn = 0, tokensOut = 0;
+        int allIsEnd = -1;
+        for (unsigned long cycle = 0; allIsEnd != numIn[p]; ++cycle) {
+            allIsEnd = 0;
+            for (auto &level:lv) {
+                int period = 1;
+                bool fires = true;
+                for (auto op:level) {
+                    if (op->getPeriod() != period) {
+                        period = op->getPeriod();
+                        fires = cycle % period == 0;
+                    }
+                    if (fires) {
+                        op->compute();
+                    }
+                    if (op->getType() == OP_IN && op->isEnd()) {
+                        allIsEnd++;
+                    }
+                }
+                if (allIsEnd == numIn[p]) {
+                    break;
+                }
+            }
+            for (auto in:ins[p]) {
+                tokensIn += cycle % in->getPeriod() == 0 && !in->isEnd() ? 1 : 0;
+            }
+            for (auto out:outs[p]) {
+                tokensOut += allIsEnd != numIn[p] && cycle % out->getPeriod() == 0 ? 1 : 0;
+            }
+            live.publish(p, cycle + 1, tokensIn, tokensOut);
+        }
+        live.finish(p);
+        for (auto &level:lv) {
+            for (auto op:level) {
+                op->flush();
+            }
+        }
+    }
+
+public:
+    // At most LiveStats::MAX_THREADS workers, one live-stats slot each; more are clamped.
+    NumaExecutor(DataFlow<T> &df, int workers, bool numaAware = true) : df(df), workers(workers < 1 ? 1 : workers),
+                                                                        numaAware(numaAware), seconds(0) {
+        if (NumaExecutor<T>::workers > LiveStats::MAX_THREADS) {
+            NumaExecutor<T>::workers = LiveStats::MAX_THREADS;
+        }
+        Partitioner<T> partitioner;
+        part = partitioner.partition(df, NumaExecutor<T>::workers, false);
+        df.updateRates();
+        levels.assign((unsigned long) NumaExecutor<T>::workers,
+                      std::vector<std::vector<Operator<T> *>>((unsigned long) df.getMaxLevel() + 1));
+        numIn.assign((unsigned long) NumaExecutor<T>::workers, 0);
+        ins.resize((unsigned long) NumaExecutor<T>::workers);
+        outs.resize((unsigned long) NumaExecutor<T>::workers);
+        for (auto item:df.getOpArray()) {
+            int p = part[item.first];
+            levels[p][item.second->getLevel()].push_back(item.second);
+            numIn[p] += item.second->getType() == OP_IN ? 1 : 0;
+            if (item.second->getType() == OP_IN) {
+                ins[p].push_back(item.second);
+            }
+            if (item.second->getType() == OP_OUT) {
+                outs[p].push_back(item.second);
+            }
+        }
+        // Operators of a level do not depend on each other; grouping them by period lets runPart()
+        // test the cycle once per group.
+        for (auto &lv:levels) {
+            for (auto &level:lv) {
+                std::stable_sort(level.begin(), level.end(), [](Operator<T> *a, Operator<T> *b) {
+                    return a->getPeriod() < b->getPeriod();
+                });
+            }
+        }
+        locality.local = locality.remote = locality.unknown = locality.shared = 0;
+    }
+
+    int getNumWorkers() const {
+        return workers;
+    }
+
+    const std::map<int, int> &getPartition() const {
+        return part;
+    }
+
+    const NumaTopology &getTopology() const {
+        return topology;
+    }
+
+    int getNode(int p) const {
+        return p % topology.getNumNodes();
+    }
+
+    /*
+     * Moves every part's operators and input buffers to its node; called by run() in NUMA-aware
+     * mode. Pages shared with another part are left where they are.
+     */
+    void place() {
+        std::vector<std::vector<void *>> own;
+        std::vector<void *> shared;
+        std::vector<int> status;
+        NumaExecutor<T>::splitPages(own, shared);
+        for (int p = 0; p < workers; ++p) {
+            numaMovePages(own[p], NumaExecutor<T>::getNode(p), status);
+        }
+    }
+
+    void run() {
+        if (numaAware) {
+            NumaExecutor<T>::place();
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        // One live-stats slot per part; parts without inputs have nothing to run and finish at once.
+        df.getLiveStats().begin(workers);
+        std::vector<std::thread> threads;
+        for (int p = 0; p < workers; ++p) {
+            if (numIn[p] > 0) {
+                threads.push_back(std::thread(&NumaExecutor<T>::runPart, this, p));
+            } else {
+                df.getLiveStats().finish(p);
+            }
+        }
+        for (auto &t:threads) {
+            t.join();
+        }
+        df.getLiveStats().end();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        NumaExecutor<T>::measureLocality();
+    }
+
+    /*
+     * Counts the pages of each part's operators and stream buffers that sit on the node of
+     * the part (local) or elsewhere (remote). A page the kernel cannot report is unknown, and
+     * a page holding data of several parts is shared, whatever its node.
+     */
+    numa_locality_t measureLocality() {
+        std::vector<std::vector<void *>> own;
+        std::vector<void *> shared;
+        std::vector<int> status;
+        NumaExecutor<T>::splitPages(own, shared);
+        locality.local = locality.remote = locality.unknown = 0;
+        locality.shared = shared.size();
+        for (int p = 0; p < workers; ++p) {
+            auto &pages = own[p];
+            numaMovePages(pages, -1, status);
+            for (auto s:status) {
+                if (s < 0) {
+                    locality.unknown++;
+                } else if (s == NumaExecutor<T>::getNode(p)) {
+                    locality.local++;
+                } else {
+                    locality.remote++;
+                }
+            }
+        }
+        return locality;
+    }
+
+    numa_locality_t getLocality() const {
+        return locality;
+    }
+
+    // Wall time of the last run(), without placement.
+    double getSeconds() const {
+        return seconds;
+    }
+};
+
+#endif //NUMA_PLACEMENT_H
@@ -2,8 +2,12 @@
 #define OPERATOR_H
 
 #include <cmath>
+#include <cstdlib>
+#include <type_traits>
 #include <vector>
 #include <defs.h>
+#include <checkpoint.h>
+#include <stats.h>
 
 template<class T>
 class Operator {
@@ -21,18 +25,20 @@ private:
     std::vector<Operator<T> *> dst;
     std::string name;
     bool end;
+    int period;
 public:
     Operator<T>(int id, int op_code, int type, std::string name) : id(id), opCode(op_code), type(type), srcA(nullptr),
                                                                    srcB(nullptr), branchIn(nullptr), level(0),
-                                                                   dataFlowId(-1), name(std::move(name)),end(false) {}
+                                                                   dataFlowId(-1), name(std::move(name)),end(false), period(1) {}
 
     Operator<T>(int id, int op_code, int type, std::string name, T constant) : id(id), opCode(op_code), type(type),
                                                                                srcA(nullptr), srcB(nullptr),
                                                                                branchIn(nullptr), _const(constant),
                                                                                level(0), dataFlowId(-1),
-                                                                               name(std::move(name)),end(false) {}
+                                                                               name(std::move(name)),end(false),
+                                                                               period(1) {}
 
-    ~ Operator<T>() {
+    virtual ~ Operator<T>() {
         srcA = nullptr;
         srcB = nullptr;
         branchIn = nullptr;
@@ -118,6 +124,47 @@ public:
 
     virtual void compute() = 0;
 
+    // compute() without the port checks, for sealed graphs where every port in getPorts() is connected.
+    virtual void computeSealed() {
+        compute();
+    }
+
+    // The ports compute() reads, as a mask of 1 << PORT_A, 1 << PORT_B and 1 << PORT_BRANCH.
+    virtual unsigned getPorts() const {
+        return type == OP_IN ? 0 : 1u << PORT_A;
+    }
+
+    // Called once when compute() of the graph ends, for operators that buffer output.
+    virtual void flush() {}
+
+    // Back to the state right after construction; wiring and level are kept.
+    virtual void reset() {
+        val = T();
+        end = false;
+    }
+
+    // Dynamic state for DataFlow::snapshot(); operators that keep more than val and end extend both.
+    virtual void saveState(StateWriter &out) const {
+        out.put(val);
+        out.put(end);
+    }
+
+    virtual bool loadState(StateReader &in) {
+        return in.get(val) && in.get(end);
+    }
+
+    // Adds the bytes this operator holds to usage; operators with more state or buffers extend it.
+    virtual void accountMemory(memory_usage_t &usage) const {
+        usage.operators += sizeof(Operator<T>) - 2 * sizeof(T);
+        usage.values += 2 * sizeof(T);
+        usage.edges += dst.capacity() * sizeof(Operator<T> *);
+    }
+
+    // Unconnected copy with a new id and the same level, or nullptr if the operator cannot be copied.
+    virtual Operator<T> *clone(int) const {
+        return nullptr;
+    }
+
     void setLevel(int l) {
         level = l;
     }
@@ -126,6 +173,24 @@ public:
         return level;
     }
 
+    // Fires on the cycles that are a multiple of the period; set by DataFlow::updateRates().
+    int getPeriod() const {
+        return period;
+    }
+
+    void setPeriod(int p) {
+        period = p;
+    }
+
+    // Output rate = input rate * getRateUp() / getRateDown(); only Downsample and Upsample change it.
+    virtual int getRateUp() const {
+        return 1;
+    }
+
+    virtual int getRateDown() const {
+        return 1;
+    }
+
     void setDataFlowId(int id) {
         dataFlowId = id;
     }
@@ -138,6 +203,19 @@ public:
         return name;
     }
 
+protected:
+    // Finishes a clone() made with the copy constructor: drops the wiring and the run state.
+    static Operator<T> *detach(Operator<T> *op, int newId) {
+        op->id = newId;
+        op->dataFlowId = -1;
+        op->srcA = nullptr;
+        op->srcB = nullptr;
+        op->branchIn = nullptr;
+        op->dst.clear();
+        op->reset();
+        return op;
+    }
+
 };
 typedef enum {
     OP_PASS_A = 0,
@@ -161,21 +239,48 @@ typedef enum {
     OP_ABS = 18
 } op_opcode_t;
 
+// |v| for any T: unsigned values as they are, otherwise std::abs or an abs() found by ADL (Fixed),
+// never the C int abs() an unqualified call binds to for floating point when std's is not visible.
+template<class T>
+T absoluteValue(T v, std::true_type) {
+    return v;
+}
+
+template<class T>
+T absoluteValue(T v, std::false_type) {
+    using std::abs;
+    return (T) abs(v);
+}
+
+template<class T>
+T absoluteValue(T v) {
+    return absoluteValue(v, std::is_unsigned<T>());
+}
+
 template<class T>
 class Abs : public Operator<T> {
 public:
 
     explicit Abs(int id) : Operator<T>(id, OP_ABS, OP_BASIC, "abs") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Abs<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            auto v = abs(Operator<T>::getSrcA()->getVal());
+            auto v = absoluteValue(Operator<T>::getSrcA()->getVal());
             Operator<T>::setVal(v);
         } else if (Operator<T>::getSrcB()) {
-            auto v = abs(Operator<T>::getSrcB()->getVal());
+            auto v = absoluteValue(Operator<T>::getSrcB()->getVal());
             Operator<T>::setVal(v);
         }
     }
+
+    // Reads port B only when port A is not connected.
+    unsigned getPorts() const override {
+        return Operator<T>::getSrcB() && !Operator<T>::getSrcA() ? 1u << PORT_B : 1u << PORT_A;
+    }
 };
 
 template<class T>
@@ -183,12 +288,24 @@ class Add : public Operator<T> {
 public:
     explicit Add(int id) : Operator<T>(id, OP_ADD, OP_BASIC, "add") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Add<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            auto v = Operator<T>::getSrcA()->getVal() + Operator<T>::getSrcB()->getVal();
-            Operator<T>::setVal(v);
+            Add<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() + Operator<T>::getSrcB()->getVal();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -196,12 +313,24 @@ class Addi : public Operator<T> {
 public:
     Addi(int id, T constant) : Operator<T>(id, OP_ADD, OP_IMMEDIATE, "addi", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Addi<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            auto v = Operator<T>::getSrcA()->getVal() + Operator<T>::getConst();
-            Operator<T>::setVal(v);
+            Addi<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() + Operator<T>::getConst();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
 };
 
 template<class T>
@@ -209,12 +338,24 @@ class And : public Operator<T> {
 public:
     explicit And(int id) : Operator<T>(id, OP_AND, OP_BASIC, "and") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new And<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            auto v = Operator<T>::getSrcA()->getVal() & Operator<T>::getSrcB()->getVal();
-            Operator<T>::setVal(v);
+            And<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() & Operator<T>::getSrcB()->getVal();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -222,12 +363,24 @@ class Andi : public Operator<T> {
 public:
     Andi(int id, T constant) : Operator<T>(id, OP_AND, OP_IMMEDIATE, "andi", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Andi<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            auto v = Operator<T>::getSrcA()->getVal() & Operator<T>::getConst();
-            Operator<T>::setVal(v);
+            Andi<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() & Operator<T>::getConst();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
 };
 
 template<class T>
@@ -235,12 +388,24 @@ class Beq : public Operator<T> {
 public:
     explicit Beq(int id) : Operator<T>(id, OP_BEQ, OP_BASIC, "beq") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Beq<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            auto v = Operator<T>::getSrcA()->getVal() == Operator<T>::getSrcB()->getVal() ? 1 : 0;
-            Operator<T>::setVal(v);
+            Beq<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() == Operator<T>::getSrcB()->getVal() ? 1 : 0;
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -248,12 +413,24 @@ class Beqi : public Operator<T> {
 public:
     Beqi(int id, T constant) : Operator<T>(id, OP_BEQ, OP_IMMEDIATE, "beqi", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Beqi<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            auto v = Operator<T>::getSrcA()->getVal() == Operator<T>::getConst() ? 1 : 0;
-            Operator<T>::setVal(v);
+            Beqi<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() == Operator<T>::getConst() ? 1 : 0;
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
 };
 
 template<class T>
@@ -261,12 +438,24 @@ class Bne : public Operator<T> {
 public:
     explicit Bne(int id) : Operator<T>(id, OP_BNE, OP_BASIC, "bne") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Bne<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            auto v = Operator<T>::getSrcA()->getVal() != Operator<T>::getSrcB()->getVal() ? 1 : 0;
-            Operator<T>::setVal(v);
+            Bne<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() != Operator<T>::getSrcB()->getVal() ? 1 : 0;
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -274,32 +463,129 @@ class Bnei : public Operator<T> {
 public:
     Bnei(int id, T constant) : Operator<T>(id, OP_BNE, OP_IMMEDIATE, "bnei", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Bnei<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            auto v = Operator<T>::getSrcA()->getVal() != Operator<T>::getConst() ? 1 : 0;
-            Operator<T>::setVal(v);
+            Bnei<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() != Operator<T>::getConst() ? 1 : 0;
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
+};
+
+// Passes every k-th value of srcA (the first, the k+1-th, ...) and holds it in between.
+template<class T>
+class Downsample : public Operator<T> {
+private:
+    int k;
+    int count;
+
+public:
+    Downsample(int id, int k) : Operator<T>(id, OP_PASS_A, OP_BASIC, "down"), k(k < 1 ? 1 : k), count(0) {}
+
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Downsample<T>(*this), newId);
+    }
+
+    void compute() override {
+        if (Operator<T>::getSrcA() && count == 0) {
+            Operator<T>::setVal(Operator<T>::getSrcA()->getVal());
+        }
+        count = count + 1 == k ? 0 : count + 1;
+    }
+
+    void reset() override {
+        Operator<T>::reset();
+        count = 0;
+    }
+
+    void saveState(StateWriter &out) const override {
+        Operator<T>::saveState(out);
+        out.put(count);
+    }
+
+    bool loadState(StateReader &in) override {
+        return Operator<T>::loadState(in) && in.get(count);
+    }
+
+    int getRateDown() const override {
+        return k;
+    }
+
+    void accountMemory(memory_usage_t &usage) const override {
+        Operator<T>::accountMemory(usage);
+        usage.operators += sizeof(Downsample<T>) - sizeof(Operator<T>);
+    }
 };
 
 template<class T>
 class InputStream : public Operator<T> {
 private:
-    int index;
-    std::vector<T> &data;
+    unsigned long index;
+    std::vector<T> *data;
 
 public:
     explicit InputStream(int id, std::vector<T> &data) : Operator<T>(id, OP_PASS_A, OP_IN, "input"), index(0),
-                                                         data(data){}
+                                                         data(&data){}
+
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new InputStream<T>(*this), newId);
+    }
 
     void compute() override {
-        if (InputStream::index < data.size()) {
-            auto v = InputStream::data[InputStream::index++];
+        if (InputStream::index < data->size()) {
+            auto v = (*InputStream::data)[InputStream::index++];
             Operator<T>::setVal(v);
         } else {
             Operator<T>::setEnd(true);
         }
     }
+
+    void reset() override {
+        Operator<T>::reset();
+        InputStream::index = 0;
+    }
+
+    void saveState(StateWriter &out) const override {
+        Operator<T>::saveState(out);
+        out.put(index);
+    }
+
+    bool loadState(StateReader &in) override {
+        return Operator<T>::loadState(in) && in.get(index);
+    }
+
+    std::vector<T> &getData() const {
+        return *data;
+    }
+
+    void setData(std::vector<T> &d) {
+        InputStream::data = &d;
+    }
+
+    unsigned long getIndex() const {
+        return index;
+    }
+
+    void setIndex(unsigned long i) {
+        InputStream::index = i;
+    }
+
+    void accountMemory(memory_usage_t &usage) const override {
+        Operator<T>::accountMemory(usage);
+        usage.operators += sizeof(InputStream<T>) - sizeof(Operator<T>);
+        usage.streams += data->capacity() * sizeof(T);
+    }
 };
 
 template<class T>
@@ -307,17 +593,29 @@ class Max : public Operator<T> {
 public:
     explicit Max(int id) : Operator<T>(id, OP_MAX, OP_BASIC, "max") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Max<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            if (Operator<T>::getSrcA()->getVal() > Operator<T>::getSrcB()->getVal()) {
-                auto v = Operator<T>::getSrcA()->getVal();
-                Operator<T>::setVal(v);
-            } else {
-                auto v = Operator<T>::getSrcB()->getVal();
-                Operator<T>::setVal(v);
-            }
+            Max<T>::computeSealed();
+        }
+    }
+
+    void computeSealed() override {
+        if (Operator<T>::getSrcA()->getVal() > Operator<T>::getSrcB()->getVal()) {
+            auto v = Operator<T>::getSrcA()->getVal();
+            Operator<T>::setVal(v);
+        } else {
+            auto v = Operator<T>::getSrcB()->getVal();
+            Operator<T>::setVal(v);
         }
     }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -325,17 +623,29 @@ class Maxi : public Operator<T> {
 public:
     Maxi(int id, T constant) : Operator<T>(id, OP_MAX, OP_IMMEDIATE, "maxi", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Maxi<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            if (Operator<T>::getSrcA()->getVal() > Operator<T>::getConst()) {
-                auto v = Operator<T>::getSrcA()->getVal();
-                Operator<T>::setVal(v);
-            } else {
-                auto v = Operator<T>::getConst();
-                Operator<T>::setVal(v);
-            }
+            Maxi<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        if (Operator<T>::getSrcA()->getVal() > Operator<T>::getConst()) {
+            auto v = Operator<T>::getSrcA()->getVal();
+            Operator<T>::setVal(v);
+        } else {
+            auto v = Operator<T>::getConst();
+            Operator<T>::setVal(v);
+        }
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
 };
 
 template<class T>
@@ -343,17 +653,29 @@ class Min : public Operator<T> {
 public:
     explicit Min(int id) : Operator<T>(id, OP_MIN, OP_BASIC, "min") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Min<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            if (Operator<T>::getSrcA()->getVal() < Operator<T>::getSrcB()->getVal()) {
-                auto v = Operator<T>::getSrcA()->getVal();
-                Operator<T>::setVal(v);
-            } else {
-                auto v = Operator<T>::getSrcB()->getVal();
-                Operator<T>::setVal(v);
-            }
+            Min<T>::computeSealed();
+        }
+    }
+
+    void computeSealed() override {
+        if (Operator<T>::getSrcA()->getVal() < Operator<T>::getSrcB()->getVal()) {
+            auto v = Operator<T>::getSrcA()->getVal();
+            Operator<T>::setVal(v);
+        } else {
+            auto v = Operator<T>::getSrcB()->getVal();
+            Operator<T>::setVal(v);
         }
     }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -361,17 +683,29 @@ class Mini : public Operator<T> {
 public:
     Mini(int id, T constant) : Operator<T>(id, OP_MIN, OP_IMMEDIATE, "mini", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Mini<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            if (Operator<T>::getSrcA()->getVal() < Operator<T>::getConst()) {
-                auto v = Operator<T>::getSrcA()->getVal();
-                Operator<T>::setVal(v);
-            } else {
-                auto v = Operator<T>::getConst();
-                Operator<T>::setVal(v);
-            }
+            Mini<T>::computeSealed();
+        }
+    }
+
+    void computeSealed() override {
+        if (Operator<T>::getSrcA()->getVal() < Operator<T>::getConst()) {
+            auto v = Operator<T>::getSrcA()->getVal();
+            Operator<T>::setVal(v);
+        } else {
+            auto v = Operator<T>::getConst();
+            Operator<T>::setVal(v);
         }
     }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
 };
 
 template<class T>
@@ -379,12 +713,24 @@ class Mult : public Operator<T> {
 public:
     explicit Mult(int id) : Operator<T>(id, OP_MULT, OP_BASIC, "mult") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Mult<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            auto v = Operator<T>::getSrcA()->getVal() * Operator<T>::getSrcB()->getVal();
-            Operator<T>::setVal(v);
+            Mult<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() * Operator<T>::getSrcB()->getVal();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -392,12 +738,24 @@ class Multi : public Operator<T> {
 public:
     Multi(int id, T constant) : Operator<T>(id, OP_MULT, OP_IMMEDIATE, "multi", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Multi<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            auto v = Operator<T>::getSrcA()->getVal() * Operator<T>::getConst();
-            Operator<T>::setVal(v);
+            Multi<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() * Operator<T>::getConst();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
 };
 
 template<class T>
@@ -405,13 +763,25 @@ class Mux : public Operator<T> {
 public:
     explicit Mux(int id) : Operator<T>(id, OP_MUX, OP_BASIC, "mux") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Mux<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB() && Operator<T>::getBranchIn()) {
-            auto v = Operator<T>::getBranchIn()->getVal() ? Operator<T>::getSrcA()->getVal()
-                                                          : Operator<T>::getSrcB()->getVal();
-            Operator<T>::setVal(v);
+            Mux<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getBranchIn()->getVal() ? Operator<T>::getSrcA()->getVal()
+                                                      : Operator<T>::getSrcB()->getVal();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B | 1u << PORT_BRANCH;
+    }
 };
 
 template<class T>
@@ -419,12 +789,24 @@ class Muxi : public Operator<T> {
 public:
     Muxi(int id, T constant) : Operator<T>(id, OP_MUX, OP_IMMEDIATE, "muxi", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Muxi<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getBranchIn()) {
-            auto v = Operator<T>::getBranchIn()->getVal() ? Operator<T>::getSrcA()->getVal() : Operator<T>::getConst();
-            Operator<T>::setVal(v);
+            Muxi<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getBranchIn()->getVal() ? Operator<T>::getSrcA()->getVal() : Operator<T>::getConst();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_BRANCH;
+    }
 };
 
 template<class T>
@@ -432,12 +814,24 @@ class Not : public Operator<T> {
 public:
     explicit Not(int id) : Operator<T>(id, OP_NOT, OP_BASIC, "not") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Not<T>(*this), newId);
+    }
+
     void compute() override {
-        if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            auto v = ~Operator<T>::getSrcA()->getVal();
-            Operator<T>::setVal(v);
+        if (Operator<T>::getSrcA()) {
+            Not<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = ~Operator<T>::getSrcA()->getVal();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
 };
 
 template<class T>
@@ -445,12 +839,24 @@ class Or : public Operator<T> {
 public:
     explicit Or(int id) : Operator<T>(id, OP_OR, OP_BASIC, "or") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Or<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            auto v = Operator<T>::getSrcA()->getVal() | Operator<T>::getSrcB()->getVal();
-            Operator<T>::setVal(v);
+            Or<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() | Operator<T>::getSrcB()->getVal();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -458,31 +864,78 @@ class Ori : public Operator<T> {
 public:
     explicit Ori(int id, int constant) : Operator<T>(id, OP_OR, OP_IMMEDIATE, "ori", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Ori<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            auto v = Operator<T>::getSrcA()->getVal() | Operator<T>::getConst();
-            Operator<T>::setVal(v);
+            Ori<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() | Operator<T>::getConst();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
 };
 
 template<class T>
 class OutputStream : public Operator<T> {
 private:
-    int index;
-    std::vector<T> &data;
+    std::vector<T> *data;
 
 public:
-    explicit OutputStream(int id, std::vector<T> &data) : Operator<T>(id, OP_PASS_A, OP_OUT, "output"), index(0),
-                                                          data(data) {}
+    explicit OutputStream(int id, std::vector<T> &data) : Operator<T>(id, OP_PASS_A, OP_OUT, "output"),
+                                                          data(&data) {}
+
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new OutputStream<T>(*this), newId);
+    }
 
     void compute() override {
         if (Operator<T>::getSrcA()) {
             auto v = Operator<T>::getSrcA()->getVal();
             Operator<T>::setVal(v);
-            OutputStream::data.push_back(v);
+            OutputStream::data->push_back(v);
+        }
+
+    }
+
+    // Only the number of values written is saved; values written after the snapshot are dropped on load.
+    void saveState(StateWriter &out) const override {
+        Operator<T>::saveState(out);
+        out.put((uint64_t) data->size());
+    }
+
+    bool loadState(StateReader &in) override {
+        uint64_t n;
+        if (!Operator<T>::loadState(in) || !in.get(n)) {
+            return false;
         }
+        if (data->size() > n) {
+            data->resize(n);
+        }
+        return true;
+    }
 
+    std::vector<T> &getData() const {
+        return *data;
+    }
+
+    // Values already pushed to the previous vector stay there.
+    void setData(std::vector<T> &d) {
+        OutputStream::data = &d;
+    }
+
+    void accountMemory(memory_usage_t &usage) const override {
+        Operator<T>::accountMemory(usage);
+        usage.operators += sizeof(OutputStream<T>) - sizeof(Operator<T>);
+        usage.streams += data->capacity() * sizeof(T);
     }
 };
 
@@ -491,12 +944,24 @@ class PassA : public Operator<T> {
 public:
     explicit PassA(int id) : Operator<T>(id, OP_PASS_A, OP_BASIC, "reg") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new PassA<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            auto v = Operator<T>::getSrcA()->getVal();
-            Operator<T>::setVal(v);
+            PassA<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
 };
 
 template<class T>
@@ -504,12 +969,24 @@ class PassB : public Operator<T> {
 public:
     explicit PassB(int id) : Operator<T>(id, OP_PASS_B, OP_BASIC, "reg") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new PassB<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcB()) {
-            auto v = Operator<T>::getSrcB()->getVal();
-            Operator<T>::setVal(v);
+            PassB<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcB()->getVal();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -517,10 +994,18 @@ class PassBi : public Operator<T> {
 public:
     explicit PassBi(int id, T constant) : Operator<T>(id, OP_PASS_B, OP_IMMEDIATE, "reg", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new PassBi<T>(*this), newId);
+    }
+
     void compute() override {
         auto v = Operator<T>::getConst();
         Operator<T>::setVal(v);
     }
+
+    unsigned getPorts() const override {
+        return 0;
+    }
 };
 
 template<class T>
@@ -528,12 +1013,24 @@ class Sgt : public Operator<T> {
 public:
     explicit Sgt(int id) : Operator<T>(id, OP_SGT, OP_BASIC, "sgt") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Sgt<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            auto v = Operator<T>::getSrcA()->getVal() > Operator<T>::getSrcB()->getVal() ? 1 : 0;
-            Operator<T>::setVal(v);
+            Sgt<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() > Operator<T>::getSrcB()->getVal() ? 1 : 0;
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -541,12 +1038,24 @@ class Sgti : public Operator<T> {
 public:
     explicit Sgti(int id, T constant) : Operator<T>(id, OP_SGT, OP_IMMEDIATE, "sgti", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Sgti<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            auto v = Operator<T>::getSrcA()->getVal() > Operator<T>::getConst() ? 1 : 0;
-            Operator<T>::setVal(v);
+            Sgti<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() > Operator<T>::getConst() ? 1 : 0;
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
 };
 
 template<class T>
@@ -554,12 +1063,24 @@ class Shl : public Operator<T> {
 public:
     explicit Shl(int id) : Operator<T>(id, OP_SHL, OP_BASIC, "shl") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Shl<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            auto v = Operator<T>::getSrcA()->getVal() << Operator<T>::getSrcB()->getVal();
-            Operator<T>::setVal(v);
+            Shl<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() << Operator<T>::getSrcB()->getVal();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -567,12 +1088,24 @@ class Shli : public Operator<T> {
 public:
     explicit Shli(int id, T constant) : Operator<T>(id, OP_SHL, OP_IMMEDIATE, "shli", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Shli<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            auto v = Operator<T>::getSrcA()->getVal() << Operator<T>::getConst();
-            Operator<T>::setVal(v);
+            Shli<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() << Operator<T>::getConst();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
 };
 
 template<class T>
@@ -580,12 +1113,24 @@ class Shr : public Operator<T> {
 public:
     explicit Shr(int id) : Operator<T>(id, OP_SHR, OP_BASIC, "shr") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Shr<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            auto v = Operator<T>::getSrcA()->getVal() >> Operator<T>::getSrcB()->getVal();
-            Operator<T>::setVal(v);
+            Shr<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() >> Operator<T>::getSrcB()->getVal();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -593,12 +1138,24 @@ class Shri : public Operator<T> {
 public:
     explicit Shri(int id, T constant) : Operator<T>(id, OP_SHR, OP_IMMEDIATE, "shri", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Shri<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            auto v = Operator<T>::getSrcA()->getVal() >> Operator<T>::getConst();
-            Operator<T>::setVal(v);
+            Shri<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() >> Operator<T>::getConst();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
 };
 
 template<class T>
@@ -606,12 +1163,24 @@ class Slt : public Operator<T> {
 public:
     explicit Slt(int id) : Operator<T>(id, OP_SLT, OP_BASIC, "slt") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Slt<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            auto v = Operator<T>::getSrcA()->getVal() < Operator<T>::getSrcB()->getVal() ? 1 : 0;
-            Operator<T>::setVal(v);
+            Slt<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() < Operator<T>::getSrcB()->getVal() ? 1 : 0;
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -619,12 +1188,24 @@ class Slti : public Operator<T> {
 public:
     explicit Slti(int id, T constant) : Operator<T>(id, OP_SLT, OP_IMMEDIATE, "slti", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Slti<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            auto v = Operator<T>::getSrcA()->getVal() < Operator<T>::getConst() ? 1 : 0;
-            Operator<T>::setVal(v);
+            Slti<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() < Operator<T>::getConst() ? 1 : 0;
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
 };
 
 template<class T>
@@ -632,12 +1213,24 @@ class Sub : public Operator<T> {
 public:
     explicit Sub(int id) : Operator<T>(id, OP_SUB, OP_BASIC, "sub") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Sub<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            auto v = Operator<T>::getSrcA()->getVal() - Operator<T>::getSrcB()->getVal();
-            Operator<T>::setVal(v);
+            Sub<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() - Operator<T>::getSrcB()->getVal();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -645,12 +1238,69 @@ class Subi : public Operator<T> {
 public:
     Subi(int id, int constant) : Operator<T>(id, OP_SUB, OP_IMMEDIATE, "subi", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Subi<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            auto v = Operator<T>::getSrcA()->getVal() - Operator<T>::getConst();
-            Operator<T>::setVal(v);
+            Subi<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() - Operator<T>::getConst();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
+};
+
+// Emits each value of srcA followed by k - 1 zeros, firing k times per input value.
+template<class T>
+class Upsample : public Operator<T> {
+private:
+    int k;
+    int count;
+
+public:
+    Upsample(int id, int k) : Operator<T>(id, OP_PASS_A, OP_BASIC, "up"), k(k < 1 ? 1 : k), count(0) {}
+
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Upsample<T>(*this), newId);
+    }
+
+    void compute() override {
+        if (Operator<T>::getSrcA()) {
+            Operator<T>::setVal(count == 0 ? Operator<T>::getSrcA()->getVal() : T());
+        }
+        count = count + 1 == k ? 0 : count + 1;
+    }
+
+    void reset() override {
+        Operator<T>::reset();
+        count = 0;
+    }
+
+    void saveState(StateWriter &out) const override {
+        Operator<T>::saveState(out);
+        out.put(count);
+    }
+
+    bool loadState(StateReader &in) override {
+        return Operator<T>::loadState(in) && in.get(count);
+    }
+
+    int getRateUp() const override {
+        return k;
+    }
+
+    void accountMemory(memory_usage_t &usage) const override {
+        Operator<T>::accountMemory(usage);
+        usage.operators += sizeof(Upsample<T>) - sizeof(Operator<T>);
+    }
 };
 
 template<class T>
@@ -658,12 +1308,24 @@ class Xor : public Operator<T> {
 public:
     explicit Xor(int id) : Operator<T>(id, OP_XOR, OP_BASIC, "xor") {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Xor<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
-            auto v = Operator<T>::getSrcA()->getVal() ^Operator<T>::getSrcB()->getVal();
-            Operator<T>::setVal(v);
+            Xor<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() ^Operator<T>::getSrcB()->getVal();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A | 1u << PORT_B;
+    }
 };
 
 template<class T>
@@ -671,11 +1333,23 @@ class Xori : public Operator<T> {
 public:
     Xori(int id, T constant) : Operator<T>(id, OP_XOR, OP_IMMEDIATE, "xori", constant) {}
 
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new Xori<T>(*this), newId);
+    }
+
     void compute() override {
         if (Operator<T>::getSrcA()) {
-            auto v = Operator<T>::getSrcA()->getVal() ^Operator<T>::getConst();
-            Operator<T>::setVal(v);
+            Xori<T>::computeSealed();
         }
     }
+
+    void computeSealed() override {
+        auto v = Operator<T>::getSrcA()->getVal() ^Operator<T>::getConst();
+        Operator<T>::setVal(v);
+    }
+
+    unsigned getPorts() const override {
+        return 1u << PORT_A;
+    }
 };
 #endif
@@ -0,0 +1,313 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#endif
+
+typedef enum {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS = 1,
+    PERF_L1D_MISSES = 2,
+    PERF_LLC_MISSES = 3,
+    PERF_BRANCH_MISSES = 4,
+    PERF_NUM_COUNTERS = 5
+} perf_counter_t;
+
+static const char *const perf_counter_names[PERF_NUM_COUNTERS] = {"cycles", "instructions", "l1d-misses",
+                                                                   "llc-misses", "branch-misses"};
+
+typedef struct {
+    unsigned long long value[PERF_NUM_COUNTERS];
+} perf_sample_t;
+
+inline perf_sample_t perfSampleZero() {
+    perf_sample_t s;
+    memset(&s, 0, sizeof(s));
+    return s;
+}
+
+inline perf_sample_t perfSampleDiff(const perf_sample_t &a, const perf_sample_t &b) {
+    perf_sample_t s;
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        s.value[i] = a.value[i] - b.value[i];
+    }
+    return s;
+}
+
+inline void perfSampleAdd(perf_sample_t &acc, const perf_sample_t &s) {
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        acc.value[i] += s.value[i];
+    }
+}
+
+/*
+ * A perf_event_open group counting user-space cycles, instructions, L1D read misses,
+ * LLC misses and branch misses of the thread that constructs it (pid 0, any cpu), so it
+ * has to be created on the thread that runs the code to measure. Other threads and
+ * processes are not counted: the workers of NumaExecutor and the partitions of
+ * DistributedRunner would each need a group of their own. Counters the kernel refuses
+ * (no PMU in a VM or container, perf_event_paranoid too strict) are left out; when
+ * none can be opened isAvailable() is false and every read returns zeros.
+ */
+class PerfCounterGroup {
+private:
+    int fd[PERF_NUM_COUNTERS];
+    unsigned long long ids[PERF_NUM_COUNTERS];
+    int leader;
+    std::string error;
+
+#ifdef __linux__
+
+    static int open(perf_counter_t c, int groupFd) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.disabled = groupFd == -1 ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        switch (c) {
+            case PERF_CYCLES:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case PERF_INSTRUCTIONS:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case PERF_L1D_MISSES:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            case PERF_LLC_MISSES:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                break;
+            default:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+        }
+        return (int) syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+    }
+
+#endif
+
+public:
+    PerfCounterGroup() : leader(-1) {
+        for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+            fd[i] = -1;
+            ids[i] = 0;
+        }
+#ifdef __linux__
+        for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+            fd[i] = PerfCounterGroup::open((perf_counter_t) i, leader);
+            if (fd[i] == -1) {
+                if (error.empty()) {
+                    error = std::string(perf_counter_names[i]) + ": " + strerror(errno);
+                }
+                continue;
+            }
+            if (leader == -1) {
+                leader = fd[i];
+            }
+            ioctl(fd[i], PERF_EVENT_IOC_ID, &ids[i]);
+        }
+#else
+        error = "perf_event_open is only available on Linux";
+#endif
+    }
+
+    ~PerfCounterGroup() {
+#ifdef __linux__
+        for (int f:fd) {
+            if (f != -1) {
+                close(f);
+            }
+        }
+#endif
+    }
+
+    PerfCounterGroup(const PerfCounterGroup &) = delete;
+
+    PerfCounterGroup &operator=(const PerfCounterGroup &) = delete;
+
+    bool isAvailable() const {
+        return leader != -1;
+    }
+
+    bool has(perf_counter_t c) const {
+        return fd[c] != -1;
+    }
+
+    // Reason the first missing counter could not be opened; empty when all of them are counting.
+    const std::string &getError() const {
+        return error;
+    }
+
+    void start() {
+#ifdef __linux__
+        if (leader != -1) {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    void stop() {
+#ifdef __linux__
+        if (leader != -1) {
+            ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    // Values accumulated since start(), scaled up when the kernel had to multiplex the group.
+    perf_sample_t read() const {
+        perf_sample_t s = perfSampleZero();
+#ifdef __linux__
+        if (leader == -1) {
+            return s;
+        }
+        unsigned long long buf[3 + 2 * PERF_NUM_COUNTERS];
+        if (::read(leader, buf, sizeof(buf)) <= 0) {
+            return s;
+        }
+        unsigned long long nr = buf[0], enabled = buf[1], running = buf[2];
+        for (unsigned long long i = 0; i < nr; ++i) {
+            unsigned long long v = buf[3 + 2 * i];
+            unsigned long long id = buf[4 + 2 * i];
+            if (running && running < enabled) {
+                v = (unsigned long long) ((double) v * enabled / running);
+            }
+            for (int c = 0; c < PERF_NUM_COUNTERS; ++c) {
+                if (fd[c] != -1 && ids[c] == id) {
+                    s.value[c] = v;
+                }
+            }
+        }
+#endif
+        return s;
+    }
+};
+
+// Adds the counter delta over its lifetime to acc; used to wrap a benchmark case or any other region.
+class PerfScope {
+private:
+    const PerfCounterGroup &group;
+    perf_sample_t &acc;
+    perf_sample_t begin;
+
+public:
+    PerfScope(const PerfCounterGroup &group, perf_sample_t &acc) : group(group), acc(acc), begin(group.read()) {}
+
+    ~PerfScope() {
+        perfSampleAdd(acc, perfSampleDiff(group.read(), begin));
+    }
+};
+
+/*
+ * Counter totals normalized per input token and per operator firing,
+ * with an optional breakdown per level of the graph. The firing count is either
+ * counted or, when estimated, an upper bound such as cycles x operators.
+ */
+class PerfReport {
+private:
+    const PerfCounterGroup *group;
+    perf_sample_t total;
+    unsigned long tokens;
+    unsigned long firings;
+    bool estimated;
+    std::vector<perf_sample_t> levels;
+    std::vector<unsigned long> levelFirings;
+
+public:
+    // A null group reports the counters as unavailable.
+    PerfReport(const PerfCounterGroup *group, const perf_sample_t &total, unsigned long tokens,
+               unsigned long firings, bool estimated = false) : group(group), total(total), tokens(tokens),
+                                                                firings(firings), estimated(estimated) {}
+
+    void addLevel(const perf_sample_t &s, unsigned long levelFiring) {
+        levels.push_back(s);
+        levelFirings.push_back(levelFiring);
+    }
+
+    const perf_sample_t &getTotal() const {
+        return total;
+    }
+
+    unsigned long getTokens() const {
+        return tokens;
+    }
+
+    unsigned long getFirings() const {
+        return firings;
+    }
+
+    // Whether getFirings() and perOp() rest on an estimated firing count rather than a counted one.
+    bool isEstimated() const {
+        return estimated;
+    }
+
+    double perToken(perf_counter_t c) const {
+        return tokens ? (double) total.value[c] / tokens : 0;
+    }
+
+    double perOp(perf_counter_t c) const {
+        return firings ? (double) total.value[c] / firings : 0;
+    }
+
+    void print(std::ostream &out) const {
+        if (!group || !group->isAvailable()) {
+            out << "perf counters unavailable: " << (group ? group->getError() : "no counter group") << std::endl;
+            return;
+        }
+        out << std::left << std::setw(16) << "counter" << std::right << std::setw(16) << "total"
+            << std::setw(14) << "per token" << std::setw(14) << (estimated ? "per op (est)" : "per op") << std::endl;
+        for (int c = 0; c < PERF_NUM_COUNTERS; ++c) {
+            out << std::left << std::setw(16) << perf_counter_names[c] << std::right;
+            if (!group->has((perf_counter_t) c)) {
+                out << std::setw(16) << "n/a" << std::endl;
+                continue;
+            }
+            out << std::setw(16) << total.value[c] << std::fixed << std::setprecision(3)
+                << std::setw(14) << PerfReport::perToken((perf_counter_t) c)
+                << std::setw(14) << PerfReport::perOp((perf_counter_t) c) << std::endl;
+        }
+        if (estimated) {
+            out << "per op assumes " << firings << " firings, estimated, not counted" << std::endl;
+        }
+        if (total.value[PERF_CYCLES]) {
+            out << "ipc " << std::setprecision(3)
+                << (double) total.value[PERF_INSTRUCTIONS] / total.value[PERF_CYCLES] << std::endl;
+        }
+        for (size_t l = 0; l < levels.size(); ++l) {
+            out << "level " << l;
+            for (int c = 0; c < PERF_NUM_COUNTERS; ++c) {
+                if (group->has((perf_counter_t) c)) {
+                    out << " " << perf_counter_names[c] << "/op=" << std::setprecision(3)
+                        << (levelFirings[l] ? (double) levels[l].value[c] / levelFirings[l] : 0.0);
+                }
+            }
+            out << std::endl;
+        }
+        out.unsetf(std::ios::floatfield);
+    }
+};
+
+#endif //PERF_COUNTERS_H
@@ -0,0 +1,130 @@
+#ifndef PLAN_CACHE_H
+#define PLAN_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <checkpoint.h>
+#include <data_flow.h>
+
+/*
+ * FNV-1a over the structure of a graph in id order: for every operator its id, type, opcode,
+ * label, rate change, constant (immediates only) and the ids wired to its A, B and branch
+ * ports. Levels and run state are left out, so the hash is the same before and after leveling.
+ */
+template<class T>
+uint64_t structuralHash(const DataFlow<T> &df) {
+    uint64_t h = FNV1A_OFFSET;
+    for (auto item:df.getOpArray()) {
+        auto op = item.second;
+        int32_t fields[8] = {item.first, op->getType(), op->getOpCode(), op->getRateUp(), op->getRateDown(),
+                             op->getSrcA() ? op->getSrcA()->getId() : -1,
+                             op->getSrcB() ? op->getSrcB()->getId() : -1,
+                             op->getBranchIn() ? op->getBranchIn()->getId() : -1};
+        h = checkpointHash(fields, sizeof(fields), h);
+        h = checkpointHash(op->getLabel().data(), op->getLabel().size() + 1, h);
+        if (op->getType() == OP_IMMEDIATE) {
+            T c = op->getConst();
+            h = checkpointHash(&c, sizeof(c), h);
+        }
+    }
+    return h;
+}
+
+// "DFPC" in little endian, and the layout version below.
+static const uint32_t PLAN_MAGIC = 0x43504644;
+static const uint32_t PLAN_VERSION = 1;
+
+/*
+ * On-disk cache of the leveled form of graphs, one file per structural hash in a directory:
+ *
+ *   "DFPC" | uint32 version | uint64 hash | uint32 #ops | int32 max level |
+ *   per op in id order: int32 id, int32 level | uint64 FNV-1a of everything before
+ *
+ * A warm start builds the graph with link() only and calls prepare(), which loads the levels
+ * instead of running updateOpLevel(). A file with another version, a bad checksum or a
+ * different set of operators counts as a miss and is rewritten.
+ */
+template<class T>
+class PlanCache {
+private:
+    std::string dir;
+
+public:
+    explicit PlanCache(const std::string &dir) : dir(dir) {}
+
+    std::string pathFor(uint64_t hash) const {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx.plan", (unsigned long long) hash);
+        return dir + name;
+    }
+
+    // Applies the cached levels of df; false on a miss or an unusable file, leaving df untouched.
+    bool load(DataFlow<T> &df) const {
+        uint64_t hash = structuralHash(df);
+        std::vector<uint8_t> bytes;
+        uint64_t sum;
+        if (!readFile(PlanCache<T>::pathFor(hash), bytes) || bytes.size() < sizeof(sum)) {
+            return false;
+        }
+        size_t body = bytes.size() - sizeof(sum);
+        memcpy(&sum, bytes.data() + body, sizeof(sum));
+        if (sum != checkpointHash(bytes.data(), body)) {
+            return false;
+        }
+        StateReader in(bytes.data(), bytes.data() + body);
+        uint32_t magic, version, count;
+        uint64_t stored;
+        int32_t maxLevel;
+        if (!in.get(magic) || !in.get(version) || !in.get(stored) || !in.get(count) || !in.get(maxLevel) ||
+            magic != PLAN_MAGIC || version != PLAN_VERSION || stored != hash || count != df.getOpArray().size() ||
+            in.remaining() != count * 2 * sizeof(int32_t)) {
+            return false;
+        }
+        std::vector<int32_t> levels(count * 2);
+        in.read(levels.data(), levels.size() * sizeof(int32_t));
+        uint32_t i = 0;
+        for (auto item:df.getOpArray()) {
+            if (levels[2 * i++] != item.first) {
+                return false;
+            }
+        }
+        i = 0;
+        for (auto item:df.getOpArray()) {
+            item.second->setLevel(levels[2 * i++ + 1]);
+        }
+        df.setMaxLevel(maxLevel);
+        return true;
+    }
+
+    bool store(const DataFlow<T> &df) const {
+        uint64_t hash = structuralHash(df);
+        std::vector<uint8_t> bytes;
+        StateWriter out(bytes);
+        out.put(PLAN_MAGIC);
+        out.put(PLAN_VERSION);
+        out.put(hash);
+        out.put((uint32_t) df.getOpArray().size());
+        out.put((int32_t) df.getMaxLevel());
+        for (auto item:df.getOpArray()) {
+            out.put((int32_t) item.first);
+            out.put((int32_t) item.second->getLevel());
+        }
+        out.put(checkpointHash(bytes.data(), bytes.size()));
+        return writeFileAtomic(PlanCache<T>::pathFor(hash), bytes);
+    }
+
+    // Levels df from the cache, or with updateOpLevel() and stores the result. Returns true on a hit.
+    bool prepare(DataFlow<T> &df) const {
+        if (PlanCache<T>::load(df)) {
+            return true;
+        }
+        df.updateOpLevel();
+        PlanCache<T>::store(df);
+        return false;
+    }
+};
+
+#endif //PLAN_CACHE_H
@@ -0,0 +1,121 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <operator.h>
+
+/*
+ * Records the values of one operator while compute() runs, without adding operators or
+ * levels to the graph. Samples go into a ring preallocated at construction (capacity rounded
+ * up to a power of two) that the compute thread fills and any one other thread drains with
+ * read(); the two sides only share the head and tail counters. When the reader falls behind,
+ * new samples are dropped and counted rather than overwriting unread ones.
+ *
+ * By default every firing of the operator is kept. setEvery(n) keeps one firing in n, and
+ * setTrigger(pred, window) keeps nothing until pred holds for a value, then that value and
+ * the next window - 1 firings, and waits for the trigger again.
+ */
+template<class T>
+class Probe {
+public:
+    struct Sample {
+        unsigned long cycle;
+        T value;
+    };
+
+private:
+    Operator<T> *op;
+    std::vector<Sample> ring;
+    unsigned long mask;
+    std::atomic<unsigned long> head;
+    char pad0[64 - sizeof(std::atomic<unsigned long>)];
+    std::atomic<unsigned long> tail;
+    char pad1[64 - sizeof(std::atomic<unsigned long>)];
+    std::atomic<unsigned long> dropped;
+    unsigned long every;
+    unsigned long seen;
+    std::function<bool(T)> trigger;
+    unsigned long window;
+    unsigned long left;
+
+public:
+    explicit Probe(unsigned long capacity = 1024) : op(nullptr), head(0), tail(0), dropped(0), every(1), seen(0),
+                                                    window(1), left(0) {
+        unsigned long n = 1;
+        while (n < capacity) {
+            n <<= 1;
+        }
+        ring.resize(n);
+        mask = n - 1;
+    }
+
+    Probe(const Probe &) = delete;
+
+    Probe &operator=(const Probe &) = delete;
+
+    // Keeps one firing in n (n >= 1). Set before attaching.
+    void setEvery(unsigned long n) {
+        every = n ? n : 1;
+    }
+
+    // Keeps windows of firings starting at each value that satisfies pred. Set before attaching.
+    void setTrigger(const std::function<bool(T)> &pred, unsigned long windowSize = 1) {
+        trigger = pred;
+        window = windowSize ? windowSize : 1;
+        left = 0;
+    }
+
+    // Called by the compute thread after each firing of the probed operator.
+    void record(unsigned long cycle) {
+        if (every > 1 && seen++ % every != 0) {
+            return;
+        }
+        T v = op->getVal();
+        if (trigger) {
+            if (left == 0 && !trigger(v)) {
+                return;
+            }
+            left = left ? left - 1 : window - 1;
+        }
+        unsigned long h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) > mask) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        ring[h & mask].cycle = cycle;
+        ring[h & mask].value = v;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // Moves every sample recorded so far to the end of out. Returns how many were moved.
+    size_t read(std::vector<Sample> &out) {
+        unsigned long t = tail.load(std::memory_order_relaxed);
+        unsigned long h = head.load(std::memory_order_acquire);
+        for (unsigned long i = t; i != h; ++i) {
+            out.push_back(ring[i & mask]);
+        }
+        tail.store(h, std::memory_order_release);
+        return (size_t) (h - t);
+    }
+
+    // Samples lost because the ring was full.
+    unsigned long getDropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    unsigned long getCapacity() const {
+        return mask + 1;
+    }
+
+    Operator<T> *getOp() const {
+        return op;
+    }
+
+    void setOp(Operator<T> *o) {
+        op = o;
+    }
+};
+
+#endif //PROBE_H
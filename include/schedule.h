@@ -0,0 +1,389 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <algorithm>
+#include <functional>
+#include <ostream>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <data_flow.h>
+
+typedef enum {
+    FU_ALU = 0,
+    FU_MULT = 1,
+    FU_SHIFT = 2,
+    FU_MUX = 3,
+    FU_IO = 4,
+    FU_NUM_TYPES = 5
+} fu_type_t;
+
+static const char *const fu_type_names[FU_NUM_TYPES] = {"alu", "mult", "shift", "mux", "io"};
+
+inline fu_type_t fuType(int type, int opCode) {
+    if (type == OP_IN || type == OP_OUT) {
+        return FU_IO;
+    }
+    switch (opCode) {
+        case OP_MULT:
+            return FU_MULT;
+        case OP_SHL:
+        case OP_SHR:
+            return FU_SHIFT;
+        case OP_MUX:
+            return FU_MUX;
+        default:
+            return FU_ALU;
+    }
+}
+
+/*
+ * Static timing and resource analysis of a DataFlow graph as it would be mapped onto a
+ * CGRA whose functional units are fully pipelined (one issue per unit per cycle).
+ *
+ * analyze() computes ASAP/ALAP times, per-node slack and the critical path.
+ * minII() gives the minimum initiation interval for a number of units of each type.
+ * listSchedule() places every node under those limits, after which the balancing
+ * registers needed on each edge are known and can be materialized as PassA chains.
+ * Everything is O((V + E) log V), so 100k-node graphs take well under a second.
+ */
+template<class T>
+class ScheduleAnalysis {
+private:
+    DataFlow<T> &df;
+    int latency[FU_NUM_TYPES];
+    std::vector<int> ids;
+    std::unordered_map<int, int> index;
+    std::vector<fu_type_t> fu;
+    std::vector<std::vector<int>> succ;
+    std::vector<std::vector<int>> pred;
+    std::vector<int> order;
+    std::vector<int> asap;
+    std::vector<int> alap;
+    std::vector<int> start;
+    int criticalLength;
+    int scheduleLength;
+    bool acyclic;
+
+    int lat(int i) const {
+        return ScheduleAnalysis<T>::latency[ScheduleAnalysis<T>::fu[i]];
+    }
+
+    void build() {
+        auto &ops = ScheduleAnalysis<T>::df.getOpArray();
+        ids.clear();
+        index.clear();
+        fu.clear();
+        ids.reserve(ops.size());
+        for (auto item:ops) {
+            index[item.first] = (int) ids.size();
+            ids.push_back(item.first);
+            fu.push_back(fuType(item.second->getType(), item.second->getOpCode()));
+        }
+        succ.assign(ids.size(), std::vector<int>());
+        pred.assign(ids.size(), std::vector<int>());
+        for (auto &g:ScheduleAnalysis<T>::df.getGraph()) {
+            auto s = index.find(g.first);
+            if (s == index.end()) {
+                continue;
+            }
+            for (auto child:g.second) {
+                auto d = index.find(child);
+                if (d != index.end()) {
+                    succ[s->second].push_back(d->second);
+                    pred[d->second].push_back(s->second);
+                }
+            }
+        }
+    }
+
+    // Kahn's algorithm; a graph with a cycle leaves nodes out of the order.
+    void topologicalOrder() {
+        std::vector<int> inDegree(ids.size(), 0);
+        for (size_t i = 0; i < ids.size(); ++i) {
+            inDegree[i] = (int) pred[i].size();
+        }
+        order.clear();
+        order.reserve(ids.size());
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (inDegree[i] == 0) {
+                order.push_back((int) i);
+            }
+        }
+        for (size_t k = 0; k < order.size(); ++k) {
+            for (auto s:succ[order[k]]) {
+                if (--inDegree[s] == 0) {
+                    order.push_back(s);
+                }
+            }
+        }
+        acyclic = order.size() == ids.size();
+    }
+
+public:
+    explicit ScheduleAnalysis(DataFlow<T> &df) : df(df), criticalLength(0), scheduleLength(0), acyclic(true) {
+        for (int &l:latency) {
+            l = 1;
+        }
+    }
+
+    // Cycles from issue to result on a unit of the given type (at least 1). Default is 1 for every type.
+    void setLatency(fu_type_t f, int cycles) {
+        ScheduleAnalysis<T>::latency[f] = cycles < 1 ? 1 : cycles;
+    }
+
+    // Returns false when the graph has a cycle, in which case nothing else is meaningful.
+    bool analyze() {
+        ScheduleAnalysis<T>::build();
+        ScheduleAnalysis<T>::topologicalOrder();
+        asap.assign(ids.size(), 0);
+        alap.assign(ids.size(), 0);
+        start.assign(ids.size(), -1);
+        criticalLength = 0;
+        scheduleLength = 0;
+        if (!acyclic) {
+            return false;
+        }
+        for (auto i:order) {
+            for (auto s:succ[i]) {
+                asap[s] = std::max(asap[s], asap[i] + ScheduleAnalysis<T>::lat(i));
+            }
+            criticalLength = std::max(criticalLength, asap[i] + ScheduleAnalysis<T>::lat(i));
+        }
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            int i = *it;
+            int latest = criticalLength;
+            for (auto s:succ[i]) {
+                latest = std::min(latest, alap[s]);
+            }
+            alap[i] = latest - ScheduleAnalysis<T>::lat(i);
+        }
+        return true;
+    }
+
+    bool isAcyclic() const {
+        return acyclic;
+    }
+
+    int getCriticalPathLength() const {
+        return criticalLength;
+    }
+
+    // Operator ids along one longest path, source first.
+    std::vector<int> getCriticalPath() const {
+        std::vector<int> path;
+        int cur = -1;
+        for (auto i:order) {
+            if (pred[i].empty() && alap[i] == asap[i]) {
+                cur = i;
+                break;
+            }
+        }
+        while (cur != -1) {
+            path.push_back(ids[cur]);
+            int next = -1;
+            for (auto s:succ[cur]) {
+                if (asap[s] == asap[cur] + ScheduleAnalysis<T>::lat(cur) && alap[s] == asap[s]) {
+                    next = s;
+                    break;
+                }
+            }
+            cur = next;
+        }
+        return path;
+    }
+
+    int getAsap(int op_id) const {
+        return asap[index.at(op_id)];
+    }
+
+    int getAlap(int op_id) const {
+        return alap[index.at(op_id)];
+    }
+
+    int getSlack(int op_id) const {
+        int i = index.at(op_id);
+        return alap[i] - asap[i];
+    }
+
+    int getNumOps(fu_type_t f) const {
+        return (int) std::count(fu.begin(), fu.end(), f);
+    }
+
+    /*
+     * Minimum initiation interval with units[f] units of each type (0 means unlimited):
+     * the resource bound max(ceil(ops_f / units_f)). The graph is acyclic, so the
+     * recurrence bound is 1 and the array accepts a new token every MII cycles.
+     */
+    int minII(const int units[FU_NUM_TYPES]) const {
+        int count[FU_NUM_TYPES] = {0};
+        for (auto f:fu) {
+            count[f]++;
+        }
+        int mii = 1;
+        for (int f = 0; f < FU_NUM_TYPES; ++f) {
+            if (units[f] > 0) {
+                mii = std::max(mii, (count[f] + units[f] - 1) / units[f]);
+            }
+        }
+        return mii;
+    }
+
+    /*
+     * List schedule of one token under the given unit counts (0 means unlimited).
+     * Ready nodes are issued by increasing ALAP time, so critical nodes go first.
+     * Returns the schedule length in cycles.
+     */
+    int listSchedule(const int units[FU_NUM_TYPES]) {
+        typedef std::pair<int, int> entry_t;
+        std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>> pending;
+        std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>> ready[FU_NUM_TYPES];
+        std::vector<int> waiting(ids.size());
+        std::vector<int> earliest(ids.size(), 0);
+        start.assign(ids.size(), -1);
+        scheduleLength = 0;
+        if (!acyclic) {
+            return 0;
+        }
+        for (size_t i = 0; i < ids.size(); ++i) {
+            waiting[i] = (int) pred[i].size();
+            if (waiting[i] == 0) {
+                pending.push(entry_t(0, (int) i));
+            }
+        }
+        size_t scheduled = 0;
+        int t = 0;
+        while (scheduled < ids.size()) {
+            bool any = false;
+            for (int f = 0; f < FU_NUM_TYPES; ++f) {
+                any = any || !ready[f].empty();
+            }
+            if (!any && !pending.empty() && pending.top().first > t) {
+                t = pending.top().first;
+            }
+            while (!pending.empty() && pending.top().first <= t) {
+                int i = pending.top().second;
+                pending.pop();
+                ready[fu[i]].push(entry_t(alap[i], i));
+            }
+            for (int f = 0; f < FU_NUM_TYPES; ++f) {
+                for (int u = 0; !ready[f].empty() && (units[f] <= 0 || u < units[f]); ++u) {
+                    int i = ready[f].top().second;
+                    ready[f].pop();
+                    start[i] = t;
+                    scheduled++;
+                    int done = t + ScheduleAnalysis<T>::lat(i);
+                    scheduleLength = std::max(scheduleLength, done);
+                    for (auto s:succ[i]) {
+                        earliest[s] = std::max(earliest[s], done);
+                        if (--waiting[s] == 0) {
+                            pending.push(entry_t(earliest[s], s));
+                        }
+                    }
+                }
+            }
+            t++;
+        }
+        return scheduleLength;
+    }
+
+    int getScheduleLength() const {
+        return scheduleLength;
+    }
+
+    // Issue cycle of a node in the last list schedule.
+    int getStart(int op_id) const {
+        return start[index.at(op_id)];
+    }
+
+    // Cycles a value waits on the edge src -> dst in the last list schedule.
+    int getEdgeDelay(int src_id, int dst_id) const {
+        int s = index.at(src_id);
+        return start[index.at(dst_id)] - start[s] - ScheduleAnalysis<T>::lat(s);
+    }
+
+    // Registers needed to balance the last list schedule; consumers of one value share a delay line.
+    long getNumBalancingRegisters() const {
+        long total = 0;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            int d = 0;
+            for (auto s:succ[i]) {
+                d = std::max(d, start[s] - start[i] - ScheduleAnalysis<T>::lat((int) i));
+            }
+            total += d;
+        }
+        return total;
+    }
+
+    /*
+     * Materializes the balancing registers of the last list schedule as PassA chains,
+     * one chain per producer tapped at each consumer's delay, numbered from the largest
+     * existing id + 1. PassA forwards within the cycle, so results do not change.
+     * The graph is re-leveled once at the end and analyze() is re-run on it, so the
+     * queries above describe the new graph; the list schedule is dropped until the next
+     * listSchedule(). Returns the number of registers inserted.
+     */
+    long insertBalancingRegisters() {
+        if (ids.empty() || start.empty() || start[0] < 0) {
+            return 0;
+        }
+        int next = ids.back() + 1;
+        long inserted = 0;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            int d = 0;
+            for (auto s:succ[i]) {
+                d = std::max(d, start[s] - start[i] - ScheduleAnalysis<T>::lat((int) i));
+            }
+            if (d == 0) {
+                continue;
+            }
+            auto src = df.getOp(ids[i]);
+            std::vector<Operator<T> *> chain;
+            Operator<T> *prev = src;
+            for (int k = 0; k < d; ++k) {
+                auto reg = new PassA<T>(next++);
+                df.link(prev, reg, PORT_A);
+                chain.push_back(reg);
+                prev = reg;
+            }
+            inserted += d;
+            for (auto s:succ[i]) {
+                int delay = start[s] - start[i] - ScheduleAnalysis<T>::lat((int) i);
+                if (delay == 0) {
+                    continue;
+                }
+                auto dst = df.getOp(ids[s]);
+                if (dst->getSrcA() == src) {
+                    df.unlink(src, dst, PORT_A);
+                    df.link(chain[delay - 1], dst, PORT_A);
+                }
+                if (dst->getSrcB() == src) {
+                    df.unlink(src, dst, PORT_B);
+                    df.link(chain[delay - 1], dst, PORT_B);
+                }
+                if (dst->getBranchIn() == src) {
+                    df.unlink(src, dst, PORT_BRANCH);
+                    df.link(chain[delay - 1], dst, PORT_BRANCH);
+                }
+            }
+        }
+        df.updateOpLevel();
+        ScheduleAnalysis<T>::analyze();
+        return inserted;
+    }
+
+    void print(std::ostream &out, const int units[FU_NUM_TYPES]) {
+        out << "nodes " << ids.size() << ", critical path " << criticalLength << " cycles" << std::endl;
+        for (int f = 0; f < FU_NUM_TYPES; ++f) {
+            out << "  " << fu_type_names[f] << ": " << ScheduleAnalysis<T>::getNumOps((fu_type_t) f) << " ops, "
+                << (units[f] > 0 ? std::to_string(units[f]) : std::string("unlimited")) << " units" << std::endl;
+        }
+        int mii = ScheduleAnalysis<T>::minII(units);
+        out << "min II " << mii << " (" << 1.0 / mii << " tokens/cycle), schedule length "
+            << ScheduleAnalysis<T>::listSchedule(units) << " cycles, balancing registers "
+            << ScheduleAnalysis<T>::getNumBalancingRegisters() << std::endl;
+    }
+};
+
+#endif //SCHEDULE_H
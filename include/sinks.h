@@ -0,0 +1,437 @@
+#ifndef SINKS_H
+#define SINKS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include <operator.h>
+
+/*
+ * Reducers fold a stream into bounded state. Each one has add(v) for the next value,
+ * merge(other) to combine the state of another reducer of the same configuration
+ * (e.g. one per thread or per partition), clear() to start over, saveState()/loadState()
+ * for snapshots and getBytes() for the memory it holds.
+ */
+
+template<class T>
+class SumReducer {
+public:
+    typedef typename std::conditional<std::is_integral<T>::value, long long, double>::type acc_t;
+
+private:
+    acc_t sum;
+    unsigned long count;
+
+public:
+    SumReducer() : sum(0), count(0) {}
+
+    void add(T v) {
+        sum += (acc_t) v;
+        count++;
+    }
+
+    void merge(const SumReducer<T> &o) {
+        sum += o.sum;
+        count += o.count;
+    }
+
+    void clear() {
+        sum = 0;
+        count = 0;
+    }
+
+    size_t getBytes() const {
+        return sizeof(SumReducer<T>);
+    }
+
+    void saveState(StateWriter &out) const {
+        out.put(sum);
+        out.put(count);
+    }
+
+    bool loadState(StateReader &in) {
+        return in.get(sum) && in.get(count);
+    }
+
+    acc_t getSum() const {
+        return sum;
+    }
+
+    unsigned long getCount() const {
+        return count;
+    }
+
+    double getMean() const {
+        return count ? (double) sum / count : 0;
+    }
+};
+
+template<class T>
+class MinMaxReducer {
+private:
+    T min;
+    T max;
+    unsigned long count;
+
+public:
+    MinMaxReducer() : min(std::numeric_limits<T>::max()), max(std::numeric_limits<T>::lowest()), count(0) {}
+
+    void add(T v) {
+        min = v < min ? v : min;
+        max = v > max ? v : max;
+        count++;
+    }
+
+    void merge(const MinMaxReducer<T> &o) {
+        min = o.min < min ? o.min : min;
+        max = o.max > max ? o.max : max;
+        count += o.count;
+    }
+
+    void clear() {
+        *this = MinMaxReducer<T>();
+    }
+
+    size_t getBytes() const {
+        return sizeof(MinMaxReducer<T>);
+    }
+
+    void saveState(StateWriter &out) const {
+        out.put(min);
+        out.put(max);
+        out.put(count);
+    }
+
+    bool loadState(StateReader &in) {
+        return in.get(min) && in.get(max) && in.get(count);
+    }
+
+    T getMin() const {
+        return min;
+    }
+
+    T getMax() const {
+        return max;
+    }
+
+    unsigned long getCount() const {
+        return count;
+    }
+};
+
+/*
+ * Fixed-width bins over [lo, hi); values outside land in the underflow and overflow counts,
+ * and so does NaN, as overflow. An empty range or numBins <= 0 gives a histogram without bins,
+ * which counts every value below lo as underflow and the rest as overflow. Only histograms
+ * with the same bins merge.
+ */
+template<class T>
+class HistogramReducer {
+private:
+    double lo;
+    double width;
+    std::vector<unsigned long> bins;
+    unsigned long under;
+    unsigned long over;
+
+public:
+    HistogramReducer(T lo, T hi, int numBins) : lo((double) lo), width(1), under(0), over(0) {
+        if (numBins > 0 && (double) hi > (double) lo) {
+            width = ((double) hi - (double) lo) / numBins;
+            bins.assign((unsigned long) numBins, 0);
+        }
+    }
+
+    void add(T v) {
+        double x = ((double) v - lo) / width;
+        if (x < 0) {
+            under++;
+        } else if (!(x < (double) bins.size())) {
+            over++;
+        } else {
+            bins[(size_t) x]++;
+        }
+    }
+
+    // False, changing nothing, when o has other bins.
+    bool merge(const HistogramReducer<T> &o) {
+        if (lo != o.lo || width != o.width || bins.size() != o.bins.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < bins.size(); ++i) {
+            bins[i] += o.bins[i];
+        }
+        under += o.under;
+        over += o.over;
+        return true;
+    }
+
+    void clear() {
+        std::fill(bins.begin(), bins.end(), 0);
+        under = over = 0;
+    }
+
+    size_t getBytes() const {
+        return sizeof(HistogramReducer<T>) + bins.capacity() * sizeof(unsigned long);
+    }
+
+    void saveState(StateWriter &out) const {
+        out.write(bins.data(), bins.size() * sizeof(unsigned long));
+        out.put(under);
+        out.put(over);
+    }
+
+    bool loadState(StateReader &in) {
+        return in.read(bins.data(), bins.size() * sizeof(unsigned long)) && in.get(under) && in.get(over);
+    }
+
+    const std::vector<unsigned long> &getBins() const {
+        return bins;
+    }
+
+    unsigned long getUnderflow() const {
+        return under;
+    }
+
+    unsigned long getOverflow() const {
+        return over;
+    }
+};
+
+// The k largest values, kept in a min-heap of size k.
+template<class T>
+class TopKReducer {
+private:
+    size_t k;
+    std::vector<T> heap;
+
+public:
+    explicit TopKReducer(size_t k) : k(k) {
+        heap.reserve(k);
+    }
+
+    void add(T v) {
+        if (heap.size() < k) {
+            heap.push_back(v);
+            std::push_heap(heap.begin(), heap.end(), std::greater<T>());
+        } else if (k && v > heap.front()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<T>());
+            heap.back() = v;
+            std::push_heap(heap.begin(), heap.end(), std::greater<T>());
+        }
+    }
+
+    void merge(const TopKReducer<T> &o) {
+        for (auto v:o.heap) {
+            TopKReducer<T>::add(v);
+        }
+    }
+
+    void clear() {
+        heap.clear();
+    }
+
+    size_t getBytes() const {
+        return sizeof(TopKReducer<T>) + heap.capacity() * sizeof(T);
+    }
+
+    void saveState(StateWriter &out) const {
+        out.put((uint64_t) heap.size());
+        out.write(heap.data(), heap.size() * sizeof(T));
+    }
+
+    bool loadState(StateReader &in) {
+        uint64_t n;
+        if (!in.get(n) || n > k) {
+            return false;
+        }
+        heap.resize(n);
+        return in.read(heap.data(), n * sizeof(T));
+    }
+
+    // Largest first.
+    std::vector<T> getValues() const {
+        std::vector<T> v = heap;
+        std::sort(v.begin(), v.end(), std::greater<T>());
+        return v;
+    }
+};
+
+/*
+ * Every stride-th value, in at most `capacity` entries. When the buffer fills up the stride
+ * doubles and every other kept value is dropped, so the summary always spans the whole
+ * stream at the finest stride that fits.
+ */
+template<class T>
+class DecimateReducer {
+private:
+    size_t capacity;
+    unsigned long first_stride;
+    unsigned long stride;
+    unsigned long seen;
+    std::vector<T> values;
+
+    void thin() {
+        size_t j = 0;
+        for (size_t i = 0; i < values.size(); i += 2) {
+            values[j++] = values[i];
+        }
+        values.resize(j);
+        stride *= 2;
+    }
+
+public:
+    DecimateReducer(size_t capacity, unsigned long stride = 1) : capacity(capacity < 2 ? 2 : capacity),
+                                                                 first_stride(stride ? stride : 1),
+                                                                 stride(first_stride), seen(0) {
+        values.reserve(DecimateReducer::capacity);
+    }
+
+    void add(T v) {
+        if (seen++ % stride == 0) {
+            if (values.size() == capacity) {
+                DecimateReducer<T>::thin();
+                if ((seen - 1) % stride != 0) {
+                    return;
+                }
+            }
+            values.push_back(v);
+        }
+    }
+
+    /*
+     * Appends o as the continuation of this stream (the caller merges partitions in stream order).
+     * The next value to keep sits at stream index values.size() * stride; o's value j sits at
+     * seen + j * o.stride. The result is exact when o.stride divides seen, as it does when both
+     * reducers started with the same stride and every earlier partition was a multiple of o.stride
+     * values long; otherwise a kept value can come from up to o.stride - 1 values later.
+     */
+    void merge(const DecimateReducer<T> &o) {
+        while (stride < o.stride) {
+            DecimateReducer<T>::thin();
+        }
+        for (size_t j = 0; j < o.values.size(); ++j) {
+            unsigned long index = seen + j * o.stride;
+            if (index < values.size() * stride) {
+                continue;
+            }
+            if (values.size() == capacity) {
+                DecimateReducer<T>::thin();
+                if (index < values.size() * stride) {
+                    continue;
+                }
+            }
+            values.push_back(o.values[j]);
+        }
+        seen += o.seen;
+    }
+
+    void clear() {
+        values.clear();
+        stride = first_stride;
+        seen = 0;
+    }
+
+    size_t getBytes() const {
+        return sizeof(DecimateReducer<T>) + values.capacity() * sizeof(T);
+    }
+
+    void saveState(StateWriter &out) const {
+        out.put(stride);
+        out.put(seen);
+        out.put((uint64_t) values.size());
+        out.write(values.data(), values.size() * sizeof(T));
+    }
+
+    bool loadState(StateReader &in) {
+        uint64_t n;
+        if (!in.get(stride) || !in.get(seen) || !in.get(n) || n > capacity) {
+            return false;
+        }
+        values.resize(n);
+        return in.read(values.data(), n * sizeof(T));
+    }
+
+    const std::vector<T> &getValues() const {
+        return values;
+    }
+
+    unsigned long getStride() const {
+        return stride;
+    }
+
+    unsigned long getCount() const {
+        return seen;
+    }
+};
+
+/*
+ * Output operator that folds every value of srcA into a reducer instead of storing it.
+ * Attach one with DataFlow::attachSink() or swap it for an existing OutputStream with
+ * DataFlow::replaceSink().
+ */
+template<class T, class R>
+class ReduceSink : public Operator<T> {
+private:
+    R reducer;
+
+public:
+    ReduceSink(int id, const R &reducer) : Operator<T>(id, OP_PASS_A, OP_OUT, "sink"), reducer(reducer) {}
+
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new ReduceSink<T, R>(*this), newId);
+    }
+
+    void compute() override {
+        if (Operator<T>::getSrcA()) {
+            auto v = Operator<T>::getSrcA()->getVal();
+            Operator<T>::setVal(v);
+            reducer.add(v);
+        }
+    }
+
+    void reset() override {
+        Operator<T>::reset();
+        reducer.clear();
+    }
+
+    void saveState(StateWriter &out) const override {
+        Operator<T>::saveState(out);
+        reducer.saveState(out);
+    }
+
+    bool loadState(StateReader &in) override {
+        return Operator<T>::loadState(in) && reducer.loadState(in);
+    }
+
+    void accountMemory(memory_usage_t &usage) const override {
+        Operator<T>::accountMemory(usage);
+        usage.operators += sizeof(ReduceSink<T, R>) - sizeof(Operator<T>) - sizeof(R);
+        usage.streams += reducer.getBytes();
+    }
+
+    const R &getReducer() const {
+        return reducer;
+    }
+
+    R &getReducer() {
+        return reducer;
+    }
+};
+
+/*
+ * Merges the reducers of several sinks (e.g. one per copy or per thread) in order into acc,
+ * an empty reducer of the same configuration, which is returned as is when there are none.
+ */
+template<class T, class R>
+R mergeSinks(const std::vector<ReduceSink<T, R> *> &sinks, R acc) {
+    for (auto sink:sinks) {
+        acc.merge(sink->getReducer());
+    }
+    return acc;
+}
+
+#endif //SINKS_H
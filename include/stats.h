@@ -0,0 +1,153 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Bytes held by a graph, by what they are for (see DataFlow::getMemoryUsage()).
+typedef struct {
+    size_t operators;   // operator objects, without their values
+    size_t values;      // the current value and the constant of every operator
+    size_t edges;       // destination lists and the id maps of the graph
+    size_t streams;     // stream buffers and sink state: input/output vectors, codec blocks, reducers
+    size_t runtime;     // schedules and tables built for running the graph
+    size_t total;
+} memory_usage_t;
+
+// What LiveStats::read() saw at one moment.
+typedef struct {
+    unsigned long long cycles;
+    unsigned long long tokensIn;
+    unsigned long long tokensOut;
+    double seconds;
+    double tokensPerSec;
+    bool running;
+    // Per thread, the share of the run so far it spent working (1 until it finishes its part).
+    std::vector<double> utilization;
+} runtime_stats_t;
+
+/*
+ * Counters of the run in progress, written by the threads running the graph and readable
+ * from any other thread without locks. Each running thread owns one cache line of counters
+ * and publishes its totals there with relaxed stores after every cycle; read() sums them.
+ * The lines are allocated apart from the object, aligned by hand, so that a graph holding a
+ * LiveStats needs no over-aligned new.
+ * The counters of different threads are not read atomically together, so a total can lag
+ * by the cycle in flight.
+ */
+class LiveStats {
+public:
+    static const int MAX_THREADS = 64;
+
+private:
+    static const size_t CACHE_LINE = 64;
+
+    struct Slot {
+        std::atomic<unsigned long long> cycles;
+        std::atomic<unsigned long long> tokensIn;
+        std::atomic<unsigned long long> tokensOut;
+        std::atomic<long long> doneNs;
+        char pad[CACHE_LINE - 4 * sizeof(std::atomic<long long>)];
+    };
+
+    Slot *slots;
+    std::atomic<int> threads;
+    std::atomic<long long> startNs;
+    std::atomic<long long> endNs;
+    std::atomic<bool> running;
+
+    static long long now() {
+        return (long long) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+public:
+    LiveStats() : slots(nullptr), threads(0), startNs(0), endNs(0), running(false) {
+        void *p = nullptr;
+        if (posix_memalign(&p, CACHE_LINE, MAX_THREADS * sizeof(Slot)) != 0) {
+            p = malloc(MAX_THREADS * sizeof(Slot));
+        }
+        slots = (Slot *) p;
+        for (int t = 0; t < MAX_THREADS; ++t) {
+            new(&slots[t]) Slot();
+            slots[t].cycles.store(0);
+            slots[t].tokensIn.store(0);
+            slots[t].tokensOut.store(0);
+            slots[t].doneNs.store(0);
+        }
+    }
+
+    ~LiveStats() {
+        free(slots);
+    }
+
+    LiveStats(const LiveStats &) = delete;
+
+    LiveStats &operator=(const LiveStats &) = delete;
+
+    // Starts a run on numThreads threads, numbered from 0.
+    void begin(int numThreads) {
+        numThreads = numThreads < 1 ? 1 : numThreads > MAX_THREADS ? MAX_THREADS : numThreads;
+        for (int t = 0; t < numThreads; ++t) {
+            slots[t].cycles.store(0, std::memory_order_relaxed);
+            slots[t].tokensIn.store(0, std::memory_order_relaxed);
+            slots[t].tokensOut.store(0, std::memory_order_relaxed);
+            slots[t].doneNs.store(0, std::memory_order_relaxed);
+        }
+        threads.store(numThreads, std::memory_order_relaxed);
+        startNs.store(LiveStats::now(), std::memory_order_relaxed);
+        running.store(true, std::memory_order_release);
+    }
+
+    // Totals of thread t so far; only thread t writes its counters. Threads past MAX_THREADS are not counted.
+    void publish(int t, unsigned long long cycles, unsigned long long tokensIn, unsigned long long tokensOut) {
+        if (t < 0 || t >= MAX_THREADS) {
+            return;
+        }
+        Slot &s = slots[t];
+        s.cycles.store(cycles, std::memory_order_relaxed);
+        s.tokensIn.store(tokensIn, std::memory_order_relaxed);
+        s.tokensOut.store(tokensOut, std::memory_order_relaxed);
+    }
+
+    // Thread t has no more work in this run.
+    void finish(int t) {
+        if (t < 0 || t >= MAX_THREADS) {
+            return;
+        }
+        slots[t].doneNs.store(LiveStats::now(), std::memory_order_relaxed);
+    }
+
+    void end() {
+        endNs.store(LiveStats::now(), std::memory_order_relaxed);
+        running.store(false, std::memory_order_release);
+    }
+
+    runtime_stats_t read() const {
+        runtime_stats_t r;
+        r.running = running.load(std::memory_order_acquire);
+        long long start = startNs.load(std::memory_order_relaxed);
+        long long stop = r.running ? LiveStats::now() : endNs.load(std::memory_order_relaxed);
+        r.seconds = start ? (double) (stop - start) * 1e-9 : 0;
+        r.cycles = r.tokensIn = r.tokensOut = 0;
+        int n = threads.load(std::memory_order_relaxed);
+        for (int t = 0; t < n; ++t) {
+            auto &s = slots[t];
+            unsigned long long c = s.cycles.load(std::memory_order_relaxed);
+            r.cycles = c > r.cycles ? c : r.cycles;
+            r.tokensIn += s.tokensIn.load(std::memory_order_relaxed);
+            r.tokensOut += s.tokensOut.load(std::memory_order_relaxed);
+            long long done = s.doneNs.load(std::memory_order_relaxed);
+            double busy = done ? (double) (done - start) : (double) (stop - start);
+            r.utilization.push_back(stop > start ? busy / (double) (stop - start) : 0);
+        }
+        r.tokensPerSec = r.seconds > 0 ? r.tokensIn / r.seconds : 0;
+        return r;
+    }
+};
+
+#endif //STATS_H
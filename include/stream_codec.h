@@ -0,0 +1,359 @@
+#ifndef STREAM_CODEC_H
+#define STREAM_CODEC_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include <operator.h>
+
+#ifdef __SSE2__
+
+#include <emmintrin.h>
+
+#endif
+
+typedef enum {
+    CODEC_DELTA_BITPACK = 0,
+    CODEC_DELTA_VARINT = 1
+} codec_t;
+
+/*
+ * Block-compressed sample streams. Every block holds up to BLOCK_SIZE values:
+ *
+ *   uint8 codec | uint8 bits | uint16 count | T first value (little endian) | payload
+ *
+ * The payload holds the count - 1 differences to the previous value, zigzag mapped to
+ * unsigned so small negative steps stay small. CODEC_DELTA_BITPACK stores each in `bits`
+ * bits, LSB first, padded to a byte; CODEC_DELTA_VARINT stores them as LEB128 varints.
+ * Differences wrap in the width of T, like the operators do.
+ */
+template<class T>
+class BlockCodec {
+private:
+    typedef typename std::make_unsigned<T>::type U;
+    typedef typename std::make_signed<T>::type S;
+
+    static const int HEADER = 4 + sizeof(T);
+
+    static U zigzag(U delta) {
+        return (U) ((U) (delta << 1) ^ (U) ((S) delta >> (sizeof(T) * 8 - 1)));
+    }
+
+    static U unzigzag(U z) {
+        return (U) ((z >> 1) ^ (U) (0 - (z & 1)));
+    }
+
+    static uint64_t load64(const uint8_t *p, const uint8_t *end) {
+        uint64_t v = 0;
+        size_t n = end - p < 8 ? (size_t) (end - p) : 8;
+        memcpy(&v, p, n);
+        return v;
+    }
+
+    // out[0] holds the first value and out[1..n) the zigzag deltas; turns them into values in place.
+    static void prefixSum(U *out, size_t n) {
+        size_t i = 1;
+#ifdef __SSE2__
+        if (sizeof(U) == 2) {
+            __m128i one = _mm_set1_epi16(1);
+            __m128i zero = _mm_setzero_si128();
+            for (; i + 8 <= n; i += 8) {
+                __m128i z = _mm_loadu_si128((const __m128i *) (out + i));
+                __m128i d = _mm_xor_si128(_mm_srli_epi16(z, 1), _mm_sub_epi16(zero, _mm_and_si128(z, one)));
+                d = _mm_add_epi16(d, _mm_slli_si128(d, 2));
+                d = _mm_add_epi16(d, _mm_slli_si128(d, 4));
+                d = _mm_add_epi16(d, _mm_slli_si128(d, 8));
+                d = _mm_add_epi16(d, _mm_set1_epi16((short) out[i - 1]));
+                _mm_storeu_si128((__m128i *) (out + i), d);
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = (U) (out[i - 1] + BlockCodec<T>::unzigzag(out[i]));
+        }
+    }
+
+public:
+    static_assert(std::is_integral<T>::value && sizeof(T) <= 4,
+                  "block codecs work on integer samples of up to 32 bits");
+
+    static const unsigned BLOCK_SIZE = 256;
+
+    // Appends one block holding values[0..n), n <= BLOCK_SIZE.
+    static void encodeBlock(const T *values, unsigned n, codec_t codec, std::vector<uint8_t> &out) {
+        U z[BLOCK_SIZE];
+        U all = 0;
+        for (unsigned i = 1; i < n; ++i) {
+            z[i] = BlockCodec<T>::zigzag((U) ((U) values[i] - (U) values[i - 1]));
+            all |= z[i];
+        }
+        int bits = 0;
+        while (bits < (int) sizeof(T) * 8 && (all >> bits)) {
+            bits++;
+        }
+        size_t pos = out.size();
+        out.resize(pos + HEADER);
+        out[pos] = (uint8_t) codec;
+        out[pos + 1] = (uint8_t) bits;
+        out[pos + 2] = (uint8_t) (n & 0xff);
+        out[pos + 3] = (uint8_t) (n >> 8);
+        U first = n ? (U) values[0] : 0;
+        for (unsigned b = 0; b < sizeof(T); ++b) {
+            out[pos + 4 + b] = (uint8_t) (first >> (8 * b));
+        }
+        if (codec == CODEC_DELTA_VARINT) {
+            for (unsigned i = 1; i < n; ++i) {
+                U v = z[i];
+                while (v >= 0x80) {
+                    out.push_back((uint8_t) (v | 0x80));
+                    v >>= 7;
+                }
+                out.push_back((uint8_t) v);
+            }
+            return;
+        }
+        size_t payload = ((size_t) (n ? n - 1 : 0) * bits + 7) / 8;
+        pos = out.size();
+        out.resize(pos + payload, 0);
+        uint64_t acc = 0;
+        int fill = 0;
+        for (unsigned i = 1; i < n; ++i) {
+            acc |= (uint64_t) z[i] << fill;
+            fill += bits;
+            while (fill >= 8) {
+                out[pos++] = (uint8_t) acc;
+                acc >>= 8;
+                fill -= 8;
+            }
+        }
+        if (fill > 0) {
+            out[pos] = (uint8_t) acc;
+        }
+    }
+
+    /*
+     * Decodes the block at p into out (room for BLOCK_SIZE values) and returns the number of
+     * values, setting next past the block. Returns 0 at end of data or on a truncated or malformed
+     * block (a bit width wider than T, a varint longer than U).
+     */
+    static unsigned decodeBlock(const uint8_t *p, const uint8_t *end, T *out, const uint8_t *&next) {
+        next = end;
+        if (end - p < HEADER) {
+            return 0;
+        }
+        int codec = p[0];
+        int bits = p[1];
+        unsigned n = (unsigned) p[2] | ((unsigned) p[3] << 8);
+        U first = 0;
+        for (unsigned b = 0; b < sizeof(T); ++b) {
+            first = (U) (first | (U) ((U) p[4 + b] << (8 * b)));
+        }
+        if (n == 0 || n > BLOCK_SIZE || bits > 8 * (int) sizeof(T)) {
+            return 0;
+        }
+        U *u = (U *) out;
+        u[0] = first;
+        const uint8_t *q = p + HEADER;
+        if (codec == CODEC_DELTA_VARINT) {
+            for (unsigned i = 1; i < n; ++i) {
+                U v = 0;
+                int shift = 0;
+                while (q < end && (*q & 0x80) && shift < 8 * (int) sizeof(U)) {
+                    v = (U) (v | (U) ((U) (*q++ & 0x7f) << shift));
+                    shift += 7;
+                }
+                if (q == end || shift >= 8 * (int) sizeof(U)) {
+                    return 0;
+                }
+                u[i] = (U) (v | (U) ((U) *q++ << shift));
+            }
+        } else {
+            size_t payload = ((size_t) (n - 1) * bits + 7) / 8;
+            if ((size_t) (end - q) < payload) {
+                return 0;
+            }
+            uint64_t mask = bits >= 64 ? ~0ULL : (1ULL << bits) - 1;
+            const uint8_t *stop = q + payload;
+            size_t bit = 0;
+            unsigned i = 1;
+            for (; i < n && bit / 8 + 8 <= payload; ++i, bit += bits) {
+                uint64_t w;
+                memcpy(&w, q + bit / 8, sizeof(w));
+                u[i] = (U) ((w >> (bit % 8)) & mask);
+            }
+            for (; i < n; ++i, bit += bits) {
+                u[i] = (U) ((BlockCodec<T>::load64(q + bit / 8, stop) >> (bit % 8)) & mask);
+            }
+            q = stop;
+        }
+        BlockCodec<T>::prefixSum(u, n);
+        next = q;
+        return n;
+    }
+
+    static std::vector<uint8_t> encode(const std::vector<T> &values, codec_t codec = CODEC_DELTA_BITPACK) {
+        std::vector<uint8_t> out;
+        for (size_t i = 0; i < values.size(); i += BLOCK_SIZE) {
+            size_t n = values.size() - i < BLOCK_SIZE ? values.size() - i : BLOCK_SIZE;
+            BlockCodec<T>::encodeBlock(values.data() + i, (unsigned) n, codec, out);
+        }
+        return out;
+    }
+
+    static std::vector<T> decode(const std::vector<uint8_t> &data) {
+        std::vector<T> values;
+        T block[BLOCK_SIZE];
+        const uint8_t *p = data.data(), *end = data.data() + data.size();
+        unsigned n;
+        while ((n = BlockCodec<T>::decodeBlock(p, end, block, p)) > 0) {
+            values.insert(values.end(), block, block + n);
+        }
+        return values;
+    }
+};
+
+// InputStream over a block-compressed buffer, decoded one block at a time as values are consumed.
+template<class T>
+class CompressedInputStream : public Operator<T> {
+private:
+    const std::vector<uint8_t> *data;
+    const uint8_t *next;
+    T block[BlockCodec<T>::BLOCK_SIZE];
+    unsigned pos;
+    unsigned len;
+
+public:
+    CompressedInputStream(int id, const std::vector<uint8_t> &data) : Operator<T>(id, OP_PASS_A, OP_IN, "input"),
+                                                                      data(&data), next(data.data()), pos(0),
+                                                                      len(0) {}
+
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new CompressedInputStream<T>(*this), newId);
+    }
+
+    void compute() override {
+        if (pos == len) {
+            pos = 0;
+            len = BlockCodec<T>::decodeBlock(next, data->data() + data->size(), block, next);
+            if (len == 0) {
+                Operator<T>::setEnd(true);
+                return;
+            }
+        }
+        Operator<T>::setVal(block[pos++]);
+    }
+
+    void reset() override {
+        Operator<T>::reset();
+        next = data->data();
+        pos = len = 0;
+    }
+
+    void saveState(StateWriter &out) const override {
+        Operator<T>::saveState(out);
+        out.put((uint64_t) (next - data->data()));
+        out.put(pos);
+        out.put(len);
+        out.write(block, len * sizeof(T));
+    }
+
+    bool loadState(StateReader &in) override {
+        uint64_t offset;
+        if (!Operator<T>::loadState(in) || !in.get(offset) || !in.get(pos) || !in.get(len) ||
+            offset > data->size() || len > BlockCodec<T>::BLOCK_SIZE || !in.read(block, len * sizeof(T))) {
+            return false;
+        }
+        next = data->data() + offset;
+        return true;
+    }
+
+    // The decoded block is counted as stream buffer, next to the compressed input.
+    void accountMemory(memory_usage_t &usage) const override {
+        Operator<T>::accountMemory(usage);
+        usage.operators += sizeof(CompressedInputStream<T>) - sizeof(Operator<T>) - sizeof(block);
+        usage.streams += sizeof(block) + data->capacity();
+    }
+
+    void setData(const std::vector<uint8_t> &d) {
+        data = &d;
+        next = d.data();
+        pos = len = 0;
+    }
+};
+
+// OutputStream that appends block-compressed values to a byte vector; flush() writes the last partial block.
+template<class T>
+class CompressedOutputStream : public Operator<T> {
+private:
+    std::vector<uint8_t> *data;
+    codec_t codec;
+    T block[BlockCodec<T>::BLOCK_SIZE];
+    unsigned len;
+
+public:
+    CompressedOutputStream(int id, std::vector<uint8_t> &data, codec_t codec = CODEC_DELTA_BITPACK)
+            : Operator<T>(id, OP_PASS_A, OP_OUT, "output"), data(&data), codec(codec), len(0) {}
+
+    Operator<T> *clone(int newId) const override {
+        return Operator<T>::detach(new CompressedOutputStream<T>(*this), newId);
+    }
+
+    void compute() override {
+        if (Operator<T>::getSrcA()) {
+            auto v = Operator<T>::getSrcA()->getVal();
+            Operator<T>::setVal(v);
+            block[len++] = v;
+            if (len == BlockCodec<T>::BLOCK_SIZE) {
+                BlockCodec<T>::encodeBlock(block, len, codec, *data);
+                len = 0;
+            }
+        }
+    }
+
+    void flush() override {
+        if (len) {
+            BlockCodec<T>::encodeBlock(block, len, codec, *data);
+            len = 0;
+        }
+    }
+
+    void reset() override {
+        Operator<T>::reset();
+        len = 0;
+    }
+
+    // The partial block is saved with the size of the encoded data; blocks encoded after the snapshot
+    // are dropped on load.
+    void saveState(StateWriter &out) const override {
+        Operator<T>::saveState(out);
+        out.put((uint64_t) data->size());
+        out.put(len);
+        out.write(block, len * sizeof(T));
+    }
+
+    bool loadState(StateReader &in) override {
+        uint64_t n;
+        if (!Operator<T>::loadState(in) || !in.get(n) || !in.get(len) || len > BlockCodec<T>::BLOCK_SIZE ||
+            !in.read(block, len * sizeof(T))) {
+            return false;
+        }
+        if (data->size() > n) {
+            data->resize(n);
+        }
+        return true;
+    }
+
+    void accountMemory(memory_usage_t &usage) const override {
+        Operator<T>::accountMemory(usage);
+        usage.operators += sizeof(CompressedOutputStream<T>) - sizeof(Operator<T>) - sizeof(block);
+        usage.streams += sizeof(block) + data->capacity();
+    }
+
+    void setData(std::vector<uint8_t> &d) {
+        data = &d;
+        len = 0;
+    }
+};
+
+#endif //STREAM_CODEC_H
@@ -0,0 +1,272 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Chrome Trace Event (chrome://tracing, ui.perfetto.dev) writer.
+ *
+ * Each thread that records events gets its own single-producer/single-consumer
+ * ring, so the recording path is a couple of relaxed loads and one release store.
+ * A background thread drains the rings and appends the JSON to the output file.
+ * When a ring is full the event is dropped and counted instead of blocking the
+ * producer. Names and categories must be string literals (only the pointer is kept).
+ */
+
+typedef struct {
+    const char *name;
+    const char *cat;
+    const char *argName;
+    long long ts;
+    long long dur;
+    long long arg;
+    char phase;
+} trace_event_t;
+
+class TraceRing {
+private:
+    std::vector<trace_event_t> events;
+    size_t mask;
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    std::atomic<unsigned long> dropped;
+    int tid;
+
+public:
+    TraceRing(int tid, size_t size) : mask(size - 1), head(0), tail(0), dropped(0), tid(tid) {
+        events.resize(size);
+    }
+
+    bool push(const trace_event_t &e) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) > mask) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        events[h & mask] = e;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(trace_event_t &e) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        e = events[t & mask];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    unsigned long getDropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    int getTid() const {
+        return tid;
+    }
+};
+
+class Tracer {
+private:
+    struct ThreadSlot {
+        unsigned long serial;
+        TraceRing *ring;
+    };
+
+    unsigned long serial;
+    unsigned long sampleEvery;
+    size_t ringSize;
+    int flushIntervalMs;
+    std::chrono::steady_clock::time_point start;
+    std::ofstream file;
+    bool firstEvent;
+    std::vector<std::unique_ptr<TraceRing>> rings;
+    std::mutex ringsMutex;
+    std::mutex flushMutex;
+    std::condition_variable flushCv;
+    std::atomic<bool> running;
+    std::thread flusher;
+
+    static unsigned long nextSerial() {
+        static std::atomic<unsigned long> s(0);
+        return ++s;
+    }
+
+    static std::vector<ThreadSlot> &slots() {
+        static thread_local std::vector<ThreadSlot> s;
+        return s;
+    }
+
+    TraceRing *ring() {
+        auto &s = Tracer::slots();
+        for (auto &slot:s) {
+            if (slot.serial == Tracer::serial) {
+                return slot.ring;
+            }
+        }
+        std::lock_guard<std::mutex> lock(Tracer::ringsMutex);
+        auto r = new TraceRing((int) Tracer::rings.size(), Tracer::ringSize);
+        Tracer::rings.emplace_back(r);
+        ThreadSlot slot = {Tracer::serial, r};
+        s.push_back(slot);
+        return r;
+    }
+
+    void writeTime(long long ns) {
+        // Chrome expects microseconds; keep the nanosecond part as three decimals.
+        char frac[4] = {(char) ('0' + ns % 1000 / 100), (char) ('0' + ns % 100 / 10), (char) ('0' + ns % 10), 0};
+        Tracer::file << ns / 1000 << "." << frac;
+    }
+
+    void writeEvent(const trace_event_t &e, int tid) {
+        Tracer::file << (Tracer::firstEvent ? "\n" : ",\n");
+        Tracer::firstEvent = false;
+        Tracer::file << R"({"name":")" << e.name << R"(","cat":")" << e.cat << R"(","ph":")" << e.phase
+                     << R"(","pid":0,"tid":)" << tid << R"(,"ts":)";
+        Tracer::writeTime(e.ts);
+        if (e.phase == 'X') {
+            Tracer::file << R"(,"dur":)";
+            Tracer::writeTime(e.dur);
+        }
+        if (e.phase == 'i') {
+            Tracer::file << R"(,"s":"t")";
+        }
+        if (e.argName) {
+            Tracer::file << R"(,"args":{")" << e.argName << R"(":)" << e.arg << "}";
+        }
+        Tracer::file << "}";
+    }
+
+    void drain() {
+        std::vector<TraceRing *> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(Tracer::ringsMutex);
+            for (auto &r:Tracer::rings) {
+                snapshot.push_back(r.get());
+            }
+        }
+        trace_event_t e;
+        for (auto r:snapshot) {
+            while (r->pop(e)) {
+                Tracer::writeEvent(e, r->getTid());
+            }
+        }
+    }
+
+    void flushLoop() {
+        std::unique_lock<std::mutex> lock(Tracer::flushMutex);
+        while (Tracer::running.load()) {
+            Tracer::flushCv.wait_for(lock, std::chrono::milliseconds(Tracer::flushIntervalMs));
+            Tracer::drain();
+        }
+    }
+
+public:
+    /*
+     * sampleEvery: only every Nth compute() cycle is traced (build events are always kept).
+     * ringSize: events buffered per thread between flushes, rounded up to a power of two.
+     */
+    explicit Tracer(const std::string &fileNamePath, unsigned long sampleEvery = 1, size_t ringSize = 1 << 16,
+                    int flushIntervalMs = 50) : serial(Tracer::nextSerial()),
+                                                sampleEvery(sampleEvery ? sampleEvery : 1),
+                                                ringSize(1), flushIntervalMs(flushIntervalMs),
+                                                start(std::chrono::steady_clock::now()), firstEvent(true),
+                                                running(true) {
+        while (Tracer::ringSize < ringSize) {
+            Tracer::ringSize <<= 1;
+        }
+        Tracer::file.open(fileNamePath);
+        Tracer::file << R"({"displayTimeUnit":"ms","traceEvents":[)";
+        Tracer::flusher = std::thread(&Tracer::flushLoop, this);
+    }
+
+    ~Tracer() {
+        Tracer::stop();
+    }
+
+    Tracer(const Tracer &) = delete;
+
+    Tracer &operator=(const Tracer &) = delete;
+
+    bool sampleCycle(unsigned long cycle) const {
+        return cycle % Tracer::sampleEvery == 0;
+    }
+
+    long long now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - Tracer::start).count();
+    }
+
+    void complete(const char *name, const char *cat, long long ts, long long dur, const char *argName = nullptr,
+                  long long arg = 0) {
+        trace_event_t e = {name, cat, argName, ts, dur, arg, 'X'};
+        Tracer::ring()->push(e);
+    }
+
+    void instant(const char *name, const char *cat, const char *argName = nullptr, long long arg = 0) {
+        trace_event_t e = {name, cat, argName, Tracer::now(), 0, arg, 'i'};
+        Tracer::ring()->push(e);
+    }
+
+    void counter(const char *name, const char *cat, const char *argName, long long value) {
+        trace_event_t e = {name, cat, argName, Tracer::now(), 0, value, 'C'};
+        Tracer::ring()->push(e);
+    }
+
+    unsigned long getDropped() {
+        std::lock_guard<std::mutex> lock(Tracer::ringsMutex);
+        unsigned long d = 0;
+        for (auto &r:Tracer::rings) {
+            d += r->getDropped();
+        }
+        return d;
+    }
+
+    unsigned long getSampleEvery() const {
+        return sampleEvery;
+    }
+
+    // Stops the flusher, drains what is left and closes the JSON document. Idempotent.
+    void stop() {
+        if (!Tracer::running.exchange(false)) {
+            return;
+        }
+        Tracer::flushCv.notify_all();
+        Tracer::flusher.join();
+        Tracer::drain();
+        Tracer::file << "\n]," << R"("otherData":{"dropped":)" << Tracer::getDropped() << "}}";
+        Tracer::file.close();
+    }
+};
+
+// Records a complete ('X') event for the lifetime of the scope; a null tracer makes it a no-op.
+class TraceScope {
+private:
+    Tracer *tracer;
+    const char *name;
+    const char *cat;
+    const char *argName;
+    long long arg;
+    long long ts;
+
+public:
+    TraceScope(Tracer *tracer, const char *name, const char *cat, const char *argName = nullptr, long long arg = 0)
+            : tracer(tracer), name(name), cat(cat), argName(argName), arg(arg), ts(tracer ? tracer->now() : 0) {}
+
+    ~TraceScope() {
+        if (tracer) {
+            tracer->complete(name, cat, ts, tracer->now() - ts, argName, arg);
+        }
+    }
+};
+
+#endif //TRACER_H
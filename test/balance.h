@@ -0,0 +1,93 @@
+#ifndef MAIN_BALANCE_H
+#define MAIN_BALANCE_H
+
+#include <schedule.h>
+#include "check.h"
+#include "fir.h"
+
+/*
+ * Per copy: x * 5 on a 3-cycle multiplier added to x itself and, through a shift, to x - 2,
+ * so the unmultiplied paths reach the adds early and need balancing registers.
+ */
+DataFlow<int> *unbalanced(int copies, std::vector<int> *data_in, std::vector<int> *data_out) {
+    auto df = new DataFlow<int>(0, "unbalanced");
+    int idx = 0;
+    for (int j = 0; j < copies; ++j) {
+        auto in = new InputStream<int>(idx++, data_in[j]);
+        auto m = new Multi<int>(idx++, 5);
+        auto sum = new Add<int>(idx++);
+        auto low = new Subi<int>(idx++, 2);
+        auto shift = new Shli<int>(idx++, 1);
+        auto total = new Add<int>(idx++);
+        df->connect(in, m, PORT_A);
+        df->connect(m, sum, PORT_A);
+        df->connect(in, sum, PORT_B);
+        df->connect(in, low, PORT_A);
+        df->connect(low, shift, PORT_A);
+        df->connect(sum, total, PORT_A);
+        df->connect(shift, total, PORT_B);
+        df->connect(total, new OutputStream<int>(idx++, data_out[j]), PORT_A);
+    }
+    return df;
+}
+
+// Inserts the registers of the list schedule under units; true if outputs are unchanged and the graph is balanced.
+template<class T>
+bool balancedMatches(DataFlow<T> *df, std::vector<T> *data_in, std::vector<T> *plain, std::vector<T> *balanced,
+                     const int units[FU_NUM_TYPES], long &inserted) {
+    df->reset();
+    df->compute();
+    int ops = df->getNumOp();
+    ScheduleAnalysis<T> sa(*df);
+    sa.setLatency(FU_MULT, 3);
+    bool ok = sa.analyze();
+    sa.listSchedule(units);
+    long registers = sa.getNumBalancingRegisters();
+    inserted = sa.insertBalancingRegisters();
+    df->rebind(data_in, balanced);
+    df->reset();
+    df->compute();
+    int copies = df->getNumOpIn();
+    for (int j = 0; j < copies; ++j) {
+        ok = ok && !plain[j].empty() && balanced[j] == plain[j];
+    }
+    return ok && inserted == registers && df->getNumOp() == ops + inserted;
+}
+
+void run_balance() {
+    const int unlimited[FU_NUM_TYPES] = {0, 0, 0, 0, 0};
+    std::vector<int> data_in[4], plain[4], balanced[4];
+    for (int j = 0; j < 4; ++j) {
+        for (int i = 0; i < 100; ++i) {
+            data_in[j].push_back(i * (j + 1) - 50);
+        }
+    }
+    auto df = unbalanced(4, data_in, plain);
+    long inserted = 0;
+    bool same = balancedMatches(df, data_in, plain, balanced, unlimited, inserted);
+    ScheduleAnalysis<int> after(*df);
+    after.setLatency(FU_MULT, 3);
+    after.analyze();
+    after.listSchedule(unlimited);
+    check(same && inserted > 0 && after.getNumBalancingRegisters() == 0,
+          "balance: registers on the short paths leave the outputs unchanged");
+    delete df;
+
+    // Two ALUs and one multiplier for a 6-tap FIR: the schedule, not the graph, delays the adds.
+    typedef unsigned short T;
+    const int scarce[FU_NUM_TYPES] = {2, 1, 1, 1, 2};
+    T coef[6] = {1, 2, 3, 4, 5, 6};
+    std::vector<T> fir_in[2], fir_plain[2], fir_balanced[2];
+    for (int j = 0; j < 2; ++j) {
+        for (int i = 0; i < 100; ++i) {
+            fir_in[j].push_back((T) (i * (j + 3) % 71));
+        }
+    }
+    auto fir = FIR(0, 2, coef, 6, fir_in, fir_plain);
+    check(balancedMatches(fir, fir_in, fir_plain, fir_balanced, scarce, inserted) && inserted > 0,
+          "balance: registers of a resource-constrained schedule leave the outputs unchanged");
+    delete fir;
+    std::cout << std::endl;
+}
+
+#endif //MAIN_BALANCE_H
@@ -0,0 +1,28 @@
+#ifndef MAIN_CHECK_H
+#define MAIN_CHECK_H
+
+#include <iostream>
+#include <vector>
+
+static int check_failures = 0;
+
+// Prints one line per check; main() returns non-zero when any of them failed.
+inline void check(bool ok, const char *what) {
+    std::cout << (ok ? "ok   " : "FAIL ") << what << std::endl;
+    if (!ok) {
+        check_failures++;
+    }
+}
+
+template<class T>
+std::vector<int> outputIds(DataFlow<T> *df) {
+    std::vector<int> ids;
+    for (auto item:df->getOpArray()) {
+        if (item.second->getType() == OP_OUT) {
+            ids.push_back(item.first);
+        }
+    }
+    return ids;
+}
+
+#endif //MAIN_CHECK_H
@@ -0,0 +1,78 @@
+#ifndef MAIN_CODEC_H
+#define MAIN_CODEC_H
+
+#include <cstdlib>
+#include <data_flow.h>
+#include <stream_codec.h>
+#include "check.h"
+#include "fir.h"
+
+// Round trip of both codecs over lengths around the block size, with steps up to the full range of T.
+template<class T>
+bool codecRoundTrip(unsigned seed) {
+    const size_t lengths[6] = {0, 1, 255, 256, 257, 1000};
+    const codec_t codecs[2] = {CODEC_DELTA_BITPACK, CODEC_DELTA_VARINT};
+    srand(seed);
+    for (size_t n:lengths) {
+        std::vector<T> x(n);
+        for (size_t i = 0; i < n; ++i) {
+            x[i] = (T) (i % 100 < 50 ? (i ? x[i - 1] : 0) + rand() % 9 - 4 : (unsigned) rand() * 65599u);
+        }
+        for (codec_t c:codecs) {
+            if (BlockCodec<T>::decode(BlockCodec<T>::encode(x, c)) != x) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void run_codec() {
+    check(codecRoundTrip<unsigned short>(1) && codecRoundTrip<short>(2) && codecRoundTrip<int>(3) &&
+          codecRoundTrip<unsigned char>(4), "codec: both codecs round-trip every width");
+
+    // Headers: codec, bits, count (2 bytes), first value of T; then the deltas.
+    typedef unsigned short T;
+    std::vector<uint8_t> longVarint = {CODEC_DELTA_VARINT, 0, 2, 0, 7, 0, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01};
+    std::vector<uint8_t> wideBits = {CODEC_DELTA_BITPACK, 40, 2, 0, 7, 0, 1, 2, 3, 4, 5};
+    check(BlockCodec<T>::decode(longVarint).empty() && BlockCodec<T>::decode(wideBits).empty(),
+          "codec: a varint longer than T and a bit width wider than T are refused");
+
+    // FIR() with its output swapped for a compressed one decodes to the plain output.
+    std::vector<T> data_in[1];
+    for (int i = 0; i < 600; ++i) {
+        data_in[0].push_back((T) (i * 37 % 1000));
+    }
+    T coef[4] = {1, 2, 3, 4};
+    std::vector<T> raw_out[1], out[1];
+    auto raw = FIR(0, 1, coef, 4, data_in, raw_out);
+    raw->reset();
+    raw->compute();
+    delete raw;
+
+    std::vector<uint8_t> enc;
+    auto df = FIR(0, 1, coef, 4, data_in, out);
+    delete df->replaceSink(outputIds(df)[0], new CompressedOutputStream<T>(1, enc, CODEC_DELTA_VARINT));
+    df->reset();
+    df->compute();
+    check(!raw_out[0].empty() && BlockCodec<T>::decode(enc) == raw_out[0],
+          "codec: a compressed FIR output decodes to the plain one");
+    delete df;
+
+    // A compressed input fed through addi gives the same values as the raw input.
+    auto encIn = BlockCodec<T>::encode(data_in[0]);
+    std::vector<T> addOut;
+    DataFlow<T> packed(0, "packed");
+    packed.connect(new CompressedInputStream<T>(0, encIn), new Addi<T>(1, 1), PORT_A);
+    packed.connect(packed.getOp(1), new OutputStream<T>(2, addOut), PORT_A);
+    packed.reset();
+    packed.compute();
+    bool same = addOut.size() == data_in[0].size();
+    for (size_t i = 0; same && i < addOut.size(); ++i) {
+        same = addOut[i] == (T) (data_in[0][i] + 1);
+    }
+    check(same, "codec: a compressed input streams the encoded values");
+    std::cout << std::endl;
+}
+
+#endif //MAIN_CODEC_H
@@ -11,40 +11,36 @@ template<class T>
 DataFlow<T> *FIR(int id, int copies, T *coef, int taps, std::vector<T> *data_in, std::vector<T> *data_out) {
     auto df = new DataFlow<T>(id, "fir");
     int idx = 0;
-    std::vector<Operator<T> *> in_cp;
-    std::vector<Operator<T> *> out_cp;
-
-    in_cp.reserve(copies);
-    for (int j = 0; j < copies; ++j) {
-        in_cp.push_back(new InputStream<T>(idx++, data_in[j]));
+    auto in = new InputStream<T>(idx++, data_in[0]);
+    auto out = new OutputStream<T>(idx++, data_out[0]);
+    Operator<T> *op, *op1, *op2;
+    std::vector<Operator<T> *> add;
+    add.reserve((unsigned long) taps - 1);
+    for (int i = 0; i < taps; ++i) {
+        auto m = new Multi<T>(idx++, coef[taps - i - 1]);
+        if (i == 0) {
+            op = new PassA<T>(idx++);
+        } else {
+            op = new Add<T>(idx++);
+        }
+        add.push_back(op);
+        df->connect(in, m, PORT_A);
+        df->connect(m, op, PORT_A);
     }
-    out_cp.reserve(copies);
-    for (int j = 0; j < copies; ++j) {
-        out_cp.push_back(new OutputStream<T>(idx++, data_out[j]));
+    for (int i = 0; i < taps - 1; ++i) {
+        op1 = add[i];
+        op2 = add[i + 1];
+        df->connect(op1, op2, PORT_B);
     }
-    for (int j = 0; j < copies; ++j) {
-        Operator<T> *op, *op1, *op2;
-        std::vector<Operator<T> *> add;
-        add.reserve((unsigned long) taps - 1);
-        for (int i = 0; i < taps; ++i) {
-            auto m = new Multi<T>(idx++, coef[taps - i - 1]);
-            if (i == 0) {
-                op = new PassA<T>(idx++);
-            } else {
-                op = new Add<T>(idx++);
-            }
-            add.push_back(op);
-            df->connect(in_cp[j], m, PORT_A);
-            df->connect(m, op, PORT_A);
-        }
-        for (int i = 0; i < taps - 1; ++i) {
-            op1 = add[i];
-            op2 = add[i + 1];
-            df->connect(op1, op2, PORT_B);
-        }
-        op1 = add[taps - 1];
-        df->connect(op1, out_cp[j], PORT_A);
+    op1 = add[taps - 1];
+    df->connect(op1, out, PORT_A);
+
+    // The other copies are stamped out from the first one.
+    std::vector<int> first;
+    for (auto item:df->getOpArray()) {
+        first.push_back(item.first);
     }
+    df->replicate(first, copies - 1, data_in + 1, data_out + 1);
     return df;
 }
 
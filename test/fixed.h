@@ -0,0 +1,50 @@
+#ifndef MAIN_FIXED_H
+#define MAIN_FIXED_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <fixed_point.h>
+#include "check.h"
+
+void run_fixed() {
+    const q15_t min = q15_t::fromRaw(INT16_MIN), max = q15_t::fromRaw(INT16_MAX);
+    // -1 * -1 is +1, which Q15 cannot hold; -1 * (1 - 2^-15) is exact.
+    check((min * min).getRaw() == INT16_MAX && (min * max).getRaw() == -INT16_MAX &&
+          (q15_t(0.5) * q15_t::fromRaw(3)).getRaw() == 2 && (q15_t(-0.5) * q15_t::fromRaw(3)).getRaw() == -1 &&
+          (q7_t::fromRaw(INT8_MIN) * q7_t::fromRaw(INT8_MIN)).getRaw() == INT8_MAX,
+          "fixed: products of the most negative value saturate and round");
+    check((max + max).getRaw() == INT16_MAX && (min - max).getRaw() == INT16_MIN && abs(min) == max &&
+          (sat16_t(30000) + sat16_t(30000)).getRaw() == INT16_MAX, "fixed: sums and abs saturate");
+
+    typedef Fixed<4, int16_t> q4_t;
+    check(q15_t(0.5).getRaw() == 16384 && q4_t(1.03125).getRaw() == 17 && q4_t(-1.03125).getRaw() == -17 &&
+          q4_t(0.03).getRaw() == 0 && q15_t(1.0).getRaw() == INT16_MAX && q15_t(-1.0).getRaw() == INT16_MIN &&
+          q15_t(-2.5).getRaw() == INT16_MIN, "fixed: Fixed(double) rounds halves away from zero and saturates");
+
+    // 8-lane kernels against the scalar operators, with a tail of 3 values past the last full block.
+    const size_t n = 19;
+    q15_t a[n], b[n], sum[n], product[n], scaled[n];
+    srand(5);
+    for (size_t i = 0; i < n; ++i) {
+        a[i] = q15_t::fromRaw((int16_t) (rand() % 65536 - 32768));
+        b[i] = q15_t::fromRaw((int16_t) (rand() % 65536 - 32768));
+    }
+    a[0] = b[0] = min;
+    a[1] = min;
+    b[1] = max;
+    a[2] = b[2] = max;
+    a[n - 1] = b[n - 1] = min;
+    a[n - 2] = b[n - 2] = max;
+    addSat(a, b, sum, n);
+    mulFixed(a, b, product, n);
+    mulFixedConst(a, min, scaled, n);
+    bool same = true;
+    for (size_t i = 0; i < n; ++i) {
+        same = same && sum[i] == a[i] + b[i] && product[i] == a[i] * b[i] && scaled[i] == a[i] * min;
+    }
+    check(same && sum[n - 1] == min && sum[n - 2] == max && product[0] == max && scaled[n - 1] == max,
+          "fixed: block kernels match the scalar operators, tail included");
+    std::cout << std::endl;
+}
+
+#endif //MAIN_FIXED_H
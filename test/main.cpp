@@ -2,8 +2,26 @@
 // Created by lucas on 06/02/2020.
 //
 
+#include "balance.h"
 #include "chebyshev.h"
+#include "codec.h"
 #include "fir.h"
+#include "fixed.h"
+#include "merge.h"
+#include "multirate.h"
+#include "native.h"
+#include "packed.h"
+#include "perf.h"
+#include "plan.h"
+#include "probes.h"
+#include "replicate.h"
+#include "rerun.h"
+#include "runtime.h"
+#include "resume.h"
+#include "seal.h"
+#include "sinks.h"
+#include "split.h"
+#include "trace.h"
 
 using namespace std;
 
@@ -11,6 +29,24 @@ int main() {
 
     run_fir();
     run_chebyshev();
+    run_sinks();
+    run_replicate();
+    run_rerun();
+    run_codec();
+    run_multirate();
+    run_seal();
+    run_packed();
+    run_native();
+    run_plan_cache();
+    run_checkpoint();
+    run_split();
+    run_trace();
+    run_perf();
+    run_runtime_stats();
+    run_probes();
+    run_merge();
+    run_fixed();
+    run_balance();
 
-    return 0;
+    return check_failures ? 1 : 0;
 }
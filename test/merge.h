@@ -0,0 +1,108 @@
+#ifndef MAIN_MERGE_H
+#define MAIN_MERGE_H
+
+#include <thread>
+#include <data_flow.h>
+#include <graph_builder.h>
+#include "check.h"
+
+/*
+ * Copy j of a chain of FIR filters on its own builder: taps multiply-accumulate stages, then a
+ * mix that adds the mix of copy j - 1 (an edge from the previous builder) before the output.
+ */
+template<class T>
+void chainedCopy(std::vector<GraphBuilder<T>> &builders, int j, int taps, std::vector<T> *data_in,
+                 std::vector<T> *data_out) {
+    auto &b = builders[j];
+    int in = b.add(new InputStream<T>(0, data_in[j]));
+    int out = b.add(new OutputStream<T>(0, data_out[j]));
+    int prev = -1;
+    for (int i = 0; i < taps; ++i) {
+        int m = b.add(new Multi<T>(0, (T) (i + j + 1)));
+        int op = b.add(i == 0 ? (Operator<T> *) new PassA<T>(0) : (Operator<T> *) new Add<T>(0));
+        b.link(in, m, PORT_A);
+        b.link(m, op, PORT_A);
+        if (prev >= 0) {
+            b.link(prev, op, PORT_B);
+        }
+        prev = op;
+    }
+    int mix = b.add(j == 0 ? (Operator<T> *) new PassA<T>(0) : (Operator<T> *) new Add<T>(0));
+    b.link(prev, mix, PORT_A);
+    if (j > 0) {
+        // Index of the mix of every copy; copy j - 1 may still be filling on another thread.
+        b.linkFrom(j - 1, 2 + 2 * taps, mix, PORT_B);
+    }
+    b.link(mix, out, PORT_A);
+}
+
+void run_merge() {
+    typedef unsigned short T;
+    const int copies = 12;
+    const int taps = 5;
+    std::vector<T> data_in[copies], serial_out[copies], merged_out[copies];
+    for (int j = 0; j < copies; ++j) {
+        for (int i = 0; i < 200; ++i) {
+            data_in[j].push_back((T) (i * (j + 1) % 251));
+        }
+    }
+
+    // The reference: the same operators and ids, linked one edge at a time and leveled serially.
+    std::vector<GraphBuilder<T>> parts(copies);
+    for (int j = 0; j < copies; ++j) {
+        chainedCopy(parts, j, taps, data_in, serial_out);
+    }
+    DataFlow<T> serial(0, "serial");
+    int size = parts[0].size();
+    for (int j = 0; j < copies; ++j) {
+        for (int i = 0; i < size; ++i) {
+            parts[j].getOp(i)->setId(j * size + i);
+        }
+    }
+    for (int j = 0; j < copies; ++j) {
+        for (auto &e:parts[j].getEdges()) {
+            serial.link(parts[e.srcBuilder < 0 ? j : e.srcBuilder].getOp(e.src), parts[j].getOp(e.dst), e.port);
+        }
+    }
+    serial.updateOpLevel();
+
+    // Builders filled on three threads, each taking every third copy, then merged on three threads.
+    std::vector<GraphBuilder<T>> builders(copies);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 3; ++t) {
+        workers.emplace_back([&, t]() {
+            for (int j = t; j < copies; j += 3) {
+                chainedCopy(builders, j, taps, data_in, merged_out);
+            }
+        });
+    }
+    for (auto &w:workers) {
+        w.join();
+    }
+    std::vector<GraphBuilder<T> *> list;
+    for (auto &b:builders) {
+        list.push_back(&b);
+    }
+    DataFlow<T> merged(0, "merged");
+    int first = merged.merge(list, 3);
+    bool same = first == 0 && merged.getNumOp() == serial.getNumOp() && merged.getNumEdges() == serial.getNumEdges() &&
+                merged.getMaxLevel() == serial.getMaxLevel() && serial.getMaxLevel() > taps + copies - 1;
+    for (auto item:serial.getOpArray()) {
+        auto op = merged.getOp(item.first);
+        same = same && op && op->getLevel() == item.second->getLevel() && op->getLabel() == item.second->getLabel();
+    }
+    check(same, "merge: builders filled and merged on threads level like the serial graph");
+
+    serial.reset();
+    serial.compute();
+    merged.reset();
+    merged.compute();
+    bool outputs = true;
+    for (int j = 0; j < copies; ++j) {
+        outputs = outputs && serial_out[j].size() == data_in[j].size() && merged_out[j] == serial_out[j];
+    }
+    check(outputs, "merge: the merged graph computes the outputs of the serial one");
+    std::cout << std::endl;
+}
+
+#endif //MAIN_MERGE_H
@@ -0,0 +1,71 @@
+#ifndef MAIN_MULTIRATE_H
+#define MAIN_MULTIRATE_H
+
+#include <data_flow.h>
+#include "check.h"
+#include "fir.h"
+
+// in -> op -> out, leveled; op decides the rate.
+template<class T>
+DataFlow<T> *rateGraph(Operator<T> *op, std::vector<T> &data_in, std::vector<T> &data_out) {
+    auto df = new DataFlow<T>(0, "rate");
+    df->connect(new InputStream<T>(0, data_in), op, PORT_A);
+    df->connect(op, new OutputStream<T>(2, data_out), PORT_A);
+    return df;
+}
+
+void run_multirate() {
+    typedef unsigned short T;
+    std::vector<T> data_in[1];
+    for (T i = 1; i <= 12; ++i) {
+        data_in[0].push_back(i);
+    }
+
+    std::vector<T> down;
+    auto df = rateGraph<T>(new Downsample<T>(1, 3), data_in[0], down);
+    df->reset();
+    df->compute();
+    check(down == std::vector<T>({1, 4, 7, 10}), "multirate: Downsample(3) keeps every third value");
+    delete df;
+
+    std::vector<T> up;
+    df = rateGraph<T>(new Upsample<T>(1, 2), data_in[0], up);
+    df->reset();
+    df->compute();
+    std::vector<T> expected;
+    for (auto v:data_in[0]) {
+        expected.push_back(v);
+        expected.push_back(0);
+    }
+    check(up == expected, "multirate: Upsample(2) inserts a zero after every value");
+    delete df;
+
+    // A decimator appended to FIR() keeps every k-th output, also after the graph grows between runs.
+    T coef[4] = {1, 2, 3, 4};
+    std::vector<T> fir_out[1], run_out[1], dec_out;
+    auto ref = FIR(0, 1, coef, 4, data_in, fir_out);
+    ref->reset();
+    ref->compute();
+    delete ref;
+    df = FIR(0, 1, coef, 4, data_in, run_out);
+    df->reset();
+    df->compute();
+    bool same = run_out[0] == fir_out[0];
+    run_out[0].clear();
+    auto decimator = new Downsample<T>(100, 4);
+    df->link(df->getOp(outputIds(df)[0])->getSrcA(), decimator, PORT_A);
+    df->link(decimator, new OutputStream<T>(101, dec_out), PORT_A);
+    df->updateOpLevel();
+    df->reset();
+    df->compute();
+    std::vector<T> every4;
+    for (size_t i = 0; i < fir_out[0].size(); i += 4) {
+        every4.push_back(fir_out[0][i]);
+    }
+    check(same && run_out[0] == fir_out[0] && dec_out == every4,
+          "multirate: a Downsample(4) added to FIR() between runs decimates its output");
+    delete df;
+    std::cout << std::endl;
+}
+
+#endif //MAIN_MULTIRATE_H
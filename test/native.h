@@ -0,0 +1,95 @@
+#ifndef MAIN_NATIVE_H
+#define MAIN_NATIVE_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <native_kernel.h>
+#include "check.h"
+#include "chebyshev.h"
+#include "packed.h"
+
+// Takes the opcode and label of Add but computes the mean, so no backend may treat it as an Add.
+template<class T>
+class Mean : public Operator<T> {
+public:
+    explicit Mean(int id) : Operator<T>(id, OP_ADD, OP_BASIC, "add") {}
+
+    void compute() override {
+        if (Operator<T>::getSrcA() && Operator<T>::getSrcB()) {
+            Operator<T>::setVal((Operator<T>::getSrcA()->getVal() + Operator<T>::getSrcB()->getVal()) / 2);
+        }
+    }
+};
+
+// Removes the source, log and object load() left for the kernel at path (".../dataflow_<hash>.so").
+inline void removeKernel(const std::string &path) {
+    std::string base = path.substr(0, path.size() - 3);
+    remove((base + ".cpp").c_str());
+    remove((base + ".log").c_str());
+    remove(path.c_str());
+}
+
+// Compiles df into dir and runs it; true if it matched compute() and only the second load hit the cache.
+template<class T>
+bool nativeMatches(const std::string &dir, DataFlow<T> *df, std::vector<T> *data_in, std::vector<T> *data_out) {
+    std::vector<T> native[1];
+    df->reset();
+    df->compute();
+    unsigned long cycles = df->getNumCycles();
+    df->rebind(data_in, native);
+    NativeKernel<T> kernel(dir);
+    bool ok = kernel.load(*df) && !kernel.isCached();
+    kernel.compute();
+    NativeKernel<T> again(dir);
+    ok = ok && again.load(*df) && again.isCached() && native[0] == data_out[0] && kernel.getNumCycles() == cycles;
+    removeKernel(kernel.getPath());
+    return ok;
+}
+
+void run_native() {
+    char tmp[] = "/tmp/dataflow_native_XXXXXX";
+    std::string dir = mkdtemp(tmp) ? tmp : ".";
+    typedef unsigned short T;
+    std::vector<T> cheb_in[1] = {{1, 2, 3, 4, 5, 6, 7, 8, 9, 10}};
+    std::vector<T> cheb_out[1];
+    auto cheb = chebyshev(0, 1, cheb_in, cheb_out);
+    check(nativeMatches(dir, cheb, cheb_in, cheb_out), "native: chebyshev compiles to the outputs of compute()");
+    delete cheb;
+
+    std::vector<int> data_in[1], data_out[1];
+    for (int i = 0; i < 300; ++i) {
+        data_in[0].push_back((i * 29) & 0xff);
+    }
+    auto clip = clipper(data_in[0], data_out[0]);
+    check(nativeMatches(dir, clip, data_in, data_out),
+          "native: predicates and a mux compile to the outputs of compute()");
+    delete clip;
+
+    std::vector<int> out;
+    DataFlow<int> df(0, "mean");
+    auto in = new InputStream<int>(0, data_in[0]);
+    auto mean = new Mean<int>(1);
+    df.link(in, mean, PORT_A);
+    df.link(in, mean, PORT_B);
+    df.link(mean, new OutputStream<int>(2, out), PORT_A);
+    df.updateOpLevel();
+    NativeKernel<int> kernel(dir);
+    check(!kernel.load(df) && !kernel.isLoaded() && !kernel.getError().empty(),
+          "native: an operator reusing the opcode and label of Add is refused");
+
+    std::vector<float> float_in[1] = {{-1.5f, 2.25f, -0.75f, 3.0f}};
+    std::vector<float> float_out[1];
+    DataFlow<float> rectify(0, "rectify");
+    auto x = new InputStream<float>(0, float_in[0]);
+    auto abs = new Abs<float>(1);
+    rectify.link(x, abs, PORT_A);
+    rectify.link(abs, new OutputStream<float>(2, float_out[0]), PORT_A);
+    rectify.updateOpLevel();
+    check(nativeMatches(dir, &rectify, float_in, float_out) && float_out[0][2] == 0.75f,
+          "native: abs of a float keeps its fraction");
+    rmdir(dir.c_str());
+    std::cout << std::endl;
+}
+
+#endif //MAIN_NATIVE_H
@@ -0,0 +1,88 @@
+#ifndef MAIN_PACKED_H
+#define MAIN_PACKED_H
+
+#include <bit_width.h>
+#include "check.h"
+#include "chebyshev.h"
+
+// Signed samples centred, rectified and clipped: 1-bit predicates, 8/16-bit lanes and a mux.
+DataFlow<int> *clipper(std::vector<int> &data_in, std::vector<int> &data_out) {
+    auto df = new DataFlow<int>(0, "clipper");
+    auto in = new InputStream<int>(0, data_in);
+    auto centred = new Subi<int>(1, 128);
+    auto rect = new Abs<int>(2);
+    auto loud = new Sgti<int>(3, 100);
+    auto gain = new Multi<int>(4, 300);
+    auto clip = new Muxi<int>(5, 0);
+    auto sum = new Add<int>(6);
+    df->link(in, centred, PORT_A);
+    df->link(centred, rect, PORT_A);
+    df->link(rect, loud, PORT_A);
+    df->link(rect, gain, PORT_A);
+    df->link(gain, clip, PORT_A);
+    df->link(loud, clip, PORT_BRANCH);
+    df->link(clip, sum, PORT_A);
+    df->link(centred, sum, PORT_B);
+    df->link(sum, new OutputStream<int>(7, data_out), PORT_A);
+    df->updateOpLevel();
+    return df;
+}
+
+void run_packed() {
+    std::vector<int> data_in[1], plain[1], packed[1];
+    for (int i = 0; i < 500; ++i) {
+        data_in[0].push_back((i * 53) & 0xff);
+    }
+    auto df = clipper(data_in[0], plain[0]);
+    df->reset();
+    df->compute();
+    unsigned long cycles = df->getNumCycles();
+    df->rebind(data_in, packed);
+    df->seal();
+    WidthAnalysis<int> widths;
+    widths.analyze(*df);
+    PackedExecutor<int> exec(*df, widths);
+    exec.compute();
+    check(exec.isSupported() && !exec.usedFallback() && widths.getCount(W_BIT) == 1 && packed[0] == plain[0] &&
+          exec.getNumCycles() == cycles, "packed: mixed-width lanes compute the same outputs as compute()");
+    check(exec.getValueBytes() < widths.getUniformBytes() && df->getOp(6)->getVal() == plain[0].back(),
+          "packed: values take fewer bytes and operators get their final values back");
+
+    // The executor follows a rebind() made after it was built.
+    std::vector<int> again[1];
+    df->rebind(data_in, again);
+    exec.compute();
+    check(!exec.usedFallback() && again[0] == plain[0] && packed[0].size() == plain[0].size(),
+          "packed: outputs rebound after construction get the values");
+
+    // Inputs past the analyzed range run through compute() instead of wrapping in their lanes.
+    std::vector<int> loud_in[1], loud_plain[1], loud_packed[1];
+    for (int i = 0; i < 50; ++i) {
+        loud_in[0].push_back(i * 1000);
+    }
+    df->rebind(loud_in, loud_plain);
+    df->compute();
+    df->rebind(loud_in, loud_packed);
+    exec.compute();
+    check(exec.usedFallback() && loud_packed[0] == loud_plain[0],
+          "packed: inputs outside their analyzed range fall back to compute()");
+    delete df;
+
+    typedef unsigned short T;
+    std::vector<T> cheb_in[1] = {{1, 2, 3, 4, 5, 6, 7, 8, 9, 10}};
+    std::vector<T> cheb_plain[1], cheb_packed[1];
+    auto cheb = chebyshev(0, 1, cheb_in, cheb_plain);
+    cheb->reset();
+    cheb->compute();
+    cheb->rebind(cheb_in, cheb_packed);
+    WidthAnalysis<T> chebWidths;
+    chebWidths.analyze(*cheb);
+    PackedExecutor<T> unsealed(*cheb, chebWidths);
+    unsealed.compute();
+    check(!unsealed.isSupported() && cheb_packed[0] == cheb_plain[0],
+          "packed: an unsealed graph falls back to compute()");
+    delete cheb;
+    std::cout << std::endl;
+}
+
+#endif //MAIN_PACKED_H
@@ -0,0 +1,61 @@
+#ifndef MAIN_PERF_H
+#define MAIN_PERF_H
+
+#include <sstream>
+#include <string>
+#include <data_flow.h>
+#include <perf_counters.h>
+#include "check.h"
+#include "chebyshev.h"
+
+// Three chebyshev() copies over 500 samples: every operator fires in the 500 cycles that carry a
+// sample, and only the three inputs fire in the cycle that finds them at their end.
+void run_perf() {
+    typedef unsigned short T;
+    std::vector<T> data_in[3], plain[3], counted[3], again[3];
+    for (int j = 0; j < 3; ++j) {
+        for (int i = 0; i < 500; ++i) {
+            data_in[j].push_back((T) (i * (j + 5) % 89));
+        }
+    }
+    auto df = chebyshev(0, 3, data_in, plain);
+    df->reset();
+    df->compute();
+    unsigned long cycles = df->getNumCycles();
+    unsigned long executed = (cycles - 1) * df->getNumOp() + df->getNumOpIn();
+
+    PerfCounterGroup group;
+    df->rebind(data_in, counted);
+    df->setPerfCounters(&group, true);
+    df->compute();
+    PerfReport perLevel = df->getPerfReport();
+    check(executed == 24003 && perLevel.getFirings() == executed && !perLevel.isEstimated() &&
+          perLevel.getTokens() == 1500, "perf: per-level profiling counts the firings actually executed");
+
+    bool same = true;
+    for (int j = 0; j < 3; ++j) {
+        same = same && counted[j] == plain[j];
+    }
+    check(same, "perf: counted runs compute the same outputs");
+
+    df->setPerfCounters(&group);
+    df->rebind(data_in, again);
+    df->compute();
+    PerfReport estimated = df->getPerfReport();
+    std::ostringstream text;
+    estimated.print(text);
+    bool printed = group.isAvailable() ? text.str().find("estimated, not counted") != std::string::npos :
+                   !group.getError().empty() && text.str() == "perf counters unavailable: " + group.getError() + "\n";
+    check(estimated.isEstimated() && estimated.getFirings() == cycles * df->getNumOp() && printed,
+          "perf: without per-level profiling firings are estimated as cycles x operators");
+
+    std::ostringstream none;
+    PerfReport(nullptr, perfSampleZero(), 0, 0, true).print(none);
+    check(none.str() == "perf counters unavailable: no counter group\n", "perf: a report without a group says so");
+
+    df->setPerfCounters(nullptr);
+    delete df;
+    std::cout << std::endl;
+}
+
+#endif //MAIN_PERF_H
@@ -0,0 +1,75 @@
+#ifndef MAIN_PLAN_H
+#define MAIN_PLAN_H
+
+#include <cstdio>
+#include <data_flow.h>
+#include <plan_cache.h>
+#include "check.h"
+#include "chebyshev.h"
+#include "fir.h"
+
+template<class T>
+std::vector<int> levelsOf(DataFlow<T> *df) {
+    std::vector<int> levels;
+    for (auto item:df->getOpArray()) {
+        levels.push_back(item.second->getLevel());
+    }
+    return levels;
+}
+
+// A cached plan puts back the levels of a graph whose levels were lost.
+void run_plan_cache() {
+    typedef unsigned short T;
+    std::vector<T> data_in[1] = {{1, 2, 3, 4, 5, 6, 7, 8, 9, 10}};
+    std::vector<T> leveled[1], cached[1];
+    PlanCache<T> cache(".");
+
+    auto df = chebyshev(0, 1, data_in, leveled);
+    auto levels = levelsOf(df);
+    int maxLevel = df->getMaxLevel();
+    uint64_t hash = structuralHash(*df);
+    remove(cache.pathFor(hash).c_str());
+    bool miss = !cache.prepare(*df);
+    df->reset();
+    df->compute();
+    delete df;
+
+    df = chebyshev(0, 1, data_in, cached);
+    for (auto item:df->getOpArray()) {
+        item.second->setLevel(0);
+    }
+    df->setMaxLevel(0);
+    bool sameHash = structuralHash(*df) == hash;
+    bool hit = cache.prepare(*df);
+    df->reset();
+    df->compute();
+    check(miss && sameHash && hit && levelsOf(df) == levels && df->getMaxLevel() == maxLevel && cached[0] == leveled[0],
+          "plan cache: a miss stores the plan and a hit restores the levels and outputs");
+    delete df;
+
+    T coef[2][4] = {{1, 2, 3, 4}, {1, 2, 3, 5}};
+    std::vector<T> out[1];
+    auto a = FIR(0, 1, coef[0], 4, data_in, out);
+    auto b = FIR(0, 1, coef[1], 4, data_in, out);
+    check(structuralHash(*a) != structuralHash(*b) && structuralHash(*a) != hash,
+          "plan cache: graphs with another constant or shape hash differently");
+    delete a;
+    delete b;
+
+    // A damaged file is a miss, and prepare() rewrites it.
+    FILE *f = fopen(cache.pathFor(hash).c_str(), "r+b");
+    if (f) {
+        fseek(f, 12, SEEK_SET);
+        fputc(0x7f, f);
+        fclose(f);
+    }
+    std::vector<T> again[1];
+    df = chebyshev(0, 1, data_in, again);
+    check(f && !cache.load(*df) && !cache.prepare(*df) && cache.load(*df),
+          "plan cache: a damaged plan misses and is rewritten");
+    remove(cache.pathFor(hash).c_str());
+    delete df;
+    std::cout << std::endl;
+}
+
+#endif //MAIN_PLAN_H
@@ -0,0 +1,105 @@
+#ifndef MAIN_PROBES_H
+#define MAIN_PROBES_H
+
+#include <thread>
+#include <data_flow.h>
+#include <probe.h>
+#include "check.h"
+
+// input -> addi(1) -> output: the probed addi holds sample + 1 in the cycle of that sample.
+DataFlow<int> *offsetGraph(std::vector<int> &data_in, std::vector<int> &data_out) {
+    auto df = new DataFlow<int>(0, "offset");
+    df->connect(new InputStream<int>(0, data_in), new Addi<int>(1, 1), PORT_A);
+    df->connect(df->getOp(1), new OutputStream<int>(2, data_out), PORT_A);
+    df->reset();
+    return df;
+}
+
+// True if every sample holds the value out got in its cycle, in cycle order.
+inline bool samplesMatch(const std::vector<Probe<int>::Sample> &samples, const std::vector<int> &out) {
+    for (size_t i = 0; i < samples.size(); ++i) {
+        if (samples[i].cycle >= out.size() || samples[i].value != out[samples[i].cycle] ||
+            (i && samples[i].cycle <= samples[i - 1].cycle)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void run_probes() {
+    std::vector<int> data_in, out;
+    for (int i = 0; i < 500; ++i) {
+        data_in.push_back(i);
+    }
+    auto df = offsetGraph(data_in, out);
+
+    Probe<int> every;
+    every.setEvery(7);
+    std::vector<Probe<int>::Sample> samples;
+    bool sevenths = df->attachProbe(1, &every);
+    df->compute();
+    every.read(samples);
+    for (auto &s:samples) {
+        sevenths = sevenths && s.cycle % 7 == 0;
+    }
+    check(sevenths && samples.size() == 72 && samplesMatch(samples, out) && df->detachProbe(&every),
+          "probe: setEvery(7) keeps every 7th firing");
+
+    // Values 100, 200, ... 500 open windows of three firings; the last one is cut short by the end of the input.
+    Probe<int> trigger;
+    trigger.setTrigger([](int v) { return v % 100 == 0; }, 3);
+    df->attachProbe(1, &trigger);
+    out.clear();
+    df->reset();
+    df->compute();
+    samples.clear();
+    trigger.read(samples);
+    bool windows = samples.size() == 13;
+    for (size_t i = 0; windows && i < samples.size(); ++i) {
+        windows = samples[i].value == (int) (i / 3 + 1) * 100 + (int) (i % 3);
+    }
+    check(windows && samplesMatch(samples, out) && df->detachProbe(&trigger) && !df->detachProbe(&trigger),
+          "probe: a trigger keeps a window of firings from each value that satisfies it");
+
+    Probe<int> small(10);
+    df->attachProbe(1, &small);
+    out.clear();
+    df->reset();
+    df->compute();
+    samples.clear();
+    check(small.getCapacity() == 16 && small.read(samples) == 16 && samples.back().cycle == 15 &&
+          small.getDropped() == 484 && samplesMatch(samples, out), "probe: a full ring drops and counts new samples");
+    df->detachProbe(&small);
+    delete df;
+
+    // Detached from this thread while compute() runs on another: the samples stop at a cycle boundary.
+    std::vector<int> long_in, long_out;
+    for (int i = 0; i < 1000000; ++i) {
+        long_in.push_back(i & 0xffff);
+    }
+    df = offsetGraph(long_in, long_out);
+    Probe<int> live(1 << 20);
+    df->attachProbe(1, &live);
+    std::thread worker([df]() { df->compute(); });
+    samples.clear();
+    while (samples.empty()) {
+        live.read(samples);
+        std::this_thread::yield();
+    }
+    bool detached = df->detachProbe(&live);
+    live.read(samples);
+    size_t atDetach = samples.size();
+    worker.join();
+    live.read(samples);
+    bool consecutive = true;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        consecutive = consecutive && samples[i].cycle == i;
+    }
+    check(detached && live.getOp() == nullptr && samples.size() == atDetach && atDetach < long_in.size() &&
+          consecutive && samplesMatch(samples, long_out) && long_out.size() == long_in.size(),
+          "probe: detaching while compute() runs stops the samples after the cycle in progress");
+    delete df;
+    std::cout << std::endl;
+}
+
+#endif //MAIN_PROBES_H
@@ -0,0 +1,84 @@
+#ifndef MAIN_REPLICATE_H
+#define MAIN_REPLICATE_H
+
+#include <data_flow.h>
+#include "check.h"
+#include "chebyshev.h"
+#include "fir.h"
+
+// FIR() with every copy wired by connect(), as it was built before replicate().
+template<class T>
+DataFlow<T> *connectedFIR(int id, int copies, T *coef, int taps, std::vector<T> *data_in, std::vector<T> *data_out) {
+    auto df = new DataFlow<T>(id, "fir");
+    int idx = 0;
+    std::vector<Operator<T> *> in_cp;
+    std::vector<Operator<T> *> out_cp;
+    for (int j = 0; j < copies; ++j) {
+        in_cp.push_back(new InputStream<T>(idx++, data_in[j]));
+    }
+    for (int j = 0; j < copies; ++j) {
+        out_cp.push_back(new OutputStream<T>(idx++, data_out[j]));
+    }
+    for (int j = 0; j < copies; ++j) {
+        std::vector<Operator<T> *> add;
+        for (int i = 0; i < taps; ++i) {
+            auto m = new Multi<T>(idx++, coef[taps - i - 1]);
+            Operator<T> *op = i == 0 ? (Operator<T> *) new PassA<T>(idx++) : new Add<T>(idx++);
+            add.push_back(op);
+            df->connect(in_cp[j], m, PORT_A);
+            df->connect(m, op, PORT_A);
+        }
+        for (int i = 0; i < taps - 1; ++i) {
+            df->connect(add[i], add[i + 1], PORT_B);
+        }
+        df->connect(add[taps - 1], out_cp[j], PORT_A);
+    }
+    return df;
+}
+
+void run_replicate() {
+    typedef unsigned short T;
+    const int copies = 3;
+    std::vector<T> data_in[copies];
+    for (int c = 0; c < copies; ++c) {
+        for (int i = 0; i < 30; ++i) {
+            data_in[c].push_back((T) (i * (c + 1) + 7));
+        }
+    }
+    T coef[5] = {3, 1, 4, 1, 5};
+
+    std::vector<T> rep_out[copies], con_out[copies];
+    auto rep = FIR(0, copies, coef, 5, data_in, rep_out);
+    auto con = connectedFIR(0, copies, coef, 5, data_in, con_out);
+    rep->reset();
+    rep->compute();
+    con->reset();
+    con->compute();
+    bool same = rep->getNumOp() == con->getNumOp() && rep->getNumEdges() == con->getNumEdges() &&
+                rep->getMaxLevel() == con->getMaxLevel();
+    for (int c = 0; c < copies; ++c) {
+        same = same && !rep_out[c].empty() && rep_out[c] == con_out[c];
+    }
+    check(same, "replicate: FIR copies match a graph wired with connect()");
+    delete rep;
+    delete con;
+
+    std::vector<T> cheb_out[copies];
+    auto cheb = chebyshev(0, copies, data_in, cheb_out);
+    cheb->reset();
+    cheb->compute();
+    same = true;
+    for (int c = 0; c < copies; ++c) {
+        std::vector<T> one_out[1];
+        auto one = chebyshev(0, 1, data_in + c, one_out);
+        one->reset();
+        one->compute();
+        same = same && !one_out[0].empty() && one_out[0] == cheb_out[c];
+        delete one;
+    }
+    check(same, "replicate: each chebyshev copy matches a single-copy graph on its input");
+    delete cheb;
+    std::cout << std::endl;
+}
+
+#endif //MAIN_REPLICATE_H
@@ -0,0 +1,40 @@
+#ifndef MAIN_RERUN_H
+#define MAIN_RERUN_H
+
+#include <data_flow.h>
+#include "check.h"
+#include "fir.h"
+
+// One graph run several times: reset() repeats a run, rebind() runs it on new streams.
+void run_rerun() {
+    typedef unsigned short T;
+    std::vector<T> data_in[2] = {{1, 2, 3, 4, 5, 6, 7, 8, 9, 10}, {10, 20, 30, 40, 50, 60, 70, 80}};
+    T coef[4] = {1, 2, 3, 4};
+
+    std::vector<T> fresh_out[2];
+    for (int c = 0; c < 2; ++c) {
+        auto fresh = FIR(0, 1, coef, 4, data_in + c, fresh_out + c);
+        fresh->reset();
+        fresh->compute();
+        delete fresh;
+    }
+
+    std::vector<T> data_out[1];
+    auto df = FIR(0, 1, coef, 4, data_in, data_out);
+    df->reset();
+    df->compute();
+    std::vector<T> first = data_out[0];
+    data_out[0].clear();
+    df->reset();
+    df->compute();
+    check(!first.empty() && first == fresh_out[0] && data_out[0] == first, "rerun: reset() repeats the run");
+
+    std::vector<T> other_out[1];
+    df->rebind(data_in + 1, other_out);
+    df->compute();
+    check(other_out[0] == fresh_out[1] && data_out[0] == first, "rerun: rebind() runs the graph on new streams");
+    delete df;
+    std::cout << std::endl;
+}
+
+#endif //MAIN_RERUN_H
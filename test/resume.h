@@ -0,0 +1,49 @@
+#ifndef MAIN_RESUME_H
+#define MAIN_RESUME_H
+
+#include <data_flow.h>
+#include "check.h"
+#include "chebyshev.h"
+
+// A run resumed from a snapshot taken mid-way ends with the outputs of an uninterrupted run.
+void run_checkpoint() {
+    typedef unsigned short T;
+    std::vector<T> data_in[2];
+    for (T i = 0; i < 50; ++i) {
+        data_in[0].push_back((T) (i * 3 + 1));
+        data_in[1].push_back((T) (100 - i));
+    }
+    std::vector<T> full[2];
+    std::vector<uint8_t> snapshot;
+    auto df = chebyshev(0, 2, data_in, full);
+    df->setCheckpoint(20, [&snapshot](std::vector<uint8_t> &s) {
+        if (snapshot.empty()) {
+            snapshot = s;
+        }
+    });
+    df->reset();
+    df->compute();
+    unsigned long cycles = df->getNumCycles();
+    delete df;
+
+    // The restarted process still has everything the first run wrote; restore() cuts it back.
+    std::vector<T> resumed[2] = {full[0], full[1]};
+    df = chebyshev(0, 2, data_in, resumed);
+    df->reset();
+    bool restored = df->restore(snapshot);
+    bool cut = resumed[0].size() < full[0].size();
+    df->compute();
+    check(restored && cut && resumed[0] == full[0] && resumed[1] == full[1] && df->getNumCycles() == cycles - 20,
+          "checkpoint: a chebyshev run resumed at cycle 20 matches the uninterrupted run");
+
+    // A damaged snapshot is refused; one taken outside compute() still loads.
+    df->reset();
+    std::vector<uint8_t> start = df->snapshot();
+    std::vector<uint8_t> damaged = snapshot;
+    damaged[damaged.size() / 2] ^= 1;
+    check(!df->restore(damaged) && df->restore(start), "checkpoint: a damaged snapshot is refused");
+    delete df;
+    std::cout << std::endl;
+}
+
+#endif //MAIN_RESUME_H
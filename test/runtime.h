@@ -0,0 +1,53 @@
+#ifndef MAIN_RUNTIME_H
+#define MAIN_RUNTIME_H
+
+#include <data_flow.h>
+#include <numa_placement.h>
+#include "check.h"
+#include "chebyshev.h"
+
+void run_runtime_stats() {
+    typedef unsigned short T;
+    std::vector<T> data_in[3], plain[3], numa[3];
+    for (int j = 0; j < 3; ++j) {
+        for (int i = 0; i < 400; ++i) {
+            data_in[j].push_back((T) (i * (j + 7) % 101));
+        }
+    }
+    auto df = chebyshev(0, 3, data_in, plain);
+    df->reset();
+    memory_usage_t before = df->getMemoryUsage();
+    df->compute();
+    memory_usage_t after = df->getMemoryUsage();
+    runtime_stats_t stats = df->getRuntimeStats();
+    check(stats.cycles == df->getNumCycles() && stats.tokensIn == 1200 && stats.tokensOut == 1200 &&
+          !stats.running && stats.utilization.size() == 1, "runtime: compute() leaves its cycles and tokens");
+    check(after.streams >= before.streams + 3 * 400 * sizeof(T) && after.operators == before.operators &&
+          after.total == after.operators + after.values + after.edges + after.streams + after.runtime,
+          "runtime: memory usage grows with the output vectors");
+
+    // Past LiveStats::MAX_THREADS workers would share live-stats slots.
+    df->rebind(data_in, numa);
+    NumaExecutor<T> executor(*df, 100, false);
+    executor.run();
+    stats = df->getRuntimeStats();
+    bool same = true;
+    for (int j = 0; j < 3; ++j) {
+        same = same && numa[j] == plain[j];
+    }
+    check(executor.getNumWorkers() == LiveStats::MAX_THREADS && stats.utilization.size() == 64 &&
+          stats.tokensIn == 1200 && !stats.running && same, "runtime: NumaExecutor clamps its workers to MAX_THREADS");
+
+    // The copies were built one after another on this thread, so their operators share heap pages.
+    std::vector<T> placed[3];
+    df->rebind(data_in, placed);
+    NumaExecutor<T> three(*df, 3);
+    three.run();
+    numa_locality_t l = three.getLocality();
+    check(three.getPartition().size() == (size_t) df->getNumOp() && l.shared > 0 && placed[0] == plain[0],
+          "runtime: pages holding operators of several parts are reported as shared");
+    delete df;
+    std::cout << std::endl;
+}
+
+#endif //MAIN_RUNTIME_H
@@ -0,0 +1,65 @@
+#ifndef MAIN_SEAL_H
+#define MAIN_SEAL_H
+
+#include <data_flow.h>
+#include "check.h"
+#include "chebyshev.h"
+
+// Whether some error names op_id and contains text.
+inline bool reported(const std::vector<std::string> &errors, int op_id, const std::string &text) {
+    std::string op = "op " + std::to_string(op_id) + " ";
+    for (auto &e:errors) {
+        if (e.compare(0, op.size(), op) == 0 && e.find(text) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void run_seal() {
+    typedef unsigned short T;
+    std::vector<T> data_in[1] = {{1, 2, 3, 4, 5, 6, 7, 8, 9, 10}};
+    std::vector<T> checked[1], sealed[1];
+
+    auto df = chebyshev(0, 1, data_in, checked);
+    df->reset();
+    df->compute();
+    std::vector<std::string> errors;
+    df->rebind(data_in, sealed);
+    bool ok = df->seal(&errors);
+    df->compute();
+    check(ok && errors.empty() && sealed[0] == checked[0], "seal: a sealed chebyshev computes the same outputs");
+    int ops = df->getNumOp();
+    Addi<T> extra(500, 1);
+    OutputStream<T> sink(501, sealed[0]);
+    df->connect(df->getOp(0), &extra, PORT_A);
+    check(df->getNumOp() == ops && !df->replaceSink(1, &sink) && !df->attachSink(0, &sink),
+          "seal: edits are refused while sealed");
+    delete df;
+
+    // An add missing port B, an addi with a port B it never reads, and an edge added without re-leveling.
+    std::vector<T> out;
+    DataFlow<T> bad(0, "bad");
+    auto in = new InputStream<T>(0, data_in[0]);
+    auto add = new Add<T>(1);
+    auto addi = new Addi<T>(2, 1);
+    auto late = new PassA<T>(3);
+    bad.connect(in, add, PORT_A);
+    bad.connect(add, addi, PORT_A);
+    bad.connect(add, addi, PORT_B);
+    bad.connect(addi, new OutputStream<T>(4, out), PORT_A);
+    bad.link(addi, late, PORT_A);
+    bad.link(late, add, PORT_B);
+    errors.clear();
+    ok = bad.seal(&errors);
+    check(!ok && !bad.isSealed() && reported(errors, 2, "port B is connected but never read") &&
+          reported(errors, 3, "port A comes from op 2") && reported(errors, 3, "not leveled"),
+          "seal: miswired ports and stale levels are reported per operator");
+    bad.unlink(late, add, PORT_B);
+    errors.clear();
+    ok = bad.seal(&errors);
+    check(!ok && reported(errors, 1, "port B is not connected"), "seal: an unconnected port is reported");
+    std::cout << std::endl;
+}
+
+#endif //MAIN_SEAL_H
@@ -0,0 +1,101 @@
+#ifndef MAIN_SINKS_H
+#define MAIN_SINKS_H
+
+#include <limits>
+#include <data_flow.h>
+#include <sinks.h>
+#include "check.h"
+#include "chebyshev.h"
+#include "fir.h"
+
+void run_sinks() {
+    typedef unsigned short T;
+    std::vector<T> data_in[2];
+    for (T i = 1; i <= 40; ++i) {
+        data_in[0].push_back(i);
+        data_in[1].push_back((T) (41 - i));
+    }
+    T coef[4] = {1, 2, 3, 4};
+
+    std::vector<T> ref_out[2];
+    auto ref = FIR(0, 2, coef, 4, data_in, ref_out);
+    ref->reset();
+    ref->compute();
+    long long refSum = 0;
+    for (const auto &dv:ref_out) {
+        for (auto v:dv) {
+            refSum += v;
+        }
+    }
+
+    // Every output of a two-copy FIR() swapped for a sum, merged across the copies.
+    std::vector<T> data_out[2];
+    auto df = FIR(0, 2, coef, 4, data_in, data_out);
+    std::vector<ReduceSink<T, SumReducer<T> > *> sums;
+    bool replaced = true;
+    for (int id:outputIds(df)) {
+        auto sink = new ReduceSink<T, SumReducer<T> >(id, SumReducer<T>());
+        auto old = df->replaceSink(id, sink);
+        replaced = replaced && old;
+        delete old;
+        sums.push_back(sink);
+    }
+    df->reset();
+    df->compute();
+    SumReducer<T> total = mergeSinks(sums, SumReducer<T>());
+    check(replaced && sums.size() == 2, "sinks: replaceSink swaps both FIR outputs");
+    check(total.getSum() == refSum && total.getCount() == ref_out[0].size() + ref_out[1].size(),
+          "sinks: merged FIR sums match the stored outputs");
+    check(mergeSinks(std::vector<ReduceSink<T, SumReducer<T> > *>(), SumReducer<T>()).getCount() == 0,
+          "sinks: merging no sinks returns the initial reducer");
+    delete df;
+
+    // A decimating sink next to chebyshev()'s output keeps every stride-th output value.
+    std::vector<T> cheb_out[1];
+    auto cheb = chebyshev(0, 1, data_in, cheb_out);
+    auto decimate = new ReduceSink<T, DecimateReducer<T> >(1000, DecimateReducer<T>(4));
+    bool attached = cheb->attachSink(cheb->getOp(outputIds(cheb)[0])->getSrcA()->getId(), decimate);
+    cheb->reset();
+    cheb->compute();
+    const DecimateReducer<T> &d = decimate->getReducer();
+    bool kept = attached && d.getCount() == cheb_out[0].size() &&
+                d.getValues().size() == (cheb_out[0].size() + d.getStride() - 1) / d.getStride();
+    for (size_t i = 0; kept && i < d.getValues().size(); ++i) {
+        kept = d.getValues()[i] == cheb_out[0][i * d.getStride()];
+    }
+    check(kept, "sinks: attachSink on chebyshev keeps every stride-th output");
+    std::vector<T> firstRun = d.getValues();
+    unsigned long firstStride = d.getStride();
+    cheb_out[0].clear();
+    cheb->reset();
+    cheb->compute();
+    check(firstStride > 1 && d.getValues() == firstRun && d.getStride() == firstStride,
+          "sinks: a rerun after reset() decimates from the initial stride again");
+    delete cheb;
+
+    // Two halves merged in order decimate like the whole stream.
+    DecimateReducer<T> whole(4), first(4), second(4);
+    for (size_t i = 0; i < ref_out[0].size(); ++i) {
+        whole.add(ref_out[0][i]);
+        (i < 16 ? first : second).add(ref_out[0][i]);
+    }
+    first.merge(second);
+    check(first.getValues() == whole.getValues() && first.getStride() == whole.getStride(),
+          "sinks: merged decimation matches the whole stream");
+
+    HistogramReducer<int> empty(5, 5, 0);
+    empty.add(4);
+    empty.add(6);
+    check(empty.getBins().empty() && empty.getUnderflow() == 1 && empty.getOverflow() == 1,
+          "sinks: a histogram over an empty range only counts under- and overflow");
+
+    HistogramReducer<double> hist(0, 10, 5), other(0, 10, 4);
+    hist.add(std::numeric_limits<double>::quiet_NaN());
+    hist.add(3);
+    other.add(3);
+    check(hist.getOverflow() == 1 && hist.getBins()[1] == 1 && !hist.merge(other) && hist.getBins()[1] == 1,
+          "sinks: NaN counts as overflow and histograms with other bins do not merge");
+    std::cout << std::endl;
+}
+
+#endif //MAIN_SINKS_H
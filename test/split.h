@@ -0,0 +1,103 @@
+#ifndef MAIN_SPLIT_H
+#define MAIN_SPLIT_H
+
+#include <unistd.h>
+#include <distributed.h>
+#include "check.h"
+#include "chebyshev.h"
+#include "fir.h"
+
+// Passes srcA through and kills its process on the given firing, as a crashing worker would.
+template<class T>
+class Crash : public Operator<T> {
+private:
+    int left;
+
+public:
+    Crash(int id, int firing) : Operator<T>(id, OP_PASS_A, OP_BASIC, "crash"), left(firing) {}
+
+    void compute() override {
+        if (Operator<T>::getSrcA()) {
+            if (--left == 0) {
+                _exit(3);
+            }
+            Operator<T>::setVal(Operator<T>::getSrcA()->getVal());
+        }
+    }
+};
+
+// A chain of registers from one input to one output with a Crash at position at.
+DataFlow<unsigned short> *crashChain(int length, int at, std::vector<unsigned short> &data_in,
+                                     std::vector<unsigned short> &data_out) {
+    typedef unsigned short T;
+    auto df = new DataFlow<T>(0, "chain");
+    Operator<T> *prev = new InputStream<T>(0, data_in);
+    for (int i = 1; i <= length; ++i) {
+        Operator<T> *op = i == at ? (Operator<T> *) new Crash<T>(i, 1000) : (Operator<T> *) new PassA<T>(i);
+        df->link(prev, op, PORT_A);
+        prev = op;
+    }
+    df->link(prev, new OutputStream<T>(length + 1, data_out), PORT_A);
+    df->updateOpLevel();
+    return df;
+}
+
+void run_split() {
+    typedef unsigned short T;
+    std::vector<T> data_in[1];
+    for (int i = 0; i < 3000; ++i) {
+        data_in[0].push_back((T) (i * 7 + 3));
+    }
+    std::vector<T> coef(64);
+    for (int i = 0; i < 64; ++i) {
+        coef[i] = (T) (i % 5 + 1);
+    }
+    std::vector<T> fir_ref[1], cheb_ref[1];
+    auto df = FIR(0, 1, coef.data(), 64, data_in, fir_ref);
+    df->reset();
+    df->compute();
+    delete df;
+    df = chebyshev(0, 1, data_in, cheb_ref);
+    df->reset();
+    df->compute();
+    delete df;
+
+    const transport_t transports[2] = {TRANSPORT_SHM, TRANSPORT_TCP};
+    for (auto transport:transports) {
+        bool fir = true, cheb = true;
+        for (int workers = 2; workers <= 8; workers *= 2) {
+            std::vector<T> out[1];
+            df = FIR(0, 1, coef.data(), 64, data_in, out);
+            DistributedRunner<T> firRunner(*df, workers, transport, 64, 4);
+            fir = fir && firRunner.getCutEdges() > 0 && firRunner.run() && out[0] == fir_ref[0];
+            delete df;
+            if (workers <= 4) {
+                out[0].clear();
+                df = chebyshev(0, 1, data_in, out);
+                DistributedRunner<T> chebRunner(*df, workers, transport, 64, 4);
+                cheb = cheb && chebRunner.getCutEdges() > 0 && chebRunner.run() && out[0] == cheb_ref[0];
+                delete df;
+            }
+        }
+        bool tcp = transport == TRANSPORT_TCP;
+        check(fir, tcp ? "split: a 64-tap FIR cut over 2, 4 and 8 workers matches compute() over tcp"
+                       : "split: a 64-tap FIR cut over 2, 4 and 8 workers matches compute() over shm");
+        check(cheb, tcp ? "split: chebyshev cut over 2 and 4 workers matches compute() over tcp"
+                        : "split: chebyshev cut over 2 and 4 workers matches compute() over shm");
+
+        // A worker dying upstream or downstream of the cut fails the run instead of hanging its peer.
+        bool failed = true;
+        for (int at = 2; at <= 38; at += 36) {
+            std::vector<T> out;
+            df = crashChain(40, at, data_in[0], out);
+            DistributedRunner<T> runner(*df, 2, transport, 64, 4);
+            failed = failed && runner.getCutEdges() > 0 && !runner.run();
+            delete df;
+        }
+        check(failed, tcp ? "split: a crashed worker ends the run over tcp"
+                          : "split: a crashed worker ends the run over shm");
+    }
+    std::cout << std::endl;
+}
+
+#endif //MAIN_SPLIT_H
@@ -0,0 +1,70 @@
+#ifndef MAIN_TRACE_H
+#define MAIN_TRACE_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <data_flow.h>
+#include <tracer.h>
+#include "check.h"
+#include "chebyshev.h"
+
+// The integer after every occurrence of key in text, in order.
+inline std::vector<long long> valuesAfter(const std::string &text, const std::string &key) {
+    std::vector<long long> values;
+    for (size_t at = text.find(key); at != std::string::npos; at = text.find(key, at + key.size())) {
+        values.push_back(atoll(text.c_str() + at + key.size()));
+    }
+    return values;
+}
+
+// Three chebyshev() copies over 500 samples traced every 7th cycle: 72 of the 501 cycles are recorded.
+void run_trace() {
+    typedef unsigned short T;
+    std::vector<T> data_in[3], plain[3], traced[3];
+    for (int j = 0; j < 3; ++j) {
+        for (int i = 0; i < 500; ++i) {
+            data_in[j].push_back((T) (i * (j + 3) % 97));
+        }
+    }
+    auto df = chebyshev(0, 3, data_in, plain);
+    df->reset();
+    df->compute();
+    unsigned long cycles = df->getNumCycles();
+
+    std::string path = "/tmp/dataflow_trace_" + std::to_string((long) getpid()) + ".json";
+    Tracer tracer(path, 7);
+    df->rebind(data_in, traced);
+    df->setTracer(&tracer);
+    df->compute();
+    df->setTracer(nullptr);
+    tracer.stop();
+    std::ifstream in(path);
+    std::stringstream text;
+    text << in.rdbuf();
+    remove(path.c_str());
+
+    std::string json = text.str();
+    auto sampled = valuesAfter(json, R"("name":"cycle","cat":"compute")");
+    auto numbers = valuesAfter(json, R"("args":{"cycle":)");
+    bool every7 = numbers.size() == sampled.size();
+    for (auto c:numbers) {
+        every7 = every7 && c % 7 == 0 && c < (long long) cycles;
+    }
+    auto dropped = valuesAfter(json, R"("dropped":)");
+    check(cycles == 501 && sampled.size() == 72 && every7, "trace: every 7th of 501 cycles is recorded");
+    check(dropped.size() == 1 && dropped[0] == 0 && json.compare(json.size() - 2, 2, "}}") == 0,
+          "trace: the document is closed and nothing was dropped");
+    bool same = true;
+    for (int j = 0; j < 3; ++j) {
+        same = same && traced[j] == plain[j];
+    }
+    check(same, "trace: traced cycles compute the same outputs");
+    delete df;
+    std::cout << std::endl;
+}
+
+#endif //MAIN_TRACE_H